@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <hook.h>
+#include "serve.h"
 
 #define VERSION "0.1.0"
 
@@ -25,13 +26,29 @@ typedef struct
   bool       optDump;
   bool       optCompile;
   bool       optRun;
+  bool       optBundle;
+  bool       optNoOptimize;
+  bool       optJit;
+  bool       optEmitC;
+  bool       optTraceImports;
   int        stackSize; 
+  const char *serve;
+  const char *connect;
+  int        numWorkers;
+  int        numThreads;
   const char *input;
   const char *output;
   const char **args;
   int        numArgs;
 } ParsedArgs;
 
+typedef struct
+{
+  HkVM       *vm;
+  HkClosure  *cl;
+  ParsedArgs *parsedArgs;
+} PreforkData;
+
 static inline void fatal_error(const char *fmt, ...);
 static inline void parse_args(ParsedArgs *parsedArgs, int argc, const char **argv);
 static inline void parse_option(ParsedArgs *parsedArgs, const char *arg);
@@ -41,11 +58,23 @@ static inline void print_help(const char *cmd);
 static inline void print_version(void);
 static inline FILE *open_file(const char *filename, const char *mode);
 static inline HkString *load_source_from_file(const char *filename);
-static inline HkClosure *load_bytecode_from_file(const char *filename);
-static inline HkClosure *load_bytecode_from_stream(FILE *stream);
+static inline HkClosure *load_bytecode_from_file(HkVM *vm, const char *filename);
+static inline HkClosure *load_bytecode_from_stream(HkVM *vm, FILE *stream);
 static inline void save_bytecode_to_file(HkClosure *cl, const char *filename);
+static inline void save_bundle_to_file(HkClosure *cl, const char *filename);
 static inline void dump_bytecode_to_file(HkFunction *fn, const char *filename);
+static inline void emit_c_to_stream(HkFunction *fn, const char *input, FILE *stream);
+static inline void emit_c_to_file(HkFunction *fn, const char *input, const char *filename);
+static inline void init_vm(HkVM *vm, ParsedArgs *parsedArgs);
+static inline int run_in_vm(HkVM *vm, HkClosure *cl, HkArray *args);
 static inline int run_bytecode(HkClosure *cl, ParsedArgs *parsedArgs);
+static inline int run_image(ParsedArgs *parsedArgs);
+static inline int serve_request(void *data, const char *script, int argc, const char **argv);
+static inline int serve_scripts(ParsedArgs *parsedArgs);
+static inline int run_worker(void *data);
+static inline int prefork_script(ParsedArgs *parsedArgs);
+static inline int run_thread(void *data);
+static inline int run_in_threads(ParsedArgs *parsedArgs);
 
 static inline void fatal_error(const char *fmt, ...)
 {
@@ -68,7 +97,16 @@ static inline void parse_args(ParsedArgs *parsedArgs, int argc, const char **arg
   parsedArgs->optDump = false;
   parsedArgs->optCompile = false;
   parsedArgs->optRun = false;
+  parsedArgs->optBundle = false;
+  parsedArgs->optNoOptimize = false;
+  parsedArgs->optJit = false;
+  parsedArgs->optEmitC = false;
+  parsedArgs->optTraceImports = false;
   parsedArgs->stackSize = 0;
+  parsedArgs->serve = NULL;
+  parsedArgs->connect = NULL;
+  parsedArgs->numWorkers = 0;
+  parsedArgs->numThreads = 0;
   parsedArgs->input = NULL;
   parsedArgs->output = NULL;
   int i = 1;
@@ -127,7 +165,60 @@ static inline void parse_option(ParsedArgs *parsedArgs, const char *arg)
     parsedArgs->optRun = true;
     return;
   }
-  const char *opt_val = option(arg, "-s");
+  if (option(arg, "-b") || option(arg, "--bundle"))
+  {
+    parsedArgs->optBundle = true;
+    return;
+  }
+  if (option(arg, "-n") || option(arg, "--no-optimize"))
+  {
+    parsedArgs->optNoOptimize = true;
+    return;
+  }
+  if (option(arg, "-j") || option(arg, "--jit"))
+  {
+    parsedArgs->optJit = true;
+    return;
+  }
+  if (option(arg, "--emit-c"))
+  {
+    parsedArgs->optEmitC = true;
+    return;
+  }
+  if (option(arg, "--trace-imports"))
+  {
+    parsedArgs->optTraceImports = true;
+    return;
+  }
+  const char *opt_val = option(arg, "--serve=");
+  if (opt_val)
+  {
+    parsedArgs->serve = opt_val;
+    return;
+  }
+  opt_val = option(arg, "--connect=");
+  if (opt_val)
+  {
+    parsedArgs->connect = opt_val;
+    return;
+  }
+  opt_val = option(arg, "--prefork=");
+  if (opt_val)
+  {
+    parsedArgs->numWorkers = atoi(opt_val);
+    if (parsedArgs->numWorkers < 1)
+      fatal_error("invalid number of workers `%s`", opt_val);
+    return;
+  }
+  opt_val = option(arg, "--threads=");
+  if (opt_val)
+  {
+    parsedArgs->numThreads = atoi(opt_val);
+    if (parsedArgs->numThreads < 1)
+      fatal_error("invalid number of threads `%s`", opt_val);
+    return;
+  }
+  opt_val = option(arg, "-s");
   if (opt_val)
   {
     parsedArgs->stackSize = atoi(opt_val);
@@ -166,14 +257,26 @@ static inline void print_help(const char *cmd)
     "usage: %s [options] [input] [output]\n"
     "\n"
     "options:\n"
-    "  -h, --help     prints this message\n"
-    "  -v, --version  shows version information\n"
-    "  -e, --eval     evaluates a string from the terminal\n"
-    "  -a, --analyze  analyzes source code\n"
-    "  -d, --dump     shows the bytecode\n"
-    "  -c, --compile  compiles source code\n"
-    "  -r, --run      runs directly from bytecode\n"
-    "  -s=<size>      sets the stack size\n"
+    "  -h, --help         prints this message\n"
+    "  -v, --version      shows version information\n"
+    "  -e, --eval         evaluates a string from the terminal\n"
+    "  -a, --analyze      analyzes source code\n"
+    "  -d, --dump         shows the bytecode\n"
+    "  -c, --compile      compiles source code\n"
+    "  -r, --run          runs directly from bytecode\n"
+    "  -b, --bundle       compiles source code with its imported modules\n"
+    "  -n, --no-optimize  disables the optimizing tier\n"
+    "  -j, --jit          compiles hot functions to machine code\n"
+    "      --emit-c       emits C source for a native module\n"
+    "      --trace-imports\n"
+    "                     reports how long each import takes\n"
+    "  -s=<size>          sets the maximum stack size\n"
+    "      --serve=<socket>\n"
+    "                     runs scripts sent to a Unix socket\n"
+    "      --connect=<socket>\n"
+    "                     runs a script on a server\n"
+    "      --prefork=<n>  runs a script in n worker processes\n"
+    "      --threads=<n>  runs a script in n threads, each with its own VM\n"
     "\n",
   cmd);
 }
@@ -204,19 +307,17 @@ static inline HkString *load_source_from_file(const char *filename)
   return source;
 }
 
-static inline HkClosure *load_bytecode_from_file(const char *filename)
+static inline HkClosure *load_bytecode_from_file(HkVM *vm, const char *filename)
 {
-  FILE *stream = open_file(filename, "rb");
-  HkClosure *cl = load_bytecode_from_stream(stream);
-  if (!cl)
+  HkFunction *fn = hk_image_load_file(vm, filename);
+  if (!fn)
     fatal_error("unable to load file `%s`", filename);
-  (void) fclose(stream);
-  return cl;
+  return hk_closure_new(fn);
 }
 
-static inline HkClosure *load_bytecode_from_stream(FILE *stream)
+static inline HkClosure *load_bytecode_from_stream(HkVM *vm, FILE *stream)
 {
-  HkFunction *fn = hk_function_deserialize(stream);
+  HkFunction *fn = hk_image_load_stream(vm, stream);
   if (!fn)
     return NULL;
   return hk_closure_new(fn);
@@ -227,8 +328,21 @@ static inline void save_bytecode_to_file(HkClosure *cl, const char *filename)
   filename = filename ? filename : "a.out";
   hk_ensure_path(filename);
   FILE *stream = open_file(filename, "wb");
-  hk_function_serialize(cl->fn, stream);
+  bool saved = hk_image_save(cl->fn, stream);
+  (void) fclose(stream);
+  if (!saved)
+    fatal_error("unable to save file `%s`", filename);
+}
+
+static inline void save_bundle_to_file(HkClosure *cl, const char *filename)
+{
+  filename = filename ? filename : "a.out";
+  hk_ensure_path(filename);
+  FILE *stream = open_file(filename, "wb");
+  bool saved = hk_bundle_save(cl->fn, stream);
   (void) fclose(stream);
+  if (!saved)
+    fatal_error("unable to save file `%s`", filename);
 }
 
 static inline void dump_bytecode_to_file(HkFunction *fn, const char *filename)
@@ -239,33 +353,175 @@ static inline void dump_bytecode_to_file(HkFunction *fn, const char *filename)
   (void) fclose(stream);
 }
 
-static inline int run_bytecode(HkClosure *cl, ParsedArgs *parsedArgs)
+static inline void emit_c_to_stream(HkFunction *fn, const char *input, FILE *stream)
 {
-  HkVM vm;
-  hk_vm_init(&vm, parsedArgs->stackSize);
-  hk_vm_push_closure(&vm, cl);
-  hk_vm_push_array(&vm, args_array(parsedArgs));
-  hk_vm_call(&vm, 1);
-  int exitCode = EXIT_FAILURE;
-  if (hk_vm_is_ok(&vm))
+  // The module is named after the input file, without directories or extension.
+  const char *base = input ? input : "main";
+  for (const char *chars = base; *chars; ++chars)
+    if (*chars == '/' || *chars == '\\')
+      base = &chars[1];
+  int length = 0;
+  while (base[length] && base[length] != '.')
+    ++length;
+  char name[256];
+  (void) snprintf(name, sizeof(name), "%.*s", length, base);
+  if (!hk_aot_emit(fn, name, stream))
+    fatal_error("unable to emit C for `%s`", input ? input : "<stdin>");
+}
+
+static inline void emit_c_to_file(HkFunction *fn, const char *input, const char *filename)
+{
+  hk_ensure_path(filename);
+  FILE *stream = open_file(filename, "w");
+  emit_c_to_stream(fn, input, stream);
+  (void) fclose(stream);
+}
+
+static inline void init_vm(HkVM *vm, ParsedArgs *parsedArgs)
+{
+  hk_vm_init(vm, parsedArgs->stackSize);
+  if (parsedArgs->optNoOptimize)
+    vm->flags |= HK_VM_FLAG_NO_OPTIMIZE;
+  if (parsedArgs->optJit)
+    vm->flags |= HK_VM_FLAG_JIT;
+  if (parsedArgs->optTraceImports)
+    vm->flags |= HK_VM_FLAG_TRACE_IMPORTS;
+}
+
+static inline int run_in_vm(HkVM *vm, HkClosure *cl, HkArray *args)
+{
+  hk_vm_push_closure(vm, cl);
+  hk_vm_push_array(vm, args);
+  hk_vm_call(vm, 1);
+  if (hk_vm_is_ok(vm))
   {
-    HkValue result = hk_stack_get(&vm.vstk, 0);
-    exitCode = hk_is_int(result) ? (int) hk_as_number(result) : EXIT_SUCCESS;
-    hk_vm_pop(&vm);
-    goto end;
+    HkValue result = hk_stack_get(&vm->vstk, 0);
+    int exitCode = hk_is_int(result) ? (int) hk_as_number(result) : EXIT_SUCCESS;
+    hk_vm_pop(vm);
+    return exitCode;
   }
-  if (hk_vm_is_exit(&vm))
+  if (hk_vm_is_exit(vm))
   {
-    HkValue result = hk_stack_get(&vm.vstk, 0);
+    HkValue result = hk_stack_get(&vm->vstk, 0);
     hk_assert(hk_is_int(result), "exit code must be an integer");
-    exitCode = (int) hk_as_number(result);
-    hk_vm_pop(&vm);
+    int exitCode = (int) hk_as_number(result);
+    hk_vm_pop(vm);
+    return exitCode;
   }
-end:
+  return EXIT_FAILURE;
+}
+
+static inline int run_bytecode(HkClosure *cl, ParsedArgs *parsedArgs)
+{
+  HkVM vm;
+  init_vm(&vm, parsedArgs);
+  int exitCode = run_in_vm(&vm, cl, args_array(parsedArgs));
+  hk_vm_deinit(&vm);
+  return exitCode;
+}
+
+static inline int run_image(ParsedArgs *parsedArgs)
+{
+  // A bundle registers its modules with the VM that runs it, so the VM comes
+  // first.
+  HkVM vm;
+  init_vm(&vm, parsedArgs);
+  const char *input = parsedArgs->input;
+  HkClosure *cl = input ? load_bytecode_from_file(&vm, input)
+    : load_bytecode_from_stream(&vm, stdin);
+  if (!cl)
+    fatal_error("unable to load bytecode");
+  int exitCode = run_in_vm(&vm, cl, args_array(parsedArgs));
+  hk_vm_deinit(&vm);
+  return exitCode;
+}
+
+static inline int serve_request(void *data, const char *script, int argc, const char **argv)
+{
+  // Runs in a forked copy of the server, so the VM is used as is and never
+  // torn down.
+  HkVM *vm = (HkVM *) data;
+  HkString *file = hk_string_from_chars(-1, script);
+  HkString *source = load_source_from_file(script);
+  HkClosure *cl = hk_compile(file, source, HK_COMPILER_FLAG_NONE);
+  HkArray *args = hk_array_new_with_capacity(argc);
+  for (int i = 0; i < argc; ++i)
+    hk_array_inplace_append_element(args, hk_string_value(hk_string_from_chars(-1, argv[i])));
+  return run_in_vm(vm, cl, args);
+}
+
+static inline int serve_scripts(ParsedArgs *parsedArgs)
+{
+  HkVM vm;
+  init_vm(&vm, parsedArgs);
+  // The optional input script warms the server up. Whatever it imports stays
+  // loaded for every request.
+  const char *input = parsedArgs->input;
+  if (input)
+  {
+    HkString *file = hk_string_from_chars(-1, input);
+    HkString *source = load_source_from_file(input);
+    HkClosure *cl = hk_compile(file, source, HK_COMPILER_FLAG_NONE);
+    if (run_in_vm(&vm, cl, args_array(parsedArgs)) != EXIT_SUCCESS)
+      fatal_error("unable to warm up with `%s`", input);
+  }
+  if (!serve(parsedArgs->serve, serve_request, &vm))
+    fatal_error("unable to serve on `%s`", parsedArgs->serve);
+  hk_vm_deinit(&vm);
+  return EXIT_SUCCESS;
+}
+
+static inline int run_worker(void *data)
+{
+  // Runs in a forked copy of the parent, so the VM is used as is and never
+  // torn down.
+  PreforkData *preforkData = (PreforkData *) data;
+  return run_in_vm(preforkData->vm, preforkData->cl, args_array(preforkData->parsedArgs));
+}
+
+static inline int prefork_script(ParsedArgs *parsedArgs)
+{
+  const char *input = parsedArgs->input;
+  if (!input)
+    fatal_error("no input file");
+  HkString *file = hk_string_from_chars(-1, input);
+  HkString *source = load_source_from_file(input);
+  HkClosure *cl = hk_compile(file, source, HK_COMPILER_FLAG_NONE);
+  HkVM vm;
+  init_vm(&vm, parsedArgs);
+  // Everything the script imports is compiled before forking, so the workers
+  // share it instead of each compiling its own copy.
+  hk_bundle_preload(&vm, cl->fn);
+  PreforkData data = { .vm = &vm, .cl = cl, .parsedArgs = parsedArgs };
+  int exitCode = prefork(parsedArgs->numWorkers, run_worker, &data);
+  hk_closure_free(cl);
   hk_vm_deinit(&vm);
   return exitCode;
 }
 
+static inline int run_thread(void *data)
+{
+  // Every thread compiles the script itself, since nothing one VM creates
+  // may be used by another.
+  ParsedArgs *parsedArgs = (ParsedArgs *) data;
+  const char *input = parsedArgs->input;
+  HkString *file = hk_string_from_chars(-1, input);
+  HkString *source = load_source_from_file(input);
+  HkClosure *cl = hk_compile(file, source, HK_COMPILER_FLAG_NONE);
+  HkVM vm;
+  init_vm(&vm, parsedArgs);
+  int exitCode = run_in_vm(&vm, cl, args_array(parsedArgs));
+  hk_vm_deinit(&vm);
+  return exitCode;
+}
+
+static inline int run_in_threads(ParsedArgs *parsedArgs)
+{
+  if (!parsedArgs->input)
+    fatal_error("no input file");
+  return run_threads(parsedArgs->numThreads, run_thread, parsedArgs);
+}
+
 int main(int argc, const char **argv)
 {
   ParsedArgs parsedArgs;
@@ -281,6 +537,22 @@ int main(int argc, const char **argv)
     return EXIT_SUCCESS;
   }
   const char *input = parsedArgs.input;
+  if (parsedArgs.serve)
+    return serve_scripts(&parsedArgs);
+  if (parsedArgs.numWorkers)
+    return prefork_script(&parsedArgs);
+  if (parsedArgs.numThreads)
+    return run_in_threads(&parsedArgs);
+  if (parsedArgs.connect)
+  {
+    if (!input)
+      fatal_error("no input file");
+    int exitCode = serve_connect(parsedArgs.connect, input, parsedArgs.numArgs,
+      parsedArgs.args);
+    if (exitCode == -1)
+      fatal_error("unable to connect to `%s`", parsedArgs.connect);
+    return exitCode;
+  }
   if (parsedArgs.optEval)
   {
     if (!input)
@@ -291,17 +563,7 @@ int main(int argc, const char **argv)
     return run_bytecode(cl, &parsedArgs);
   }
   if (parsedArgs.optRun)
-  {
-    if (input)
-    {
-      HkClosure *cl = load_bytecode_from_file(input);
-      return run_bytecode(cl, &parsedArgs);
-    }
-    HkClosure *cl = load_bytecode_from_stream(stdin);
-    if (!cl)
-      fatal_error("unable to load bytecode");
-    return run_bytecode(cl, &parsedArgs);
-  }
+    return run_image(&parsedArgs);
   HkString *file = hk_string_from_chars(-1, input ? input : "<stdin>");
   HkString *source = input ? load_source_from_file(input) : hk_string_from_stream(stdin, '\0');
   int flags = parsedArgs.optAnalyze ? HK_COMPILER_FLAG_ANALYZE : HK_COMPILER_FLAG_NONE;
@@ -319,12 +581,30 @@ int main(int argc, const char **argv)
     hk_closure_free(cl);
     return EXIT_SUCCESS;
   }
+  if (parsedArgs.optEmitC)
+  {
+    if (output)
+    {
+      emit_c_to_file(cl->fn, input, output);
+      hk_closure_free(cl);
+      return EXIT_SUCCESS;
+    }
+    emit_c_to_stream(cl->fn, input, stdout);
+    hk_closure_free(cl);
+    return EXIT_SUCCESS;
+  }
   if (parsedArgs.optCompile)
   {
     save_bytecode_to_file(cl, output);
     hk_closure_free(cl);
     return EXIT_SUCCESS;
   }
+  if (parsedArgs.optBundle)
+  {
+    save_bundle_to_file(cl, output);
+    hk_closure_free(cl);
+    return EXIT_SUCCESS;
+  }
   if (parsedArgs.optAnalyze)
   {
     hk_closure_free(cl);
@@ -0,0 +1,607 @@
+//
+// serve.c
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "serve.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <Windows.h>
+#endif
+
+#ifndef _WIN32
+  #include <errno.h>
+  #include <limits.h>
+  #include <pthread.h>
+  #include <signal.h>
+  #include <sys/select.h>
+  #include <sys/socket.h>
+  #include <sys/time.h>
+  #include <sys/un.h>
+  #include <sys/wait.h>
+  #include <time.h>
+  #include <unistd.h>
+#endif
+
+#define REQUEST_MAGIC "HKRQ"
+
+#define MAX_REQUEST_LENGTH (1 << 20)
+#define NUM_STDIO_FDS      3
+#define THREAD_STACK_SIZE  (8 << 20)
+#define REQUEST_TIMEOUT    10
+
+typedef struct
+{
+#ifdef _WIN32
+  HANDLE        handle;
+#else
+  pthread_t     thread;
+#endif
+  ThreadHandler handler;
+  void          *data;
+  int           exitCode;
+} Thread;
+
+#ifndef _WIN32
+
+typedef struct
+{
+  char     magic[4];
+  uint32_t length;
+  uint32_t argc;
+} RequestHeader;
+
+typedef struct
+{
+  pid_t pid;
+  int   conn;
+} Worker;
+
+typedef struct
+{
+  int    capacity;
+  int    length;
+  Worker *workers;
+} WorkerList;
+
+static volatile sig_atomic_t stopping = 0;
+
+static inline bool make_address(const char *path, struct sockaddr_un *addr);
+static inline bool write_all(int fd, const void *data, size_t size);
+static inline bool read_all(int fd, void *data, size_t size);
+static inline void sigchld_handler(int sig);
+static inline void add_worker(WorkerList *list, pid_t pid, int conn);
+static inline void reap_workers(WorkerList *list);
+static inline void handle_request(int sock, int conn, WorkerList *list, ServeHandler handler,
+  void *data);
+static inline bool receive_request(int conn, int fds[], char **payload, RequestHeader *header);
+static inline const char **unpack_args(char *payload, RequestHeader *header);
+static inline void stop_handler(int sig);
+static inline void reset_signals(void);
+static inline pid_t start_worker(PreforkHandler handler, void *data);
+
+static inline bool make_address(const char *path, struct sockaddr_un *addr)
+{
+  size_t length = strlen(path);
+  if (length >= sizeof(addr->sun_path))
+    return false;
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, path, length + 1);
+  return true;
+}
+
+static inline bool write_all(int fd, const void *data, size_t size)
+{
+  const char *chars = (const char *) data;
+  while (size)
+  {
+    ssize_t n = write(fd, chars, size);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    chars += n;
+    size -= (size_t) n;
+  }
+  return true;
+}
+
+static inline bool read_all(int fd, void *data, size_t size)
+{
+  char *chars = (char *) data;
+  while (size)
+  {
+    ssize_t n = read(fd, chars, size);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    chars += n;
+    size -= (size_t) n;
+  }
+  return true;
+}
+
+static inline void sigchld_handler(int sig)
+{
+  // Only interrupts pselect(), the workers are reaped in the main loop.
+  (void) sig;
+}
+
+static inline void add_worker(WorkerList *list, pid_t pid, int conn)
+{
+  if (list->length == list->capacity)
+  {
+    int capacity = list->capacity ? list->capacity << 1 : 8;
+    Worker *workers = (Worker *) realloc(list->workers, sizeof(*workers) * capacity);
+    if (!workers)
+    {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+    }
+    list->capacity = capacity;
+    list->workers = workers;
+  }
+  list->workers[list->length++] = (Worker) { .pid = pid, .conn = conn };
+}
+
+static inline void reap_workers(WorkerList *list)
+{
+  int status;
+  pid_t pid;
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+  {
+    for (int i = 0; i < list->length; ++i)
+    {
+      Worker *worker = &list->workers[i];
+      if (worker->pid != pid)
+        continue;
+      // The server reports the status, so the client also learns about
+      // workers that crashed.
+      int32_t code = WIFEXITED(status) ? WEXITSTATUS(status)
+        : 128 + (WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+      (void) write_all(worker->conn, &code, sizeof(code));
+      (void) close(worker->conn);
+      list->workers[i] = list->workers[--list->length];
+      break;
+    }
+  }
+}
+
+static inline void handle_request(int sock, int conn, WorkerList *list, ServeHandler handler,
+  void *data)
+{
+  // Nothing buffered by the server may end up in the output of a request.
+  (void) fflush(NULL);
+  // The request is read by the worker, so a client that never sends one
+  // does not hold up the others.
+  pid_t pid = fork();
+  if (!pid)
+  {
+    // Each request runs in a copy of the warm server, so nothing it does
+    // is seen by the next one.
+    (void) close(sock);
+    for (int i = 0; i < list->length; ++i)
+      (void) close(list->workers[i].conn);
+    reset_signals();
+    struct timeval timeout = { .tv_sec = REQUEST_TIMEOUT };
+    (void) setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int fds[NUM_STDIO_FDS];
+    char *payload;
+    RequestHeader header;
+    if (!receive_request(conn, fds, &payload, &header))
+      exit(EXIT_FAILURE);
+    (void) close(conn);
+    for (int i = 0; i < NUM_STDIO_FDS; ++i)
+    {
+      (void) dup2(fds[i], i);
+      (void) close(fds[i]);
+    }
+    const char *cwd = payload;
+    const char *script = &payload[strlen(cwd) + 1];
+    const char **argv = unpack_args(payload, &header);
+    if (chdir(cwd))
+    {
+      fprintf(stderr, "fatal error: unable to change directory to `%s`\n", cwd);
+      exit(EXIT_FAILURE);
+    }
+    int code = handler(data, script, (int) header.argc, argv);
+    (void) fflush(stdout);
+    (void) fflush(stderr);
+    exit(code);
+  }
+  if (pid == -1)
+  {
+    int32_t code = EXIT_FAILURE;
+    (void) write_all(conn, &code, sizeof(code));
+    (void) close(conn);
+    return;
+  }
+  add_worker(list, pid, conn);
+}
+
+static inline bool receive_request(int conn, int fds[], char **payload, RequestHeader *header)
+{
+  char control[CMSG_SPACE(sizeof(int) * NUM_STDIO_FDS)];
+  struct iovec iov = { .iov_base = header, .iov_len = sizeof(*header) };
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t n;
+  do
+    n = recvmsg(conn, &msg, 0);
+  while (n == -1 && errno == EINTR);
+  struct cmsghdr *cmsg = n > 0 ? CMSG_FIRSTHDR(&msg) : NULL;
+  if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+    || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * NUM_STDIO_FDS))
+    return false;
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * NUM_STDIO_FDS);
+  bool ok = (n == (ssize_t) sizeof(*header)
+    || read_all(conn, (char *) header + n, sizeof(*header) - (size_t) n))
+    && !memcmp(header->magic, REQUEST_MAGIC, sizeof(header->magic))
+    && header->length && header->length <= MAX_REQUEST_LENGTH
+    && header->argc < header->length;
+  char *chars = ok ? (char *) malloc(header->length) : NULL;
+  ok = chars && read_all(conn, chars, header->length) && !chars[header->length - 1];
+  // The payload holds the working directory, the script and each argument.
+  uint32_t numStrings = 0;
+  for (uint32_t i = 0; ok && i < header->length; ++i)
+    numStrings += !chars[i];
+  ok = ok && numStrings == header->argc + 2;
+  if (!ok)
+  {
+    free(chars);
+    for (int i = 0; i < NUM_STDIO_FDS; ++i)
+      (void) close(fds[i]);
+    return false;
+  }
+  *payload = chars;
+  return true;
+}
+
+static inline const char **unpack_args(char *payload, RequestHeader *header)
+{
+  const char **argv = (const char **) malloc(sizeof(*argv) * (header->argc + 1));
+  if (!argv)
+  {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  char *chars = payload;
+  chars += strlen(chars) + 1;
+  chars += strlen(chars) + 1;
+  for (uint32_t i = 0; i < header->argc; ++i)
+  {
+    argv[i] = chars;
+    chars += strlen(chars) + 1;
+  }
+  argv[header->argc] = NULL;
+  return argv;
+}
+
+static inline void stop_handler(int sig)
+{
+  (void) sig;
+  stopping = 1;
+}
+
+static inline void reset_signals(void)
+{
+  signal(SIGCHLD, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGINT, SIG_DFL);
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigprocmask(SIG_SETMASK, &mask, NULL);
+}
+
+static inline pid_t start_worker(PreforkHandler handler, void *data)
+{
+  (void) fflush(NULL);
+  pid_t pid = fork();
+  if (pid)
+    return pid;
+  reset_signals();
+  int code = handler(data);
+  (void) fflush(stdout);
+  (void) fflush(stderr);
+  exit(code);
+}
+
+bool serve(const char *path, ServeHandler handler, void *data)
+{
+  struct sockaddr_un addr;
+  if (!make_address(path, &addr))
+    return false;
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock == -1)
+    return false;
+  (void) unlink(path);
+  if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) || listen(sock, SOMAXCONN))
+  {
+    (void) close(sock);
+    return false;
+  }
+  // SIGCHLD stays blocked except while waiting, so no exit is missed
+  // between reaping and waiting.
+  sigset_t mask;
+  sigset_t waitMask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &mask, &waitMask);
+  sigdelset(&waitMask, SIGCHLD);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = sigchld_handler;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGCHLD, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  WorkerList list = { 0 };
+  for (;;)
+  {
+    reap_workers(&list);
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    int n = pselect(sock + 1, &fds, NULL, NULL, NULL, &waitMask);
+    if (n == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    int conn = accept(sock, NULL, NULL);
+    if (conn == -1)
+      continue;
+    handle_request(sock, conn, &list, handler, data);
+  }
+  (void) close(sock);
+  free(list.workers);
+  return false;
+}
+
+int serve_connect(const char *path, const char *script, int argc, const char **argv)
+{
+  struct sockaddr_un addr;
+  char cwd[PATH_MAX + 1];
+  if (!make_address(path, &addr) || !getcwd(cwd, sizeof(cwd)))
+    return -1;
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock == -1)
+    return -1;
+  if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)))
+  {
+    (void) close(sock);
+    return -1;
+  }
+  size_t length = strlen(cwd) + strlen(script) + 2;
+  for (int i = 0; i < argc; ++i)
+    length += strlen(argv[i]) + 1;
+  char *payload = (char *) malloc(length);
+  if (!payload || length > MAX_REQUEST_LENGTH)
+  {
+    free(payload);
+    (void) close(sock);
+    return -1;
+  }
+  char *chars = payload;
+  chars = stpcpy(chars, cwd) + 1;
+  chars = stpcpy(chars, script) + 1;
+  for (int i = 0; i < argc; ++i)
+    chars = stpcpy(chars, argv[i]) + 1;
+  RequestHeader header = { .length = (uint32_t) length, .argc = (uint32_t) argc };
+  memcpy(header.magic, REQUEST_MAGIC, sizeof(header.magic));
+  // The standard streams are passed along, so the script reads and writes
+  // them directly.
+  int fds[NUM_STDIO_FDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+  char control[CMSG_SPACE(sizeof(fds))];
+  memset(control, 0, sizeof(control));
+  struct iovec iov = { .iov_base = &header, .iov_len = sizeof(header) };
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  signal(SIGPIPE, SIG_IGN);
+  int32_t code;
+  bool ok = sendmsg(sock, &msg, 0) == (ssize_t) sizeof(header)
+    && write_all(sock, payload, length) && read_all(sock, &code, sizeof(code));
+  free(payload);
+  (void) close(sock);
+  return ok ? (int) code : -1;
+}
+
+int prefork(int numWorkers, PreforkHandler handler, void *data)
+{
+  pid_t *pids = (pid_t *) malloc(sizeof(*pids) * numWorkers);
+  time_t *started = (time_t *) malloc(sizeof(*started) * numWorkers);
+  if (!pids || !started)
+  {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  // The signals are only delivered while suspended, so none is missed
+  // between reaping the workers and waiting for the next one.
+  sigset_t mask;
+  sigset_t waitMask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGINT);
+  sigprocmask(SIG_BLOCK, &mask, &waitMask);
+  sigdelset(&waitMask, SIGCHLD);
+  sigdelset(&waitMask, SIGTERM);
+  sigdelset(&waitMask, SIGINT);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  sigemptyset(&action.sa_mask);
+  action.sa_handler = sigchld_handler;
+  sigaction(SIGCHLD, &action, NULL);
+  action.sa_handler = stop_handler;
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGINT, &action, NULL);
+  int exitCode = EXIT_SUCCESS;
+  int numStarted = 0;
+  for (; numStarted < numWorkers; ++numStarted)
+  {
+    pids[numStarted] = start_worker(handler, data);
+    started[numStarted] = time(NULL);
+    if (pids[numStarted] == -1)
+    {
+      perror("fork");
+      exitCode = EXIT_FAILURE;
+      stopping = 1;
+      break;
+    }
+  }
+  while (!stopping)
+  {
+    int status;
+    pid_t pid;
+    while (!stopping && (pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+      int i = 0;
+      while (i < numStarted && pids[i] != pid)
+        ++i;
+      if (i == numStarted)
+        continue;
+      // A worker that keeps failing right away is restarted at most once
+      // a second.
+      if (time(NULL) - started[i] < 1)
+        (void) sleep(1);
+      pids[i] = start_worker(handler, data);
+      started[i] = time(NULL);
+      if (pids[i] == -1)
+      {
+        perror("fork");
+        exitCode = EXIT_FAILURE;
+        stopping = 1;
+      }
+    }
+    if (!stopping)
+      (void) sigsuspend(&waitMask);
+  }
+  for (int i = 0; i < numStarted; ++i)
+    if (pids[i] > 0)
+      (void) kill(pids[i], SIGTERM);
+  while (waitpid(-1, NULL, 0) > 0 || errno == EINTR)
+    continue;
+  free(pids);
+  free(started);
+  return exitCode;
+}
+
+#else
+
+bool serve(const char *path, ServeHandler handler, void *data)
+{
+  (void) path;
+  (void) handler;
+  (void) data;
+  return false;
+}
+
+int serve_connect(const char *path, const char *script, int argc, const char **argv)
+{
+  (void) path;
+  (void) script;
+  (void) argc;
+  (void) argv;
+  return -1;
+}
+
+int prefork(int numWorkers, PreforkHandler handler, void *data)
+{
+  // Without fork(), the only worker is the process itself.
+  (void) numWorkers;
+  return handler(data);
+}
+
+#endif
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(LPVOID arg)
+#else
+static void *thread_main(void *arg)
+#endif
+{
+  Thread *thread = (Thread *) arg;
+  thread->exitCode = thread->handler(thread->data);
+#ifdef _WIN32
+  return 0;
+#else
+  return NULL;
+#endif
+}
+
+int run_threads(int numThreads, ThreadHandler handler, void *data)
+{
+  Thread *threads = (Thread *) malloc(sizeof(*threads) * numThreads);
+  if (!threads)
+    return EXIT_FAILURE;
+#ifndef _WIN32
+  // Threads get as much stack as the main thread usually does, since calls
+  // nest just as deep in every VM.
+  pthread_attr_t attr;
+  (void) pthread_attr_init(&attr);
+  (void) pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+#endif
+  int exitCode = EXIT_SUCCESS;
+  int numStarted = 0;
+  for (; numStarted < numThreads; ++numStarted)
+  {
+    Thread *thread = &threads[numStarted];
+    thread->handler = handler;
+    thread->data = data;
+    thread->exitCode = EXIT_SUCCESS;
+#ifdef _WIN32
+    thread->handle = CreateThread(NULL, THREAD_STACK_SIZE, thread_main, thread,
+      STACK_SIZE_PARAM_IS_A_RESERVATION, NULL);
+    bool started = thread->handle != NULL;
+#else
+    bool started = !pthread_create(&thread->thread, &attr, thread_main, thread);
+#endif
+    if (!started)
+    {
+      fprintf(stderr, "unable to start thread\n");
+      exitCode = EXIT_FAILURE;
+      break;
+    }
+  }
+#ifndef _WIN32
+  (void) pthread_attr_destroy(&attr);
+#endif
+  for (int i = 0; i < numStarted; ++i)
+  {
+    Thread *thread = &threads[i];
+#ifdef _WIN32
+    (void) WaitForSingleObject(thread->handle, INFINITE);
+    (void) CloseHandle(thread->handle);
+#else
+    (void) pthread_join(thread->thread, NULL);
+#endif
+    if (exitCode == EXIT_SUCCESS)
+      exitCode = thread->exitCode;
+  }
+  free(threads);
+  return exitCode;
+}
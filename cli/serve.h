@@ -0,0 +1,25 @@
+//
+// serve.h
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdbool.h>
+
+typedef int (*ServeHandler)(void *data, const char *script, int argc, const char **argv);
+typedef int (*PreforkHandler)(void *data);
+typedef int (*ThreadHandler)(void *data);
+
+bool serve(const char *path, ServeHandler handler, void *data);
+int serve_connect(const char *path, const char *script, int argc, const char **argv);
+int prefork(int numWorkers, PreforkHandler handler, void *data);
+int run_threads(int numThreads, ThreadHandler handler, void *data);
+
+#endif // SERVE_H
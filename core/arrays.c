@@ -175,45 +175,23 @@ static void sort_call(HkVM *vm, HkValue *args)
     hk_array_free(arr);
 }
 
+static const HkNativeEntry natives[] = {
+  { "new_array", 1, new_array_call },
+  { "fill", 2, fill_call },
+  { "index_of", 2, index_of_call },
+  { "min", 1, min_call },
+  { "max", 1, max_call },
+  { "sum", 1, sum_call },
+  { "avg", 1, avg_call },
+  { "reverse", 1, reverse_call },
+  { "sort", 1, sort_call }
+};
+
 HK_LOAD_MODULE_HANDLER(arrays)
 {
   hk_vm_push_string_from_chars(vm, -1, "arrays");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new_array");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new_array", 1, new_array_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "fill");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "fill", 2, fill_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "index_of");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "index_of", 2, index_of_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "min");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "min", 1, min_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "max");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "max", 1, max_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sum");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sum", 1, sum_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "avg");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "avg", 1, avg_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "reverse");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "reverse", 1, reverse_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sort");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sort", 1, sort_call);
+  hk_vm_push_new_natives(vm, 9, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 9);
 }
@@ -146,41 +146,22 @@ static void ascii85_decode_call(HkVM *vm, HkValue *args)
     hk_string_free(result);
 }
 
+static const HkNativeEntry natives[] = {
+  { "base32_encode", 1, base32_encode_call },
+  { "base32_decode", 1, base32_decode_call },
+  { "base58_encode", 1, base58_encode_call },
+  { "base58_decode", 1, base58_decode_call },
+  { "base64_encode", 1, base64_encode_call },
+  { "base64_decode", 1, base64_decode_call },
+  { "ascii85_encode", 1, ascii85_encode_call },
+  { "ascii85_decode", 1, ascii85_decode_call }
+};
+
 HK_LOAD_MODULE_HANDLER(encoding)
 {
   hk_vm_push_string_from_chars(vm, -1, "encoding");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "base32_encode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "base32_encode", 1, base32_encode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "base32_decode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "base32_decode", 1, base32_decode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "base58_encode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "base58_encode", 1, base58_encode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "base58_decode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "base58_decode", 1, base58_decode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "base64_encode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "base64_encode", 1, base64_encode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "base64_decode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "base64_decode", 1, base64_decode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "ascii85_encode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ascii85_encode", 1, ascii85_encode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "ascii85_decode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ascii85_decode", 1, ascii85_decode_call);
+  hk_vm_push_new_natives(vm, 8, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 8);
 }
@@ -183,49 +183,24 @@ static void ripemd160_call(HkVM *vm, HkValue *args)
     hk_string_free(result);
 }
 
+static const HkNativeEntry natives[] = {
+  { "crc32", 1, crc32_call },
+  { "crc64", 1, crc64_call },
+  { "sha224", 1, sha224_call },
+  { "sha256", 1, sha256_call },
+  { "sha384", 1, sha384_call },
+  { "sha512", 1, sha512_call },
+  { "sha1", 1, sha1_call },
+  { "sha3", 1, sha3_call },
+  { "md5", 1, md5_call },
+  { "ripemd160", 1, ripemd160_call }
+};
+
 HK_LOAD_MODULE_HANDLER(hashing)
 {
   hk_vm_push_string_from_chars(vm, -1, "hashing");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "crc32");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "crc32", 1, crc32_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "crc64");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "crc64", 1, crc64_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sha224");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sha224", 1, sha224_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sha256");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sha256", 1, sha256_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sha384");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sha384", 1, sha384_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sha512");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sha512", 1, sha512_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sha1");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sha1", 1, sha1_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sha3");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sha3", 1, sha3_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "md5");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "md5", 1, md5_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "ripemd160");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ripemd160", 1, ripemd160_call);
+  hk_vm_push_new_natives(vm, 10, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 10);
 }
@@ -72,17 +72,16 @@ static void get_call(HkVM *vm, HkValue *args)
   hk_vm_push_string_from_chars(vm, -1, value);
 }
 
+static const HkNativeEntry natives[] = {
+  { "load", 1, load_call },
+  { "get", 3, get_call }
+};
+
 HK_LOAD_MODULE_HANDLER(ini)
 {
   hk_vm_push_string_from_chars(vm, -1, "ini");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "load");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "load", 1, load_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "get");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "get", 3, get_call);
+  hk_vm_push_new_natives(vm, 2, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 2);
 }
@@ -253,6 +253,23 @@ static void writeln_call(HkVM *vm, HkValue *args)
   hk_vm_push_number(vm, size + 1);
 }
 
+static const HkNativeEntry natives[] = {
+  { "open", 2, open_call },
+  { "close", 1, close_call },
+  { "popen", 2, popen_call },
+  { "pclose", 1, pclose_call },
+  { "eof", 1, eof_call },
+  { "flush", 1, flush_call },
+  { "sync", 1, sync_call },
+  { "tell", 1, tell_call },
+  { "rewind", 1, rewind_call },
+  { "seek", 3, seek_call },
+  { "read", 2, read_call },
+  { "write", 2, write_call },
+  { "readln", 1, readln_call },
+  { "writeln", 2, writeln_call }
+};
+
 HK_LOAD_MODULE_HANDLER(io)
 {
   hk_vm_push_string_from_chars(vm, -1, "io");
@@ -281,61 +298,7 @@ HK_LOAD_MODULE_HANDLER(io)
   hk_return_if_not_ok(vm);
   hk_vm_push_number(vm, SEEK_END);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "open");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "open", 2, open_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "close");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "close", 1, close_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "popen");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "popen", 2, popen_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "pclose");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "pclose", 1, pclose_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "eof");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "eof", 1, eof_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "flush");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "flush", 1, flush_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sync");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sync", 1, sync_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "tell");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "tell", 1, tell_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "rewind");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "rewind", 1, rewind_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "seek");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "seek", 3, seek_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "read");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "read", 2, read_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "write");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "write", 2, write_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "readln");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "readln", 1, readln_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "writeln");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "writeln", 2, writeln_call);
+  hk_vm_push_new_natives(vm, 14, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 20);
 }
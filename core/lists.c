@@ -223,45 +223,23 @@ static void back_call(HkVM *vm, HkValue *args)
   hk_vm_push(vm, elem);
 }
 
+static const HkNativeEntry natives[] = {
+  { "new_linked_list", 0, new_linked_list_call },
+  { "len", 1, len_call },
+  { "is_empty", 1, is_empty_call },
+  { "push_front", 2, push_front_call },
+  { "push_back", 2, push_back_call },
+  { "pop_front", 1, pop_front_call },
+  { "pop_back", 1, pop_back_call },
+  { "front", 1, front_call },
+  { "back", 1, back_call }
+};
+
 HK_LOAD_MODULE_HANDLER(lists)
 {
   hk_vm_push_string_from_chars(vm, -1, "lists");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new_linked_list");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new_linked_list", 0, new_linked_list_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "len");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "len", 1, len_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "is_empty");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "is_empty", 1, is_empty_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "push_front");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "push_front", 2, push_front_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "push_back");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "push_back", 2, push_back_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "pop_front");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "pop_front", 1, pop_front_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "pop_back");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "pop_back", 1, pop_back_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "front");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "front", 1, front_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "back");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "back", 1, back_call);
+  hk_vm_push_new_natives(vm, 9, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 9);
 }
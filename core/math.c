@@ -150,77 +150,31 @@ static void exp_call(HkVM *vm, HkValue *args)
   hk_vm_push_number(vm, exp(hk_as_number(args[1])));
 }
 
+static const HkNativeEntry natives[] = {
+  { "abs", 1, abs_call },
+  { "sin", 1, sin_call },
+  { "cos", 1, cos_call },
+  { "tan", 1, tan_call },
+  { "asin", 1, asin_call },
+  { "acos", 1, acos_call },
+  { "atan", 1, atan_call },
+  { "floor", 1, floor_call },
+  { "ceil", 1, ceil_call },
+  { "round", 1, round_call },
+  { "pow", 2, pow_call },
+  { "sqrt", 1, sqrt_call },
+  { "cbrt", 1, cbrt_call },
+  { "log", 0, log_call },
+  { "log2", 0, log2_call },
+  { "log10", 0, log10_call },
+  { "exp", 0, exp_call }
+};
+
 HK_LOAD_MODULE_HANDLER(math)
 {
   hk_vm_push_string_from_chars(vm, -1, "math");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "abs");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "abs", 1, abs_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sin");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sin", 1, sin_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "cos");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "cos", 1, cos_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "tan");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "tan", 1, tan_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "asin");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "asin", 1, asin_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "acos");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "acos", 1, acos_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "atan");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "atan", 1, atan_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "floor");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "floor", 1, floor_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "ceil");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ceil", 1, ceil_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "round");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "round", 1, round_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "pow");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "pow", 2, pow_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sqrt");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sqrt", 1, sqrt_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "cbrt");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "cbrt", 1, cbrt_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "log");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "log", 0, log_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "log2");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "log2", 0, log2_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "log10");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "log10", 0, log10_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "exp");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "exp", 0, exp_call);
+  hk_vm_push_new_natives(vm, 17, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 17);
 }
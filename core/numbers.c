@@ -9,7 +9,6 @@
 //
 
 #include "numbers.h"
-#include <stdlib.h>
 #include <float.h>
 
 #define PI  3.14159265358979323846264338327950288
@@ -21,24 +20,39 @@
 #define MAX_INTEGER 9007199254740991.0
 #define MIN_INTEGER -9007199254740991.0
 
+static inline uint64_t next_random(HkVM *vm);
 static void srand_call(HkVM *vm, HkValue *args);
 static void rand_call(HkVM *vm, HkValue *args);
 
+static inline uint64_t next_random(HkVM *vm)
+{
+  // SplitMix64, seeded per VM instead of through the process-wide rand().
+  uint64_t z = (vm->randState += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
 static void srand_call(HkVM *vm, HkValue *args)
 {
   hk_vm_check_argument_number(vm, args, 1);
   hk_return_if_not_ok(vm);
-  srand((uint32_t) hk_as_number(args[1]));
+  vm->randState = (uint64_t) (uint32_t) hk_as_number(args[1]);
   hk_vm_push_nil(vm);
 }
 
 static void rand_call(HkVM *vm, HkValue *args)
 {
   (void) args;
-  double result = (double) rand() / RAND_MAX;
+  double result = (double) (next_random(vm) >> 11) / (double) (UINT64_C(1) << 53);
   hk_vm_push_number(vm, result);
 }
 
+static const HkNativeEntry natives[] = {
+  { "srand", 1, srand_call },
+  { "rand", 0, rand_call }
+};
+
 HK_LOAD_MODULE_HANDLER(numbers)
 {
   hk_vm_push_string_from_chars(vm, -1, "numbers");
@@ -67,13 +81,7 @@ HK_LOAD_MODULE_HANDLER(numbers)
   hk_return_if_not_ok(vm);
   hk_vm_push_number(vm, MIN_INTEGER);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "srand");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "srand", 1, srand_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "rand");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "rand", 0, rand_call);
+  hk_vm_push_new_natives(vm, 2, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 8);
 }
@@ -103,6 +103,15 @@ static void name_call(HkVM *vm, HkValue *args)
   hk_vm_push_string_from_chars(vm, -1, result);
 }
 
+static const HkNativeEntry natives[] = {
+  { "clock", 0, clock_call },
+  { "time", 0, time_call },
+  { "system", 1, system_call },
+  { "getenv", 1, getenv_call },
+  { "getcwd", 1, getcwd_call },
+  { "name", 0, name_call }
+};
+
 HK_LOAD_MODULE_HANDLER(os)
 {
   hk_vm_push_string_from_chars(vm, -1, "os");
@@ -111,29 +120,7 @@ HK_LOAD_MODULE_HANDLER(os)
   hk_return_if_not_ok(vm);
   hk_vm_push_number(vm, CLOCKS_PER_SEC);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "clock");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "clock", 0, clock_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "time");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "time", 0, time_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "system");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "system", 1, system_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "getenv");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "getenv", 1, getenv_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "getcwd");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "getcwd", 1, getcwd_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "name");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "name", 0, name_call);
+  hk_vm_push_new_natives(vm, 6, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 7);
 }
@@ -43,10 +43,6 @@ typedef struct
   SocketUserdata *udatas[MAX_FDS];
 } PollSelector;
 
-#ifdef _WIN32
-  static int initialized = 0;
-#endif
-
 #ifdef _WIN32
   static inline void startup(void);
   static inline void cleanup(void);
@@ -71,18 +67,12 @@ static void poll_call(HkVM *vm, HkValue *args);
 #ifdef _WIN32
   static inline void startup(void)
   {
-    if (!initialized)
-    {
-      WSADATA wsa;
-      (void) WSAStartup(MAKEWORD(2, 2), &wsa);
-    }
-    ++initialized;
+    WSADATA wsa;
+    (void) WSAStartup(MAKEWORD(2, 2), &wsa);
   }
 
   static inline void cleanup(void)
   {
-    --initialized;
-    if (initialized) return;
     (void) WSACleanup();
   }
 #endif
@@ -268,6 +258,14 @@ static void poll_call(HkVM *vm, HkValue *args)
     hk_array_free(arr);
 }
 
+static const HkNativeEntry natives[] = {
+  { "new_poll_selector", 0, new_poll_selector_call },
+  { "register", 3, register_call },
+  { "unregister", 2, unregister_call },
+  { "modify", 3, modify_call },
+  { "poll", 2, poll_call }
+};
+
 HK_LOAD_MODULE_HANDLER(selectors)
 {
   hk_vm_push_string_from_chars(vm, -1, "selectors");
@@ -296,25 +294,7 @@ HK_LOAD_MODULE_HANDLER(selectors)
   hk_return_if_not_ok(vm);
   hk_vm_push_number(vm, POLLPRI);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new_poll_selector");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new_poll_selector", 0, new_poll_selector_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "register");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "register", 3, register_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "unregister");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "unregister", 2, unregister_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "modify");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "modify", 3, modify_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "poll");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "poll", 2, poll_call);
+  hk_vm_push_new_natives(vm, 5, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 11);
 }
@@ -26,6 +26,8 @@
 #ifdef _WIN32
   #define Socket    SOCKET
   #define socklen_t int
+  // Winsock lets sockets with SO_REUSEADDR share a port.
+  #define SO_REUSEPORT SO_REUSEADDR
 #endif
 
 #ifndef _WIN32
@@ -45,10 +47,6 @@ typedef struct
   Socket sock;
 } SocketUserdata;
 
-#ifdef _WIN32
-  static int initialized = 0;
-#endif
-
 static inline void socket_startup(void);
 static inline void socket_cleanup(void);
 static inline void socket_close(Socket sock);
@@ -73,22 +71,18 @@ static void set_nonblock_call(HkVM *vm, HkValue *args);
 
 static inline void socket_startup(void)
 {
+  // Winsock counts the calls itself, and unlike a counter of our own, it is
+  // safe to use from VMs on different threads.
 #ifdef _WIN32
-  if (!initialized)
-  {
-    WSADATA wsa;
-    (void) WSAStartup(MAKEWORD(2, 2), &wsa);
-  }
-  ++initialized;
+  WSADATA wsa;
+  (void) WSAStartup(MAKEWORD(2, 2), &wsa);
 #endif
 }
 
 static inline void socket_cleanup(void)
 {
 #ifdef _WIN32
-  --initialized;
-  if (!initialized)
-    (void) WSACleanup();
+  (void) WSACleanup();
 #endif
 }
 
@@ -249,6 +243,8 @@ static void accept_call(HkVM *vm, HkValue *args)
     hk_vm_push_nil(vm);
     return;
   }
+  // Every socket is closed with a cleanup, so accepted ones start up too.
+  socket_startup();
   SocketUserdata *result = socket_userdata_new(sock, udata->domain, udata->type, udata->protocol);
   hk_vm_push_userdata(vm, (HkUserdata *) result);
 }
@@ -491,6 +487,23 @@ static void set_nonblock_call(HkVM *vm, HkValue *args)
   hk_vm_push_nil(vm);
 }
 
+static const HkNativeEntry natives[] = {
+  { "new", 3, new_call },
+  { "close", 1, close_call },
+  { "connect", 3, connect_call },
+  { "accept", 1, accept_call },
+  { "bind", 3, bind_call },
+  { "listen", 2, listen_call },
+  { "send", 3, send_call },
+  { "recv", 3, recv_call },
+  { "writeln", 2, writeln_call },
+  { "readln", 1, readln_call },
+  { "set_option", 4, set_option_call },
+  { "get_option", 3, get_option_call },
+  { "set_block", 1, set_block_call },
+  { "set_nonblock", 1, set_nonblock_call }
+};
+
 HK_LOAD_MODULE_HANDLER(socket)
 {
   hk_vm_push_string_from_chars(vm, -1, "socket");
@@ -527,61 +540,11 @@ HK_LOAD_MODULE_HANDLER(socket)
   hk_return_if_not_ok(vm);
   hk_vm_push_number(vm, SO_REUSEADDR);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new", 3, new_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "close");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "close", 1, close_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "connect");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "connect", 3, connect_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "accept");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "accept", 1, accept_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "bind");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "bind", 3, bind_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "listen");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "listen", 2, listen_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "send");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "send", 3, send_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "recv");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "recv", 3, recv_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "writeln");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "writeln", 2, writeln_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "readln");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "readln", 1, readln_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "set_option");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "set_option", 4, set_option_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "get_option");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "get_option", 3, get_option_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "set_block");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "set_block", 1, set_block_call);
+  hk_vm_push_string_from_chars(vm, -1, "SO_REUSEPORT");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "set_nonblock");
+  hk_vm_push_number(vm, SO_REUSEPORT);
   hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "set_nonblock", 1, set_nonblock_call);
+  hk_vm_push_new_natives(vm, 14, natives);
   hk_return_if_not_ok(vm);
-  hk_vm_construct(vm, 22);
+  hk_vm_construct(vm, 23);
 }
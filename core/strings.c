@@ -20,6 +20,8 @@ static void trim_call(HkVM *vm, HkValue *args);
 static void starts_with_call(HkVM *vm, HkValue *args);
 static void ends_with_call(HkVM *vm, HkValue *args);
 static void reverse_call(HkVM *vm, HkValue *args);
+static void compare_ignore_case_call(HkVM *vm, HkValue *args);
+static void starts_with_ignore_case_call(HkVM *vm, HkValue *args);
 
 static void new_string_call(HkVM *vm, HkValue *args)
 {
@@ -69,7 +71,14 @@ static void lower_call(HkVM *vm, HkValue *args)
 {
   hk_vm_check_argument_string(vm, args, 1);
   hk_return_if_not_ok(vm);
-  HkString *str = hk_string_lower(hk_as_string(args[1]));
+  HkString *str = hk_as_string(args[1]);
+  if (str->refCount == 1)
+  {
+    hk_string_inplace_lower(str);
+    hk_vm_push_string(vm, str);
+    return;
+  }
+  str = hk_string_lower(str);
   hk_vm_push_string(vm, str);
   if (!hk_vm_is_ok(vm))
     hk_string_free(str);
@@ -79,7 +88,14 @@ static void upper_call(HkVM *vm, HkValue *args)
 {
   hk_vm_check_argument_string(vm, args, 1);
   hk_return_if_not_ok(vm);
-  HkString *str = hk_string_upper(hk_as_string(args[1]));
+  HkString *str = hk_as_string(args[1]);
+  if (str->refCount == 1)
+  {
+    hk_string_inplace_upper(str);
+    hk_vm_push_string(vm, str);
+    return;
+  }
+  str = hk_string_upper(str);
   hk_vm_push_string(vm, str);
   if (!hk_vm_is_ok(vm))
     hk_string_free(str);
@@ -89,8 +105,14 @@ static void trim_call(HkVM *vm, HkValue *args)
 {
   hk_vm_check_argument_string(vm, args, 1);
   hk_return_if_not_ok(vm);
-  HkString *str;
-  if (!hk_string_trim(hk_as_string(args[1]), &str))
+  HkString *str = hk_as_string(args[1]);
+  if (str->refCount == 1)
+  {
+    hk_string_inplace_trim(str);
+    hk_vm_push_string(vm, str);
+    return;
+  }
+  if (!hk_string_trim(str, &str))
     return;
   hk_vm_push_string(vm, str);
   if (!hk_vm_is_ok(vm))
@@ -119,51 +141,56 @@ static void reverse_call(HkVM *vm, HkValue *args)
 {
   hk_vm_check_argument_string(vm, args, 1);
   hk_return_if_not_ok(vm);
-  HkString *str = hk_string_reverse(hk_as_string(args[1]));
+  HkString *str = hk_as_string(args[1]);
+  if (str->refCount == 1)
+  {
+    hk_string_inplace_reverse(str);
+    hk_vm_push_string(vm, str);
+    return;
+  }
+  str = hk_string_reverse(str);
   hk_vm_push_string(vm, str);
   if (!hk_vm_is_ok(vm))
     hk_string_free(str);
 }
 
-HK_LOAD_MODULE_HANDLER(strings)
+static void compare_ignore_case_call(HkVM *vm, HkValue *args)
 {
-  hk_vm_push_string_from_chars(vm, -1, "strings");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new_string");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new_string", 1, new_string_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "repeat");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "repeat", 2, repeat_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "hash");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "hash", 1, hash_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "lower");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "lower", 1, lower_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "upper");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "upper", 1, upper_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "trim");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "trim", 1, trim_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "starts_with");
+  hk_vm_check_argument_string(vm, args, 1);
   hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "starts_with", 2, starts_with_call);
+  hk_vm_check_argument_string(vm, args, 2);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "ends_with");
+  hk_vm_push_number(vm, hk_string_compare_ignore_case(hk_as_string(args[1]), hk_as_string(args[2])));
+}
+
+static void starts_with_ignore_case_call(HkVM *vm, HkValue *args)
+{
+  hk_vm_check_argument_string(vm, args, 1);
   hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ends_with", 2, ends_with_call);
+  hk_vm_check_argument_string(vm, args, 2);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "reverse");
+  hk_vm_push_bool(vm, hk_string_starts_with_ignore_case(hk_as_string(args[1]), hk_as_string(args[2])));
+}
+
+static const HkNativeEntry natives[] = {
+  { "new_string", 1, new_string_call },
+  { "repeat", 2, repeat_call },
+  { "hash", 1, hash_call },
+  { "lower", 1, lower_call },
+  { "upper", 1, upper_call },
+  { "trim", 1, trim_call },
+  { "starts_with", 2, starts_with_call },
+  { "ends_with", 2, ends_with_call },
+  { "reverse", 1, reverse_call },
+  { "compare_ignore_case", 2, compare_ignore_case_call },
+  { "starts_with_ignore_case", 2, starts_with_ignore_case_call }
+};
+
+HK_LOAD_MODULE_HANDLER(strings)
+{
+  hk_vm_push_string_from_chars(vm, -1, "strings");
   hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "reverse", 1, reverse_call);
+  hk_vm_push_new_natives(vm, 11, natives);
   hk_return_if_not_ok(vm);
-  hk_vm_construct(vm, 9);
+  hk_vm_construct(vm, 11);
 }
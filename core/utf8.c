@@ -10,9 +10,37 @@
 
 #include "utf8.h"
 
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+#define BLOCK_SIZE 16
+
+typedef struct
+{
+  HK_ITERATOR_HEADER
+  HkString *str;
+  int      offset;
+} CodepointIterator;
+
 static inline int decode_char(unsigned char c);
+static inline int decode_codepoint(const char *chars, int length);
+static inline int ascii_length(const char *chars, int length);
+static inline bool is_valid(const char *chars, int length);
+static inline int count_codepoints(const char *chars, int length);
+static inline int walk(const char *chars, int length, int start, int count, int *end);
+static inline HkStringIndex *get_index(HkString *str);
+static inline int offset_of(HkString *str, HkStringIndex *index, int codepoint);
+static inline CodepointIterator *codepoint_iterator_allocate(HkString *str, int offset);
+static void codepoint_iterator_deinit(HkIterator *it);
+static bool codepoint_iterator_is_valid(HkIterator *it);
+static HkValue codepoint_iterator_get_current(HkIterator *it);
+static HkIterator *codepoint_iterator_next(HkIterator *it);
+static void codepoint_iterator_inplace_next(HkIterator *it);
 static void len_call(HkVM *vm, HkValue *args);
 static void sub_call(HkVM *vm, HkValue *args);
+static void valid_call(HkVM *vm, HkValue *args);
+static void iter_call(HkVM *vm, HkValue *args);
 
 static inline int decode_char(unsigned char c)
 {
@@ -27,21 +55,212 @@ static inline int decode_char(unsigned char c)
   return 1;
 }
 
+static inline int decode_codepoint(const char *chars, int length)
+{
+  const unsigned char *bytes = (const unsigned char *) chars;
+  int n = decode_char(bytes[0]);
+  if (n > length)
+    n = length;
+  int result = n == 1 ? bytes[0] : bytes[0] & (0x7f >> n);
+  for (int i = 1; i < n; ++i)
+    result = (result << 6) | (bytes[i] & 0x3f);
+  return result;
+}
+
+static inline int ascii_length(const char *chars, int length)
+{
+  int i = 0;
+#ifdef __SSE2__
+  for (; i + BLOCK_SIZE <= length; i += BLOCK_SIZE)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i *) &chars[i]);
+    if (_mm_movemask_epi8(block))
+      break;
+  }
+#endif
+  while (i < length && !(chars[i] & 0x80))
+    ++i;
+  return i;
+}
+
+static inline bool is_valid(const char *chars, int length)
+{
+  const unsigned char *bytes = (const unsigned char *) chars;
+  int i = 0;
+  for (;;)
+  {
+    i += ascii_length(&chars[i], length - i);
+    if (i == length)
+      break;
+    unsigned char c = bytes[i];
+    int n = decode_char(c);
+    if (n < 2 || c < 0xc2 || c > 0xf4 || i + n > length)
+      return false;
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+    if (c == 0xe0)
+      low = 0xa0;
+    else if (c == 0xed)
+      high = 0x9f;
+    else if (c == 0xf0)
+      low = 0x90;
+    else if (c == 0xf4)
+      high = 0x8f;
+    if (bytes[i + 1] < low || bytes[i + 1] > high)
+      return false;
+    for (int j = 2; j < n; ++j)
+      if ((bytes[i + j] & 0xc0) != 0x80)
+        return false;
+    i += n;
+  }
+  return true;
+}
+
+static inline int count_codepoints(const char *chars, int length)
+{
+  int result = 0;
+  int i = 0;
+#ifdef __SSE2__
+  // Continuation bytes (0x80-0xbf) are exactly the bytes below -64 when
+  // read as signed, so each block counts its leading bytes in one compare.
+  __m128i limit = _mm_set1_epi8(-64);
+  for (; i + BLOCK_SIZE <= length; i += BLOCK_SIZE)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i *) &chars[i]);
+    unsigned int mask = (unsigned int) _mm_movemask_epi8(_mm_cmplt_epi8(block, limit));
+    for (; mask; mask &= mask - 1)
+      --result;
+    result += BLOCK_SIZE;
+  }
+#endif
+  for (; i < length; ++i)
+    if ((chars[i] & 0xc0) != 0x80)
+      ++result;
+  return result;
+}
+
+static inline int walk(const char *chars, int length, int start, int count, int *end)
+{
+  int i = start;
+  int result = 0;
+  while (i < length && result < count)
+  {
+    int n = decode_char((unsigned char) chars[i]);
+    if (!n)
+      break;
+    i += n;
+    ++result;
+  }
+  *end = i < length ? i : length;
+  return result;
+}
+
+static inline HkStringIndex *get_index(HkString *str)
+{
+  HkStringIndex *index = str->index;
+  if (index)
+    return index;
+  int length = str->length;
+  int asciiLength = ascii_length(str->chars, length);
+  if (asciiLength == length)
+  {
+    index = (HkStringIndex *) hk_allocate(sizeof(*index));
+    index->length = length;
+    str->index = index;
+    return index;
+  }
+  int offset;
+  int numCodepoints = walk(str->chars, length, 0, length, &offset);
+  int numOffsets = numCodepoints / HK_STRING_INDEX_STRIDE + 1;
+  index = (HkStringIndex *) hk_allocate(sizeof(*index) + sizeof(int) * numOffsets);
+  index->length = numCodepoints;
+  offset = 0;
+  index->offsets[0] = 0;
+  for (int i = 1; i < numOffsets; ++i)
+  {
+    walk(str->chars, length, offset, HK_STRING_INDEX_STRIDE, &offset);
+    index->offsets[i] = offset;
+  }
+  str->index = index;
+  return index;
+}
+
+static inline int offset_of(HkString *str, HkStringIndex *index, int codepoint)
+{
+  if (index->length == str->length)
+    return codepoint;
+  int offset = index->offsets[codepoint / HK_STRING_INDEX_STRIDE];
+  walk(str->chars, str->length, offset, codepoint % HK_STRING_INDEX_STRIDE, &offset);
+  return offset;
+}
+
+static inline CodepointIterator *codepoint_iterator_allocate(HkString *str, int offset)
+{
+  CodepointIterator *cpIt = (CodepointIterator *) hk_allocate(sizeof(*cpIt));
+  hk_iterator_init((HkIterator *) cpIt, codepoint_iterator_deinit,
+    codepoint_iterator_is_valid, codepoint_iterator_get_current,
+    codepoint_iterator_next, codepoint_iterator_inplace_next);
+  hk_incr_ref(str);
+  cpIt->str = str;
+  cpIt->offset = offset;
+  return cpIt;
+}
+
+static void codepoint_iterator_deinit(HkIterator *it)
+{
+  hk_string_release(((CodepointIterator *) it)->str);
+}
+
+static bool codepoint_iterator_is_valid(HkIterator *it)
+{
+  CodepointIterator *cpIt = (CodepointIterator *) it;
+  HkString *str = cpIt->str;
+  int offset = cpIt->offset;
+  return offset < str->length && decode_char((unsigned char) str->chars[offset]);
+}
+
+static HkValue codepoint_iterator_get_current(HkIterator *it)
+{
+  CodepointIterator *cpIt = (CodepointIterator *) it;
+  HkString *str = cpIt->str;
+  int offset = cpIt->offset;
+  return hk_number_value(decode_codepoint(&str->chars[offset], str->length - offset));
+}
+
+static HkIterator *codepoint_iterator_next(HkIterator *it)
+{
+  CodepointIterator *cpIt = (CodepointIterator *) it;
+  HkString *str = cpIt->str;
+  int offset;
+  walk(str->chars, str->length, cpIt->offset, 1, &offset);
+  return (HkIterator *) codepoint_iterator_allocate(str, offset);
+}
+
+static void codepoint_iterator_inplace_next(HkIterator *it)
+{
+  CodepointIterator *cpIt = (CodepointIterator *) it;
+  HkString *str = cpIt->str;
+  walk(str->chars, str->length, cpIt->offset, 1, &cpIt->offset);
+}
+
 static void len_call(HkVM *vm, HkValue *args)
 {
   hk_vm_check_argument_string(vm, args, 1);
   hk_return_if_not_ok(vm);
   HkString *str = hk_as_string(args[1]);
-  int result = 0;
-  for (int i = 0; i < str->length;)
+  if (str->index)
   {
-    int length = decode_char((unsigned char) str->chars[i]);
-    if (!length)
-      break;
-    i += length;
-    ++result;
+    hk_vm_push_number(vm, str->index->length);
+    return;
+  }
+  int length = str->length;
+  if (is_valid(str->chars, length))
+  {
+    hk_vm_push_number(vm, count_codepoints(str->chars, length));
+    return;
   }
-  hk_vm_push_number(vm, result);
+  int end;
+  hk_vm_push_number(vm, walk(str->chars, length, 0, length, &end));
 }
 
 static void sub_call(HkVM *vm, HkValue *args)
@@ -55,42 +274,55 @@ static void sub_call(HkVM *vm, HkValue *args)
   HkString *str = hk_as_string(args[1]);
   int start = (int) hk_as_number(args[2]);
   int end = (int) hk_as_number(args[3]);
-  int length = 0;
-  int i = 0;
-  while (i < str->length)
-  {
-    int n = decode_char((unsigned char) str->chars[i]);
-    if (!n || length == start)
-      break;
-    i += n;
-    ++length;
-  }
-  start = i;
-  while (i < str->length)
+  if (str->length < HK_STRING_INDEX_STRIDE)
   {
-    int n = decode_char((unsigned char) str->chars[i]);
-    if (!n || length == end)
-      break;
-    i += n;
-    ++length;
+    int length = str->length;
+    int count = start < 0 ? length : start;
+    walk(str->chars, length, 0, count, &start);
+    count = end < count ? length : end - count;
+    walk(str->chars, length, start, count, &end);
+    hk_vm_push_string_from_chars(vm, end - start, &str->chars[start]);
+    return;
   }
-  end = i;
-  length = end - start;
-  char *chars = &str->chars[start];
-  hk_vm_push_string_from_chars(vm, length, chars);
+  HkStringIndex *index = get_index(str);
+  int length = index->length;
+  start = start < 0 || start > length ? length : start;
+  end = end < start || end > length ? length : end;
+  start = offset_of(str, index, start);
+  end = offset_of(str, index, end);
+  hk_vm_push_string_from_chars(vm, end - start, &str->chars[start]);
 }
 
-HK_LOAD_MODULE_HANDLER(utf8)
+static void valid_call(HkVM *vm, HkValue *args)
 {
-  hk_vm_push_string_from_chars(vm, -1, "utf8");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "len");
+  hk_vm_check_argument_string(vm, args, 1);
   hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "len", 1, len_call);
+  HkString *str = hk_as_string(args[1]);
+  hk_vm_push_bool(vm, is_valid(str->chars, str->length));
+}
+
+static void iter_call(HkVM *vm, HkValue *args)
+{
+  hk_vm_check_argument_string(vm, args, 1);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sub");
+  HkIterator *it = (HkIterator *) codepoint_iterator_allocate(hk_as_string(args[1]), 0);
+  hk_vm_push_iterator(vm, it);
+  if (!hk_vm_is_ok(vm))
+    hk_iterator_free(it);
+}
+
+static const HkNativeEntry natives[] = {
+  { "len", 1, len_call },
+  { "sub", 3, sub_call },
+  { "valid", 1, valid_call },
+  { "iter", 1, iter_call }
+};
+
+HK_LOAD_MODULE_HANDLER(utf8)
+{
+  hk_vm_push_string_from_chars(vm, -1, "utf8");
   hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sub", 3, sub_call);
+  hk_vm_push_new_natives(vm, 4, natives);
   hk_return_if_not_ok(vm);
-  hk_vm_construct(vm, 2);
+  hk_vm_construct(vm, 4);
 }
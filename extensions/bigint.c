@@ -494,93 +494,35 @@ static void testbit_call(HkVM *vm, HkValue *args)
   hk_vm_push_number(vm, result);
 }
 
+static const HkNativeEntry natives[] = {
+  { "new", 2, new_call },
+  { "from_string", 2, from_string_call },
+  { "to_string", 2, to_string_call },
+  { "from_bytes", 1, from_bytes_call },
+  { "to_bytes", 1, to_bytes_call },
+  { "sign", 1, sign_call },
+  { "add", 2, add_call },
+  { "sub", 2, sub_call },
+  { "mul", 2, mul_call },
+  { "div", 2, div_call },
+  { "mod", 2, mod_call },
+  { "pow", 2, pow_call },
+  { "powm", 3, powm_call },
+  { "sqrt", 1, sqrt_call },
+  { "sqrtm_prime", 2, sqrtm_prime_call },
+  { "neg", 1, neg_call },
+  { "abs", 1, abs_call },
+  { "compare", 2, compare_call },
+  { "invertm", 2, invertm_call },
+  { "size", 2, size_call },
+  { "testbit", 2, testbit_call }
+};
+
 HK_LOAD_MODULE_HANDLER(bigint)
 {
   hk_vm_push_string_from_chars(vm, -1, "bigint");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new", 2, new_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "from_string");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "from_string", 2, from_string_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "to_string");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "to_string", 2, to_string_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "from_bytes");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "from_bytes", 1, from_bytes_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "to_bytes");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "to_bytes", 1, to_bytes_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sign");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sign", 1, sign_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "add");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "add", 2, add_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sub");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sub", 2, sub_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "mul");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "mul", 2, mul_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "div");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "div", 2, div_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "mod");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "mod", 2, mod_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "pow");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "pow", 2, pow_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "powm");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "powm", 3, powm_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sqrt");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sqrt", 1, sqrt_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sqrtm_prime");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sqrtm_prime", 2, sqrtm_prime_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "neg");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "neg", 1, neg_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "abs");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "abs", 1, abs_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "compare");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "compare", 2, compare_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "invertm");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "invertm", 2, invertm_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "size");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "size", 2, size_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "testbit");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "testbit", 2, testbit_call);
+  hk_vm_push_new_natives(vm, 21, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 21);
 }
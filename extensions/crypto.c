@@ -111,21 +111,17 @@ end:
     hk_array_free(arr);
 }
 
+static const HkNativeEntry natives[] = {
+  { "random_bytes", 1, random_bytes_call },
+  { "rc4_encrypt", 2, rc4_encrypt_call },
+  { "rc4_decrypt", 2, rc4_decrypt_call }
+};
+
 HK_LOAD_MODULE_HANDLER(crypto)
 {
   hk_vm_push_string_from_chars(vm, -1, "crypto");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "random_bytes");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "random_bytes", 1, random_bytes_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "rc4_encrypt");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "rc4_encrypt", 2, rc4_encrypt_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "rc4_decrypt");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "rc4_decrypt", 2, rc4_decrypt_call);
+  hk_vm_push_new_natives(vm, 3, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 3);
 }
@@ -259,6 +259,16 @@ static void getinfo_call(HkVM *vm, HkValue *args)
   hk_vm_push_number(vm, (double) value);
 }
 
+static const HkNativeEntry natives[] = {
+  { "init", 1, init_call },
+  { "setopt", 3, setopt_call },
+  { "close", 1, close_call },
+  { "exec", 1, exec_call },
+  { "errno", 1, errno_call },
+  { "error", 1, error_call },
+  { "getinfo", 2, getinfo_call }
+};
+
 HK_LOAD_MODULE_HANDLER(curl)
 {
   hk_vm_push_string_from_chars(vm, -1, "curl");
@@ -287,33 +297,7 @@ HK_LOAD_MODULE_HANDLER(curl)
   hk_return_if_not_ok(vm);
   hk_vm_push_number(vm, CURLINFO_RESPONSE_CODE);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "init");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "init", 1, init_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "setopt");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "setopt", 3, setopt_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "close");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "close", 1, close_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "exec");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "exec", 1, exec_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "errno");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "errno", 1, errno_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "error");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "error", 1, error_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "getinfo");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "getinfo", 2, getinfo_call);
+  hk_vm_push_new_natives(vm, 7, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 13);
 }
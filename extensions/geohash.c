@@ -54,17 +54,16 @@ static void decode_call(HkVM *vm, HkValue *args)
     hk_array_free(arr);
 }
 
+static const HkNativeEntry natives[] = {
+  { "encode", 2, encode_call },
+  { "decode", 1, decode_call }
+};
+
 HK_LOAD_MODULE_HANDLER(geohash)
 {
   hk_vm_push_string_from_chars(vm, -1, "geohash");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "encode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "encode", 2, encode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "decode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "decode", 1, decode_call);
+  hk_vm_push_new_natives(vm, 2, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 2);
 }
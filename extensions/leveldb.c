@@ -281,45 +281,23 @@ static void delete_call(HkVM *vm, HkValue *args)
   hk_vm_push_array(vm, arr);
 }
 
+static const HkNativeEntry natives[] = {
+  { "new_options", 0, new_options_call },
+  { "new_read_options", 0, new_read_options_call },
+  { "new_write_options", 0, new_write_options_call },
+  { "options_set_create_if_missing", 2, options_set_create_if_missing_call },
+  { "open", 2, open_call },
+  { "close", 1, close_call },
+  { "put", 4, put_call },
+  { "get", 3, get_call },
+  { "delete", 3, delete_call }
+};
+
 HK_LOAD_MODULE_HANDLER(leveldb)
 {
   hk_vm_push_string_from_chars(vm, -1, "leveldb");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new_options");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new_options", 0, new_options_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new_read_options");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new_read_options", 0, new_read_options_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new_write_options");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new_write_options", 0, new_write_options_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "options_set_create_if_missing");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "options_set_create_if_missing", 2, options_set_create_if_missing_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "open");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "open", 2, open_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "close");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "close", 1, close_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "put");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "put", 4, put_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "get");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "get", 3, get_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "delete");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "delete", 3, delete_call);
+  hk_vm_push_new_natives(vm, 9, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 9);
 }
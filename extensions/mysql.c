@@ -265,41 +265,22 @@ static void affected_rows_call(HkVM *vm, HkValue *args)
   hk_vm_push_number(vm, (double) mysql_affected_rows(mysql));
 }
 
+static const HkNativeEntry natives[] = {
+  { "connect", 5, connect_call },
+  { "close", 1, close_call },
+  { "ping", 1, ping_call },
+  { "error", 1, error_call },
+  { "select_db", 2, select_db_call },
+  { "query", 2, query_call },
+  { "fetch_row", 1, fetch_row_call },
+  { "affected_rows", 1, affected_rows_call }
+};
+
 HK_LOAD_MODULE_HANDLER(mysql)
 {
   hk_vm_push_string_from_chars(vm, -1, "mysql");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "connect");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "connect", 5, connect_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "close");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "close", 1, close_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "ping");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ping", 1, ping_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "error");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "error", 1, error_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "select_db");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "select_db", 2, select_db_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "query");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "query", 2, query_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "fetch_row");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "fetch_row", 1, fetch_row_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "affected_rows");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "affected_rows", 1, affected_rows_call);
+  hk_vm_push_new_natives(vm, 8, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 8);
 }
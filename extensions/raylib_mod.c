@@ -1563,714 +1563,197 @@ static inline void load_colors(HkVM *vm)
   hk_return_if_not_ok(vm);
 }
 
-static inline void load_functions(HkVM *vm)
-{
+static const HkNativeEntry natives[] = {
   // Window-related functions
-  hk_vm_push_string_from_chars(vm, -1, "InitWindow");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "InitWindow", 3, InitWindow_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "CloseWindow");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CloseWindow", 0, CloseWindow_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "WindowShouldClose");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "WindowShouldClose", 0, WindowShouldClose_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsWindowReady");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsWindowReady", 0, IsWindowReady_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsWindowFullscreen");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsWindowFullscreen", 0, IsWindowFullscreen_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsWindowHidden");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsWindowHidden", 0, IsWindowHidden_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsWindowMinimized");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsWindowMinimized", 0, IsWindowMinimized_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsWindowMaximized");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsWindowMaximized", 0, IsWindowMaximized_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsWindowFocused");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsWindowFocused", 0, IsWindowFocused_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsWindowResized");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsWindowResized", 0, IsWindowResized_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsWindowState");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsWindowState", 1, IsWindowState_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowState");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowState", 1, SetWindowState_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "ClearWindowState");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ClearWindowState", 1, ClearWindowState_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "ToggleFullscreen");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ToggleFullscreen", 0, ToggleFullscreen_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "ToggleBorderlessWindowed");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ToggleBorderlessWindowed", 0, ToggleBorderlessWindowed_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "MaximizeWindow");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "MaximizeWindow", 0, MaximizeWindow_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "MinimizeWindow");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "MinimizeWindow", 0, MinimizeWindow_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "RestoreWindow");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "RestoreWindow", 0, RestoreWindow_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowIcon");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowIcon", 1, SetWindowIcon_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowIcons");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowIcons", 1, SetWindowIcons_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowTitle");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowTitle", 1, SetWindowTitle_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowPosition");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowPosition", 2, SetWindowPosition_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowMonitor");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowMonitor", 1, SetWindowMonitor_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowMinSize");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowMinSize", 2, SetWindowMinSize_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowMaxSize");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowMaxSize", 2, SetWindowMaxSize_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowSize");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowSize", 2, SetWindowSize_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowOpacity");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowOpacity", 1, SetWindowOpacity_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetWindowFocused");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetWindowFocused", 0, SetWindowFocused_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetScreenWidth");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetScreenWidth", 0, GetScreenWidth_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetScreenHeight");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetScreenHeight", 0, GetScreenHeight_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetRenderWidth");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetRenderWidth", 0, GetRenderWidth_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetRenderHeight");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetRenderHeight", 0, GetRenderHeight_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetMonitorCount");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetMonitorCount", 0, GetMonitorCount_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetCurrentMonitor");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetCurrentMonitor", 0, GetCurrentMonitor_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetMonitorPosition");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetMonitorPosition", 1, GetMonitorPosition_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetMonitorWidth");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetMonitorWidth", 1, GetMonitorWidth_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetMonitorHeight");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetMonitorHeight", 1, GetMonitorHeight_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetMonitorPhysicalWidth");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetMonitorPhysicalWidth", 1, GetMonitorPhysicalWidth_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetMonitorPhysicalHeight");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetMonitorPhysicalHeight", 1, GetMonitorPhysicalHeight_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetMonitorRefreshRate");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetMonitorRefreshRate", 1, GetMonitorRefreshRate_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetWindowPosition");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetWindowPosition", 0, GetWindowPosition_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetWindowScaleDPI");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetWindowScaleDPI", 0, GetWindowScaleDPI_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetMonitorName");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetMonitorName", 1, GetMonitorName_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetClipboardText");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetClipboardText", 1, SetClipboardText_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetClipboardText");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetClipboardText", 0, GetClipboardText_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "EnableEventWaiting");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "EnableEventWaiting", 0, EnableEventWaiting_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DisableEventWaiting");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DisableEventWaiting", 0, DisableEventWaiting_call);
-  hk_return_if_not_ok(vm);
+  { "InitWindow", 3, InitWindow_call },
+  { "CloseWindow", 0, CloseWindow_call },
+  { "WindowShouldClose", 0, WindowShouldClose_call },
+  { "IsWindowReady", 0, IsWindowReady_call },
+  { "IsWindowFullscreen", 0, IsWindowFullscreen_call },
+  { "IsWindowHidden", 0, IsWindowHidden_call },
+  { "IsWindowMinimized", 0, IsWindowMinimized_call },
+  { "IsWindowMaximized", 0, IsWindowMaximized_call },
+  { "IsWindowFocused", 0, IsWindowFocused_call },
+  { "IsWindowResized", 0, IsWindowResized_call },
+  { "IsWindowState", 1, IsWindowState_call },
+  { "SetWindowState", 1, SetWindowState_call },
+  { "ClearWindowState", 1, ClearWindowState_call },
+  { "ToggleFullscreen", 0, ToggleFullscreen_call },
+  { "ToggleBorderlessWindowed", 0, ToggleBorderlessWindowed_call },
+  { "MaximizeWindow", 0, MaximizeWindow_call },
+  { "MinimizeWindow", 0, MinimizeWindow_call },
+  { "RestoreWindow", 0, RestoreWindow_call },
+  { "SetWindowIcon", 1, SetWindowIcon_call },
+  { "SetWindowIcons", 1, SetWindowIcons_call },
+  { "SetWindowTitle", 1, SetWindowTitle_call },
+  { "SetWindowPosition", 2, SetWindowPosition_call },
+  { "SetWindowMonitor", 1, SetWindowMonitor_call },
+  { "SetWindowMinSize", 2, SetWindowMinSize_call },
+  { "SetWindowMaxSize", 2, SetWindowMaxSize_call },
+  { "SetWindowSize", 2, SetWindowSize_call },
+  { "SetWindowOpacity", 1, SetWindowOpacity_call },
+  { "SetWindowFocused", 0, SetWindowFocused_call },
+  { "GetScreenWidth", 0, GetScreenWidth_call },
+  { "GetScreenHeight", 0, GetScreenHeight_call },
+  { "GetRenderWidth", 0, GetRenderWidth_call },
+  { "GetRenderHeight", 0, GetRenderHeight_call },
+  { "GetMonitorCount", 0, GetMonitorCount_call },
+  { "GetCurrentMonitor", 0, GetCurrentMonitor_call },
+  { "GetMonitorPosition", 1, GetMonitorPosition_call },
+  { "GetMonitorWidth", 1, GetMonitorWidth_call },
+  { "GetMonitorHeight", 1, GetMonitorHeight_call },
+  { "GetMonitorPhysicalWidth", 1, GetMonitorPhysicalWidth_call },
+  { "GetMonitorPhysicalHeight", 1, GetMonitorPhysicalHeight_call },
+  { "GetMonitorRefreshRate", 1, GetMonitorRefreshRate_call },
+  { "GetWindowPosition", 0, GetWindowPosition_call },
+  { "GetWindowScaleDPI", 0, GetWindowScaleDPI_call },
+  { "GetMonitorName", 1, GetMonitorName_call },
+  { "SetClipboardText", 1, SetClipboardText_call },
+  { "GetClipboardText", 0, GetClipboardText_call },
+  { "EnableEventWaiting", 0, EnableEventWaiting_call },
+  { "DisableEventWaiting", 0, DisableEventWaiting_call },
   // Cursor-related functions
-  hk_vm_push_string_from_chars(vm, -1, "ShowCursor");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ShowCursor", 0, ShowCursor_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "HideCursor");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "HideCursor", 0, HideCursor_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsCursorHidden");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsCursorHidden", 0, IsCursorHidden_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "EnableCursor");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "EnableCursor", 0, EnableCursor_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DisableCursor");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DisableCursor", 0, DisableCursor_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsCursorOnScreen");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsCursorOnScreen", 0, IsCursorOnScreen_call);
-  hk_return_if_not_ok(vm);
+  { "ShowCursor", 0, ShowCursor_call },
+  { "HideCursor", 0, HideCursor_call },
+  { "IsCursorHidden", 0, IsCursorHidden_call },
+  { "EnableCursor", 0, EnableCursor_call },
+  { "DisableCursor", 0, DisableCursor_call },
+  { "IsCursorOnScreen", 0, IsCursorOnScreen_call },
   // Drawing-related functions
-  hk_vm_push_string_from_chars(vm, -1, "ClearBackground");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "ClearBackground", 1, ClearBackground_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "BeginDrawing");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "BeginDrawing", 0, BeginDrawing_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "EndDrawing");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "EndDrawing", 0, EndDrawing_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "BeginMode2D");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "BeginMode2D", 1, BeginMode2D_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "EndMode2D");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "EndMode2D", 0, EndMode2D_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "BeginMode3D");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "BeginMode3D", 1, BeginMode3D_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "EndMode3D");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "EndMode3D", 0, EndMode3D_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "BeginTextureMode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "BeginTextureMode", 1, BeginTextureMode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "EndTextureMode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "EndTextureMode", 0, EndTextureMode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "BeginShaderMode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "BeginShaderMode", 1, BeginShaderMode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "EndShaderMode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "EndShaderMode", 0, EndShaderMode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "BeginBlendMode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "BeginBlendMode", 1, BeginBlendMode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "EndBlendMode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "EndBlendMode", 0, EndBlendMode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "BeginScissorMode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "BeginScissorMode", 4, BeginScissorMode_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "EndScissorMode");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "EndScissorMode", 0, EndScissorMode_call);
-  hk_return_if_not_ok(vm);
+  { "ClearBackground", 1, ClearBackground_call },
+  { "BeginDrawing", 0, BeginDrawing_call },
+  { "EndDrawing", 0, EndDrawing_call },
+  { "BeginMode2D", 1, BeginMode2D_call },
+  { "EndMode2D", 0, EndMode2D_call },
+  { "BeginMode3D", 1, BeginMode3D_call },
+  { "EndMode3D", 0, EndMode3D_call },
+  { "BeginTextureMode", 1, BeginTextureMode_call },
+  { "EndTextureMode", 0, EndTextureMode_call },
+  { "BeginShaderMode", 1, BeginShaderMode_call },
+  { "EndShaderMode", 0, EndShaderMode_call },
+  { "BeginBlendMode", 1, BeginBlendMode_call },
+  { "EndBlendMode", 0, EndBlendMode_call },
+  { "BeginScissorMode", 4, BeginScissorMode_call },
+  { "EndScissorMode", 0, EndScissorMode_call },
   // Shader management functions
-  hk_vm_push_string_from_chars(vm, -1, "LoadShader");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "LoadShader", 2, LoadShader_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "LoadShaderFromMemory");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "LoadShaderFromMemory", 2, LoadShaderFromMemory_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetShaderLocation");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetShaderLocation", 2, GetShaderLocation_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetShaderLocationAttrib");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetShaderLocationAttrib", 2, GetShaderLocationAttrib_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetShaderValue");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetShaderValue", 4, SetShaderValue_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetShaderValueV");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetShaderValueV", 5, SetShaderValueV_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetShaderValueMatrix");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetShaderValueMatrix", 3, SetShaderValueMatrix_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetShaderValueTexture");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetShaderValueTexture", 3, SetShaderValueTexture_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "UnloadShader");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "UnloadShader", 1, UnloadShader_call);
-  hk_return_if_not_ok(vm);
+  { "LoadShader", 2, LoadShader_call },
+  { "LoadShaderFromMemory", 2, LoadShaderFromMemory_call },
+  { "GetShaderLocation", 2, GetShaderLocation_call },
+  { "GetShaderLocationAttrib", 2, GetShaderLocationAttrib_call },
+  { "SetShaderValue", 4, SetShaderValue_call },
+  { "SetShaderValueV", 5, SetShaderValueV_call },
+  { "SetShaderValueMatrix", 3, SetShaderValueMatrix_call },
+  { "SetShaderValueTexture", 3, SetShaderValueTexture_call },
+  { "UnloadShader", 1, UnloadShader_call },
   // Timing-related functions
-  hk_vm_push_string_from_chars(vm, -1, "SetTargetFPS");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetTargetFPS", 1, SetTargetFPS_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetFrameTime");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetFrameTime", 0, GetFrameTime_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetTime");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetTime", 0, GetTime_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetFPS");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetFPS", 0, GetFPS_call);
-  hk_return_if_not_ok(vm);
+  { "SetTargetFPS", 1, SetTargetFPS_call },
+  { "GetFrameTime", 0, GetFrameTime_call },
+  { "GetTime", 0, GetTime_call },
+  { "GetFPS", 0, GetFPS_call },
   // Input-related functions: keyboard
-  hk_vm_push_string_from_chars(vm, -1, "IsKeyPressed");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsKeyPressed", 1, IsKeyPressed_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsKeyPressedRepeat");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsKeyPressedRepeat", 1, IsKeyPressedRepeat_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsKeyDown");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsKeyDown", 1, IsKeyDown_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsKeyReleased");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsKeyReleased", 1, IsKeyReleased_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "IsKeyUp");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "IsKeyUp", 1, IsKeyUp_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetKeyPressed");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetKeyPressed", 0, GetKeyPressed_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetCharPressed");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetCharPressed", 0, GetCharPressed_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "SetExitKey");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "SetExitKey", 1, SetExitKey_call);
-  hk_return_if_not_ok(vm);
+  { "IsKeyPressed", 1, IsKeyPressed_call },
+  { "IsKeyPressedRepeat", 1, IsKeyPressedRepeat_call },
+  { "IsKeyDown", 1, IsKeyDown_call },
+  { "IsKeyReleased", 1, IsKeyReleased_call },
+  { "IsKeyUp", 1, IsKeyUp_call },
+  { "GetKeyPressed", 0, GetKeyPressed_call },
+  { "GetCharPressed", 0, GetCharPressed_call },
+  { "SetExitKey", 1, SetExitKey_call },
   // Camera System Functions
-  hk_vm_push_string_from_chars(vm, -1, "UpdateCamera");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "UpdateCamera", 2, UpdateCamera_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "UpdateCameraPro");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "UpdateCameraPro", 4, UpdateCameraPro_call);
-  hk_return_if_not_ok(vm);
+  { "UpdateCamera", 2, UpdateCamera_call },
+  { "UpdateCameraPro", 4, UpdateCameraPro_call },
   // Basic shapes drawing functions
-  hk_vm_push_string_from_chars(vm, -1, "DrawPixel");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawPixel", 3, DrawPixel_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawPixelV");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawPixelV", 2, DrawPixelV_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawLine");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawLine", 4, DrawLine_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawLineV");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawLineV", 2, DrawLineV_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawLineEx");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawLineEx", 4, DrawLineEx_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawLineStrip");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawLineStrip", 2, DrawLineStrip_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawLineBezier");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawLineBezier", 4, DrawLineBezier_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCircle");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCircle", 4, DrawCircle_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCircleSector");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCircleSector", 6, DrawCircleSector_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCircleSectorLines");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCircleSectorLines", 6, DrawCircleSectorLines_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCircleGradient");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCircleGradient", 5, DrawCircleGradient_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCircleV");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCircleV", 3, DrawCircleV_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCircleLines");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCircleLines", 4, DrawCircleLines_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCircleLinesV");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCircleLinesV", 3, DrawCircleLinesV_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawEllipse");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawEllipse", 5, DrawEllipse_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawEllipseLines");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawEllipseLines", 5, DrawEllipseLines_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRing");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRing", 7, DrawRing_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRingLines");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRingLines", 7, DrawRingLines_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangle");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangle", 5, DrawRectangle_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangleV");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangleV", 3, DrawRectangleV_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangleRec");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangleRec", 2, DrawRectangleRec_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectanglePro");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectanglePro", 4, DrawRectanglePro_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangleGradientV");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangleGradientV", 6, DrawRectangleGradientV_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangleGradientH");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangleGradientH", 6, DrawRectangleGradientH_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangleGradientEx");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangleGradientEx", 5, DrawRectangleGradientEx_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangleLines");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangleLines", 4, DrawRectangleLines_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangleLinesEx");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangleLinesEx", 3, DrawRectangleLinesEx_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangleRounded");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangleRounded", 4, DrawRectangleRounded_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangleRoundedLines");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangleRoundedLines", 4, DrawRectangleRoundedLines_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRectangleRoundedLinesEx");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRectangleRoundedLinesEx", 5, DrawRectangleRoundedLinesEx_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawTriangle");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawTriangle", 4, DrawTriangle_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawTriangleLines");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawTriangleLines", 4, DrawTriangleLines_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawTriangleFan");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawTriangleFan", 2, DrawTriangleFan_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawTriangleStrip");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawTriangleStrip", 2, DrawTriangleStrip_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawPoly");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawPoly", 5, DrawPoly_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawPolyLines");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawPolyLines", 5, DrawPolyLines_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawPolyLinesEx");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawPolyLinesEx", 6, DrawPolyLinesEx_call);
-  hk_return_if_not_ok(vm);
+  { "DrawPixel", 3, DrawPixel_call },
+  { "DrawPixelV", 2, DrawPixelV_call },
+  { "DrawLine", 4, DrawLine_call },
+  { "DrawLineV", 2, DrawLineV_call },
+  { "DrawLineEx", 4, DrawLineEx_call },
+  { "DrawLineStrip", 2, DrawLineStrip_call },
+  { "DrawLineBezier", 4, DrawLineBezier_call },
+  { "DrawCircle", 4, DrawCircle_call },
+  { "DrawCircleSector", 6, DrawCircleSector_call },
+  { "DrawCircleSectorLines", 6, DrawCircleSectorLines_call },
+  { "DrawCircleGradient", 5, DrawCircleGradient_call },
+  { "DrawCircleV", 3, DrawCircleV_call },
+  { "DrawCircleLines", 4, DrawCircleLines_call },
+  { "DrawCircleLinesV", 3, DrawCircleLinesV_call },
+  { "DrawEllipse", 5, DrawEllipse_call },
+  { "DrawEllipseLines", 5, DrawEllipseLines_call },
+  { "DrawRing", 7, DrawRing_call },
+  { "DrawRingLines", 7, DrawRingLines_call },
+  { "DrawRectangle", 5, DrawRectangle_call },
+  { "DrawRectangleV", 3, DrawRectangleV_call },
+  { "DrawRectangleRec", 2, DrawRectangleRec_call },
+  { "DrawRectanglePro", 4, DrawRectanglePro_call },
+  { "DrawRectangleGradientV", 6, DrawRectangleGradientV_call },
+  { "DrawRectangleGradientH", 6, DrawRectangleGradientH_call },
+  { "DrawRectangleGradientEx", 5, DrawRectangleGradientEx_call },
+  { "DrawRectangleLines", 4, DrawRectangleLines_call },
+  { "DrawRectangleLinesEx", 3, DrawRectangleLinesEx_call },
+  { "DrawRectangleRounded", 4, DrawRectangleRounded_call },
+  { "DrawRectangleRoundedLines", 4, DrawRectangleRoundedLines_call },
+  { "DrawRectangleRoundedLinesEx", 5, DrawRectangleRoundedLinesEx_call },
+  { "DrawTriangle", 4, DrawTriangle_call },
+  { "DrawTriangleLines", 4, DrawTriangleLines_call },
+  { "DrawTriangleFan", 2, DrawTriangleFan_call },
+  { "DrawTriangleStrip", 2, DrawTriangleStrip_call },
+  { "DrawPoly", 5, DrawPoly_call },
+  { "DrawPolyLines", 5, DrawPolyLines_call },
+  { "DrawPolyLinesEx", 6, DrawPolyLinesEx_call },
   // Basic shapes collision detection functions
-  hk_vm_push_string_from_chars(vm, -1, "CheckCollisionRecs");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CheckCollisionRecs", 2, CheckCollisionRecs_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "CheckCollisionCircles");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CheckCollisionCircles", 4, CheckCollisionCircles_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "CheckCollisionCircleRec");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CheckCollisionCircleRec", 3, CheckCollisionCircleRec_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "CheckCollisionCircleLine");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CheckCollisionCircleLine", 4, CheckCollisionCircleLine_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "CheckCollisionPointRec");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CheckCollisionPointRec", 2, CheckCollisionPointRec_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "CheckCollisionPointCircle");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CheckCollisionPointCircle", 3, CheckCollisionPointCircle_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "CheckCollisionPointTriangle");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CheckCollisionPointTriangle", 4, CheckCollisionPointTriangle_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "CheckCollisionPointLine");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CheckCollisionPointLine", 4, CheckCollisionPointLine_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "CheckCollisionPointPoly");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CheckCollisionPointPoly", 2, CheckCollisionPointPoly_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "CheckCollisionLines");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "CheckCollisionLines", 5, CheckCollisionLines_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "GetCollisionRec");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "GetCollisionRec", 2, GetCollisionRec_call);
-  hk_return_if_not_ok(vm);
+  { "CheckCollisionRecs", 2, CheckCollisionRecs_call },
+  { "CheckCollisionCircles", 4, CheckCollisionCircles_call },
+  { "CheckCollisionCircleRec", 3, CheckCollisionCircleRec_call },
+  { "CheckCollisionCircleLine", 4, CheckCollisionCircleLine_call },
+  { "CheckCollisionPointRec", 2, CheckCollisionPointRec_call },
+  { "CheckCollisionPointCircle", 3, CheckCollisionPointCircle_call },
+  { "CheckCollisionPointTriangle", 4, CheckCollisionPointTriangle_call },
+  { "CheckCollisionPointLine", 4, CheckCollisionPointLine_call },
+  { "CheckCollisionPointPoly", 2, CheckCollisionPointPoly_call },
+  { "CheckCollisionLines", 5, CheckCollisionLines_call },
+  { "GetCollisionRec", 2, GetCollisionRec_call },
   // Texture loading functions
-  hk_vm_push_string_from_chars(vm, -1, "LoadTexture");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "LoadTexture", 1, LoadTexture_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "LoadTextureFromImage");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "LoadTextureFromImage", 1, LoadTextureFromImage_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "LoadTextureCubemap");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "LoadTextureCubemap", 2, LoadTextureCubemap_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "LoadRenderTexture");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "LoadRenderTexture", 2, LoadRenderTexture_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "UnloadTexture");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "UnloadTexture", 1, UnloadTexture_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "UnloadRenderTexture");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "UnloadRenderTexture", 1, UnloadRenderTexture_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "UpdateTexture");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "UpdateTexture", 2, UpdateTexture_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "UpdateTextureRec");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "UpdateTextureRec", 3, UpdateTextureRec_call);
-  hk_return_if_not_ok(vm);
+  { "LoadTexture", 1, LoadTexture_call },
+  { "LoadTextureFromImage", 1, LoadTextureFromImage_call },
+  { "LoadTextureCubemap", 2, LoadTextureCubemap_call },
+  { "LoadRenderTexture", 2, LoadRenderTexture_call },
+  { "UnloadTexture", 1, UnloadTexture_call },
+  { "UnloadRenderTexture", 1, UnloadRenderTexture_call },
+  { "UpdateTexture", 2, UpdateTexture_call },
+  { "UpdateTextureRec", 3, UpdateTextureRec_call },
   // Text drawing functions
-  hk_vm_push_string_from_chars(vm, -1, "DrawFPS");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawFPS", 2, DrawFPS_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawText");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawText", 5, DrawText_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawTextEx");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawTextEx", 6, DrawTextEx_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawTextPro");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawTextPro", 8, DrawTextPro_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawTextCodepoint");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawTextCodepoint", 5, DrawTextCodepoint_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawTextCodepoints");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawTextCodepoints", 6, DrawTextCodepoints_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawLine3D");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawLine3D", 3, DrawLine3D_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawPoint3D");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawPoint3D", 2, DrawPoint3D_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCircle3D");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCircle3D", 5, DrawCircle3D_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawTriangle3D");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawTriangle3D", 4, DrawTriangle3D_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawTriangleStrip3D");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawTriangleStrip3D", 2, DrawTriangleStrip3D_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCube");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCube", 5, DrawCube_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCubeV");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCubeV", 3, DrawCubeV_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCubeWires");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCubeWires", 5, DrawCubeWires_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCubeWiresV");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCubeWiresV", 3, DrawCubeWiresV_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawSphere");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawSphere", 3, DrawSphere_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawSphereEx");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawSphereEx", 5, DrawSphereEx_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawSphereWires");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawSphereWires", 5, DrawSphereWires_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCylinder");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCylinder", 6, DrawCylinder_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCylinderEx");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCylinderEx", 6, DrawCylinderEx_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCylinderWires");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCylinderWires", 6, DrawCylinderWires_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCylinderWiresEx");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCylinderWiresEx", 6, DrawCylinderWiresEx_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCapsule");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCapsule", 6, DrawCapsule_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawCapsuleWires");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawCapsuleWires", 6, DrawCapsuleWires_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawPlane");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawPlane", 3, DrawPlane_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawRay");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawRay", 2, DrawRay_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "DrawGrid");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "DrawGrid", 2, DrawGrid_call);
+  { "DrawFPS", 2, DrawFPS_call },
+  { "DrawText", 5, DrawText_call },
+  { "DrawTextEx", 6, DrawTextEx_call },
+  { "DrawTextPro", 8, DrawTextPro_call },
+  { "DrawTextCodepoint", 5, DrawTextCodepoint_call },
+  { "DrawTextCodepoints", 6, DrawTextCodepoints_call },
+  { "DrawLine3D", 3, DrawLine3D_call },
+  { "DrawPoint3D", 2, DrawPoint3D_call },
+  { "DrawCircle3D", 5, DrawCircle3D_call },
+  { "DrawTriangle3D", 4, DrawTriangle3D_call },
+  { "DrawTriangleStrip3D", 2, DrawTriangleStrip3D_call },
+  { "DrawCube", 5, DrawCube_call },
+  { "DrawCubeV", 3, DrawCubeV_call },
+  { "DrawCubeWires", 5, DrawCubeWires_call },
+  { "DrawCubeWiresV", 3, DrawCubeWiresV_call },
+  { "DrawSphere", 3, DrawSphere_call },
+  { "DrawSphereEx", 5, DrawSphereEx_call },
+  { "DrawSphereWires", 5, DrawSphereWires_call },
+  { "DrawCylinder", 6, DrawCylinder_call },
+  { "DrawCylinderEx", 6, DrawCylinderEx_call },
+  { "DrawCylinderWires", 6, DrawCylinderWires_call },
+  { "DrawCylinderWiresEx", 6, DrawCylinderWiresEx_call },
+  { "DrawCapsule", 6, DrawCapsule_call },
+  { "DrawCapsuleWires", 6, DrawCapsuleWires_call },
+  { "DrawPlane", 3, DrawPlane_call },
+  { "DrawRay", 2, DrawRay_call },
+  { "DrawGrid", 2, DrawGrid_call }
+};
+
+static inline void load_functions(HkVM *vm)
+{
+  hk_vm_push_new_natives(vm, 174, natives);
   hk_return_if_not_ok(vm);
 }
 
@@ -126,17 +126,16 @@ static void command_call(HkVM *vm, HkValue *args)
   hk_vm_push(vm, result);
 }
 
+static const HkNativeEntry natives[] = {
+  { "connect", 2, connect_call },
+  { "command", 2, command_call }
+};
+
 HK_LOAD_MODULE_HANDLER(redis)
 {
   hk_vm_push_string_from_chars(vm, -1, "redis");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "connect");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "connect", 2, connect_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "command");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "command", 2, command_call);
+  hk_vm_push_new_natives(vm, 2, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 2);
 }
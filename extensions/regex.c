@@ -73,17 +73,16 @@ static void is_match_call(HkVM *vm, HkValue *args)
   hk_vm_push_bool(vm, rc >= 0);
 }
 
+static const HkNativeEntry natives[] = {
+  { "new", 1, new_call },
+  { "is_match", 2, is_match_call }
+};
+
 HK_LOAD_MODULE_HANDLER(regex)
 {
   hk_vm_push_string_from_chars(vm, -1, "regex");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new", 1, new_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "is_match");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "is_match", 2, is_match_call);
+  hk_vm_push_new_natives(vm, 2, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 2);
 }
@@ -96,6 +96,13 @@ static void verify_signature_call(HkVM *vm, HkValue *args)
   hk_vm_push_bool(vm, valid);
 }
 
+static const HkNativeEntry natives[] = {
+  { "new_key_pair", 0, new_key_pair_call },
+  { "shared_secret", 2, shared_secret_call },
+  { "sign_hash", 2, sign_hash_call },
+  { "verify_signature", 3, verify_signature_call }
+};
+
 HK_LOAD_MODULE_HANDLER(secp256r1)
 {
   hk_vm_push_string_from_chars(vm, -1, "secp256r1");
@@ -120,21 +127,7 @@ HK_LOAD_MODULE_HANDLER(secp256r1)
   hk_return_if_not_ok(vm);
   hk_vm_push_number(vm, SIGNATURE_SIZE);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new_key_pair");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new_key_pair", 0, new_key_pair_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "shared_secret");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "shared_secret", 2, shared_secret_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "sign_hash");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "sign_hash", 2, sign_hash_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "verify_signature");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "verify_signature", 3, verify_signature_call);
+  hk_vm_push_new_natives(vm, 4, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 9);
 }
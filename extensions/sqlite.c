@@ -214,37 +214,21 @@ static void fetch_row_call(HkVM *vm, HkValue *args)
   hk_vm_push_nil(vm);
 }
 
+static const HkNativeEntry natives[] = {
+  { "open", 1, open_call },
+  { "close", 1, close_call },
+  { "execute", 2, execute_call },
+  { "prepare", 2, prepare_call },
+  { "finalize", 1, finalize_call },
+  { "bind", 3, bind_call },
+  { "fetch_row", 1, fetch_row_call }
+};
+
 HK_LOAD_MODULE_HANDLER(sqlite)
 {
   hk_vm_push_string_from_chars(vm, -1, "sqlite");
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "open");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "open", 1, open_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "close");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "close", 1, close_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "execute");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "execute", 2, execute_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "prepare");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "prepare", 2, prepare_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "finalize");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "finalize", 1, finalize_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "bind");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "bind", 3, bind_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "fetch_row");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "fetch_row", 1, fetch_row_call);
+  hk_vm_push_new_natives(vm, 7, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 7);
 }
@@ -183,6 +183,16 @@ static void recv_call(HkVM *vm, HkValue *args)
   hk_vm_push_string(vm, str);
 }
 
+static const HkNativeEntry natives[] = {
+  { "new_context", 0, new_context_call },
+  { "new_socket", 2, new_socket_call },
+  { "close", 1, close_call },
+  { "connect", 2, connect_call },
+  { "bind", 2, bind_call },
+  { "send", 3, send_call },
+  { "recv", 3, recv_call }
+};
+
 HK_LOAD_MODULE_HANDLER(zeromq)
 {
   hk_vm_push_string_from_chars(vm, -1, "zeromq");
@@ -195,33 +205,7 @@ HK_LOAD_MODULE_HANDLER(zeromq)
   hk_return_if_not_ok(vm);
   hk_vm_push_number(vm, ZMQ_REP);
   hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new_context");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new_context", 0, new_context_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "new_socket");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "new_socket", 2, new_socket_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "close");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "close", 1, close_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "connect");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "connect", 2, connect_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "bind");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "bind", 2, bind_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "send");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "send", 3, send_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_string_from_chars(vm, -1, "recv");
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, "recv", 3, recv_call);
+  hk_vm_push_new_natives(vm, 7, natives);
   hk_return_if_not_ok(vm);
   hk_vm_construct(vm, 9);
 }
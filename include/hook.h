@@ -11,11 +11,14 @@
 #ifndef HOOK_H
 #define HOOK_H
 
+#include "hook/aot.h"
+#include "hook/bundle.h"
 #include "hook/array.h"
 #include "hook/callable.h"
 #include "hook/chunk.h"
 #include "hook/compiler.h"
 #include "hook/dump.h"
+#include "hook/image.h"
 #include "hook/iterable.h"
 #include "hook/iterator.h"
 #include "hook/memory.h"
@@ -0,0 +1,25 @@
+//
+// aot.h
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef HK_AOT_H
+#define HK_AOT_H
+
+#include "vm.h"
+
+typedef void (*HkAotHelper)(void);
+
+typedef int (*HkAotEntry)(void *frame);
+
+bool hk_aot_emit(HkFunction *fn, const char *name, FILE *stream);
+HkAotHelper *hk_aot_helpers(void);
+void hk_aot_load(HkVM *vm, const uint8_t *data, int size, HkAotEntry entries[],
+  int numEntries);
+
+#endif // HK_AOT_H
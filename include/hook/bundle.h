@@ -0,0 +1,19 @@
+//
+// bundle.h
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef HK_BUNDLE_H
+#define HK_BUNDLE_H
+
+#include "vm.h"
+
+bool hk_bundle_save(HkFunction *fn, FILE *stream);
+void hk_bundle_preload(HkVM *vm, HkFunction *fn);
+
+#endif // HK_BUNDLE_H
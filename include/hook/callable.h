@@ -25,9 +25,13 @@ typedef struct HkFunction
   uint8_t           functionsLength;
   struct HkFunction **functions;
   uint8_t           numNonlocals;
+  uint32_t          hotness;
+  HkChunk           *optimized;
+  void              *native;
+  struct HkClosure  *closure;
 } HkFunction;
 
-typedef struct
+typedef struct HkClosure
 {
   HK_OBJECT_HEADER
   HkFunction *fn;
@@ -46,7 +50,16 @@ typedef struct
   HkCallFn call;
 } HkNative;
 
+typedef struct
+{
+  const char *name;
+  int        arity;
+  HkCallFn   call;
+} HkNativeEntry;
+
 HkFunction *hk_function_new(int arity, HkString *name, HkString *file);
+HkFunction *hk_function_new_with_chunk(int arity, HkString *name, HkString *file,
+  HkChunk *chunk);
 void hk_function_free(HkFunction *fn);
 void hk_function_release(HkFunction *fn);
 void hk_function_append_child(HkFunction *fn, HkFunction *child);
@@ -13,6 +13,16 @@
 
 #include "array.h"
 
+// Bump whenever the encoding of compiled functions changes, so that stale
+// bytecode is never loaded.
+#define HK_BYTECODE_VERSION 4
+
+// Every this many lines, the line table records one in full, so a lookup
+// only decodes the deltas after the nearest one.
+#define HK_LINE_INDEX_INTERVAL 16
+
+#define hk_match_slot(h, s, b) ((uint32_t) (((h) ^ (s)) * 0x9e3779b1u) >> (32 - (b)))
+
 typedef enum
 {
   HK_OP_NIL,                    HK_OP_FALSE,                  HK_OP_TRUE,
@@ -37,7 +47,17 @@ typedef enum
   HK_OP_QUOTIENT,               HK_OP_REMAINDER,              HK_OP_NEGATE,
   HK_OP_NOT,                    HK_OP_BITWISE_NOT,            HK_OP_INCREMENT,
   HK_OP_DECREMENT,              HK_OP_CALL,                   HK_OP_LOAD_MODULE,
-  HK_OP_RETURN,                 HK_OP_RETURN_NIL
+  HK_OP_RETURN,                 HK_OP_RETURN_NIL,             HK_OP_GET_ELEMENT_ARRAY_INT,
+  HK_OP_GREATER_NUM_NUM,        HK_OP_LESS_NUM_NUM,           HK_OP_NOT_GREATER_NUM_NUM,
+  HK_OP_NOT_LESS_NUM_NUM,       HK_OP_ADD_NUM_NUM,            HK_OP_SUBTRACT_NUM_NUM,
+  HK_OP_MULTIPLY_NUM_NUM,       HK_OP_GET_LOCAL_LOCAL,        HK_OP_GET_LOCAL_INT,
+  HK_OP_INCREMENT_LOCAL,        HK_OP_DECREMENT_LOCAL,        HK_OP_JUMP_IF_NOT_LESS,
+  HK_OP_JUMP_IF_NOT_GREATER,    HK_OP_JUMP_IF_LESS,           HK_OP_JUMP_IF_GREATER,
+  HK_OP_CALL_POP,               HK_OP_FOREACH_INIT,           HK_OP_FOREACH_NEXT,
+  HK_OP_FOREACH_CURRENT,        HK_OP_FOR_LOOP,               HK_OP_FOR_LOOP_INT,
+  HK_OP_MATCH_INT,              HK_OP_MATCH_STRING,           HK_OP_ADD_UNCHECKED,
+  HK_OP_SUBTRACT_UNCHECKED,     HK_OP_MULTIPLY_UNCHECKED,     HK_OP_RETURN_ARRAY,
+  HK_OP_CALL_UNPACK
 } HkOpCode;
 
 typedef struct
@@ -48,16 +68,55 @@ typedef struct
 
 typedef struct
 {
-  int     codeCapacity;
-  int     codeLength;
-  uint8_t *code;
-  int     linesCapacity;
-  int     linesLength;
-  HkLine  *lines;
-  HkArray *consts;
+  int offset;
+  int no;
+  int position;
+} HkLineIndex;
+
+typedef struct
+{
+  int         length;
+  int         lastOffset;
+  int         lastNo;
+  int         indexCapacity;
+  HkLineIndex *index;
+  int         dataCapacity;
+  int         dataLength;
+  uint8_t     *data;
+} HkLineTable;
+
+// A mapped image that borrowed chunks point into. It is unmapped along with
+// the last chunk that uses it.
+typedef struct
+{
+  int     refCount;
+  uint8_t *data;
+  size_t  size;
+} HkMapping;
+
+typedef struct
+{
+  int         codeCapacity;
+  int         codeLength;
+  uint8_t     *code;
+  HkLineTable lines;
+  HkArray     *consts;
+  HkMapping   *mapping;
 } HkChunk;
 
+void hk_line_table_init(HkLineTable *table);
+bool hk_line_table_init_borrowed(HkLineTable *table, int length, HkLineIndex *index,
+  int dataLength, uint8_t *data);
+void hk_line_table_deinit(HkLineTable *table);
+void hk_line_table_append(HkLineTable *table, int offset, int no);
+void hk_line_table_truncate(HkLineTable *table, int length);
+void hk_line_table_discard(HkLineTable *table, int offset);
+int hk_line_table_get(HkLineTable *table, int offset);
+HkLine *hk_line_table_unpack(HkLineTable *table);
+int hk_line_table_index_length(int length);
 void hk_chunk_init(HkChunk *chunk);
+void hk_chunk_init_borrowed(HkChunk *chunk, uint8_t *code, int codeLength,
+  HkLineTable *lines, HkArray *consts, HkMapping *mapping);
 void hk_chunk_deinit(HkChunk *chunk);
 void hk_chunk_emit_byte(HkChunk *chunk, uint8_t byte);
 void hk_chunk_emit_word(HkChunk *chunk, uint16_t word);
@@ -0,0 +1,28 @@
+//
+// image.h
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef HK_IMAGE_H
+#define HK_IMAGE_H
+
+#include "vm.h"
+
+#define HK_IMAGE_ALIGNMENT 8
+
+bool hk_image_save(HkFunction *fn, FILE *stream);
+bool hk_image_save_bundle(HkFunction *fn, int numModules, HkString **names,
+  HkFunction **modules, FILE *stream);
+HkFunction *hk_image_load(HkVM *vm, uint8_t *data, size_t size);
+HkFunction *hk_image_load_mapped(HkVM *vm, uint8_t *data, size_t size, size_t offset);
+uint8_t *hk_image_map(const char *filename, size_t *size);
+void hk_image_unmap(uint8_t *data, size_t size);
+HkFunction *hk_image_load_file(HkVM *vm, const char *filename);
+HkFunction *hk_image_load_stream(HkVM *vm, FILE *stream);
+
+#endif // HK_IMAGE_H
@@ -30,6 +30,8 @@ typedef enum
   HK_TYPE_USERDATA
 } HkType;
 
+#define HK_NUMBER_EPSILON 1e-9
+
 #define HK_FLAG_NONE       0x00
 #define HK_FLAG_OBJECT     0x01
 #define HK_FLAG_FALSEY     0x02
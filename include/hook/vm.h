@@ -17,12 +17,20 @@
 #include "struct.h"
 #include "userdata.h"
 
-#define HK_VM_FLAG_NONE     0x00
-#define HK_VM_FLAG_NO_TRACE 0x01
+#define HK_VM_FLAG_NONE          0x00
+#define HK_VM_FLAG_NO_TRACE      0x01
+#define HK_VM_FLAG_NO_OPTIMIZE   0x02
+#define HK_VM_FLAG_JIT           0x04
+#define HK_VM_FLAG_TRACE_IMPORTS 0x08
 
-#define HK_VM_STACK_DEFAULT_SIZE (1 << 10)
+#define HK_VM_STACK_MIN_SIZE     (1 << 8)
+#define HK_VM_STACK_DEFAULT_SIZE (1 << 20)
+#define HK_VM_MAX_DEPTH          (1 << 12)
 
-#define hk_vm_is_no_trace(s) ((s)->flags & HK_VM_FLAG_NO_TRACE)
+#define hk_vm_is_no_trace(s)      ((s)->flags & HK_VM_FLAG_NO_TRACE)
+#define hk_vm_is_no_optimize(s)   ((s)->flags & HK_VM_FLAG_NO_OPTIMIZE)
+#define hk_vm_is_jit(s)           ((s)->flags & HK_VM_FLAG_JIT)
+#define hk_vm_is_trace_imports(s) ((s)->flags & HK_VM_FLAG_TRACE_IMPORTS)
 
 #define hk_vm_is_ok(s)    ((s)->status == HK_VM_STATUS_OK)
 #define hk_vm_is_exit(s)  ((s)->status == HK_VM_STATUS_EXIT)
@@ -41,11 +49,19 @@ typedef enum
   HK_VM_STATUS_ERROR
 } HkSateStatus;
 
+// A VM owns all of its runtime state, so VMs can run on separate threads as
+// long as values never cross from one VM to another. A VM is pinned to the
+// thread that created it: some of its values live in that thread's storage
+// and dangle once the thread exits, so it must not be handed to another one.
 typedef struct HkVM
 {
   HkStack(HkValue) vstk;
+  int              stackSize;
+  int              depth;
   int              flags;
   HkSateStatus     status;
+  void             *modules;
+  uint64_t         randState;
 } HkVM;
 
 void hk_vm_init(HkVM *vm, int size);
@@ -80,6 +96,7 @@ void hk_vm_push_closure(HkVM *vm, HkClosure *cl);
 void hk_vm_push_native(HkVM *vm, HkNative *native);
 void hk_vm_push_new_native(HkVM *vm, const char *name, int arity,
   HkCallFn call);
+void hk_vm_push_new_natives(HkVM *vm, int n, const HkNativeEntry entries[]);
 void hk_vm_push_userdata(HkVM *vm, HkUserdata *udata);
 void hk_vm_array(HkVM *vm, int length);
 void hk_vm_struct(HkVM *vm, int length);
@@ -0,0 +1,106 @@
+#!/usr/bin/env bash
+
+#------------------------------------------------------------------------------
+# This script checks the bytecode cache of imported modules and running
+# bundles, and finding modules created while a script runs, using the
+# interpreter in bin/.
+#
+# Usage:
+#
+#   cache-test.sh
+#------------------------------------------------------------------------------
+
+hook="$PWD/bin/hook"
+export HOOK_HOME="${HOOK_HOME:-$PWD}"
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+cache="__hkcache__/lib.hkc"
+failed=0
+
+fail() {
+  echo "failed: $1"
+  failed=$(($failed + 1))
+}
+
+# Marks the cache file as old, so a rewrite shows up as a newer time.
+age_cache() {
+  touch -d "2000-01-01" "$cache"
+}
+
+is_rewritten() {
+  [ "$(stat -c %Y "$cache")" != "$(date -d "2000-01-01" +%s)" ]
+}
+
+run() {
+  "$hook" main.hk 2>&1
+}
+
+echo "Running cache tests.."
+
+cat > lib.hk <<'EOF'
+fn value() => 1;
+return { value: value };
+EOF
+cat > main.hk <<'EOF'
+import "./lib.hk" as lib;
+println(lib.value());
+EOF
+
+[ "$(run)" == "1" ] || fail "first run"
+[ -f "$cache" ] || fail "cache is stored"
+
+age_cache
+[ "$(run)" == "1" ] || fail "cache hit output"
+is_rewritten && fail "cache hit"
+
+age_cache
+sed -i 's/=> 1;/=> 12;/' lib.hk
+[ "$(run)" == "12" ] || fail "size change output"
+is_rewritten || fail "size change"
+
+age_cache
+touch -d "2001-01-01" lib.hk
+[ "$(run)" == "12" ] || fail "mtime change output"
+is_rewritten || fail "mtime change"
+
+# Same size and time, so only the hash tells the sources apart.
+age_cache
+touch -r lib.hk lib.ref
+sed -i 's/=> 12;/=> 34;/' lib.hk
+touch -r lib.ref lib.hk
+[ "$(run)" == "34" ] || fail "hash change output"
+is_rewritten || fail "hash change"
+
+rm -rf __hkcache__
+[ "$(HOOK_NO_CACHE=1 run)" == "34" ] || fail "disabled cache output"
+[ -e "$cache" ] && fail "disabled cache"
+
+"$hook" -b main.hk main.hkb || fail "bundle"
+rm lib.hk
+[ "$("$hook" -r main.hkb 2>&1)" == "34" ] || fail "bundle without sources"
+
+# Resolving the core modules lists the directory, and the modules are written
+# after it. The second one is imported with the directory time set back, so the
+# listing is read again instead of probing the file.
+cat > main.hk <<'EOF'
+import io;
+import os;
+fn write(name, source) {
+  let file = io.open(name, "w");
+  io.write(file, source);
+  io.flush(file);
+}
+write("a.hk", "return { value: 5 };");
+import "./a.hk" as a;
+write("b.hk", "return { value: 6 };");
+os.system("touch -d 2001-01-01 .");
+import "./b.hk" as b;
+println(a.value + b.value);
+EOF
+touch -d "2000-01-01" .
+[ "$(run)" == "11" ] || fail "modules created at runtime"
+
+echo "$failed failure(s)"
+[ $failed -eq 0 ]
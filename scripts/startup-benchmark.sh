@@ -0,0 +1,26 @@
+#!/usr/bin/env bash
+
+printf "Running startup benchmark..\n\n"
+
+hook="${HOOK:-hook}"
+runs=${1:-200}
+
+$hook --version
+echo ""
+
+start=$(date +%s%N)
+for ((i = 0; i < runs; i++)); do
+  $hook -e ""
+done
+empty_elapsed=$((($(date +%s%N) - $start) / 1000))
+
+start=$(date +%s%N)
+for ((i = 0; i < runs; i++)); do
+  $hook benchmark/startup.hk > /dev/null
+done
+imports_elapsed=$((($(date +%s%N) - $start) / 1000))
+
+printf "Empty     | Imports\n";
+echo "----------+----------";
+fmt="%-9s | %s\n\n"
+printf "$fmt" "$((empty_elapsed / runs)) us" "$((imports_elapsed / runs)) us"
@@ -0,0 +1,55 @@
+#!/usr/bin/env bash
+
+#------------------------------------------------------------------------------
+# This script runs every test in several VMs at once, one thread each, on a
+# build instrumented with ThreadSanitizer.
+#
+# Usage:
+#
+#   stress-test.sh [num_threads]
+#
+# Examples:
+#
+#   stress-test.sh
+#   stress-test.sh 16
+#------------------------------------------------------------------------------
+
+threads=${1:-8}
+flags="-fsanitize=thread"
+
+cmake -B build/tsan -DCMAKE_BUILD_TYPE=RelWithDebInfo -DCMAKE_C_FLAGS="$flags" \
+  -DCMAKE_EXE_LINKER_FLAGS="$flags" -DCMAKE_SHARED_LINKER_FLAGS="$flags" || exit 1
+cmake --build build/tsan || exit 1
+
+echo "Running tests in $threads threads.."
+
+# The dynamic loader serializes dlopen() with a lock ThreadSanitizer does not
+# see, so races inside the loader are not reported.
+export TSAN_OPTIONS="suppressions=$PWD/scripts/tsan.supp $TSAN_OPTIONS"
+
+# These fail on purpose, or need an extension that is not built here.
+expected="builtin_function_assert_test.hk builtin_function_exit_test.hk
+  builtin_function_panic_test.hk module_secp256r1_test.hk nonlocals_test.hk"
+
+# ThreadSanitizer exits with 66 when it reports a race. Apart from the error
+# tests and the ones above, every test must succeed.
+n=0
+failed=0
+for f in tests/*.hk ; do
+  name=$(basename $f)
+  report=$(HOOK_HOME="$PWD/build" build/bin/hook --threads=$threads $f 2>&1 < /dev/null > /dev/null)
+  code=$?
+  if [ $code -eq 66 ]; then
+    echo "$report"
+    echo "data race in $f"
+    failed=$(($failed + 1))
+  elif [ $code -ne 0 ] && [[ $name != error_* ]] && [[ ! " $expected " =~ [[:space:]]$name[[:space:]] ]]; then
+    echo "$report"
+    echo "failed $f"
+    failed=$(($failed + 1))
+  fi
+  n=$(($n + 1))
+done
+
+echo "$n test(s), $failed failed"
+[ $failed -eq 0 ]
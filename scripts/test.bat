@@ -4,7 +4,7 @@ echo "Running tests.."
 
 set /a n=0
 for %%f in (tests\*.hk) do (
-  bin\hook %%f
+  bin\hook %* %%f
   set /a n=n+1
 )
 
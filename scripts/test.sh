@@ -4,7 +4,7 @@ echo "Running tests.."
 
 n=0
 for f in tests/*.hk ; do
-  bin/hook $f
+  bin/hook "$@" $f
   n=$(($n + 1))
 done
 
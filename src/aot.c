@@ -0,0 +1,275 @@
+//
+// aot.c
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "hook/aot.h"
+#include <ctype.h>
+#include <string.h>
+#include "hook/memory.h"
+#include "jit.h"
+
+#define BYTES_PER_LINE 16
+
+static inline uint16_t read_word(uint8_t *code);
+static inline int count_functions(HkFunction *fn);
+static inline void mark_targets(uint8_t *code, JitInstruction *ins, bool *labels);
+static bool emit_function(HkFunction *fn, int index, FILE *stream);
+static bool emit_functions(HkFunction *fn, int *index, FILE *stream);
+static inline void emit_bytecode(HkFunction *fn, FILE *stream);
+static inline void emit_entries(int numFunctions, FILE *stream);
+static FILE *open_bytecode(const uint8_t *data, int size);
+static bool attach_entries(HkFunction *fn, HkAotEntry entries[], int numEntries, int *index);
+
+static inline uint16_t read_word(uint8_t *code)
+{
+  return *((uint16_t *) code);
+}
+
+static inline int count_functions(HkFunction *fn)
+{
+  int result = 1;
+  for (int i = 0; i < fn->functionsLength; ++i)
+    result += count_functions(fn->functions[i]);
+  return result;
+}
+
+static inline void mark_targets(uint8_t *code, JitInstruction *ins, bool *labels)
+{
+  if (ins->kind == JIT_KIND_JUMP || ins->kind == JIT_KIND_BRANCH)
+  {
+    labels[ins->target] = true;
+    return;
+  }
+  if (ins->kind != JIT_KIND_SWITCH)
+    return;
+  labels[read_word(&code[1])] = true;
+  if (code[0] == HK_OP_MATCH_INT)
+  {
+    int size = read_word(&code[5]);
+    for (int i = 0; i < size; ++i)
+      labels[read_word(&code[7 + 2 * i])] = true;
+    return;
+  }
+  int numEntries = 1 << code[5];
+  for (int i = 0; i < numEntries; ++i)
+    labels[read_word(&code[6 + 3 * i + 1])] = true;
+}
+
+static bool emit_function(HkFunction *fn, int index, FILE *stream)
+{
+  HkChunk *chunk = &fn->chunk;
+  uint8_t *code = chunk->code;
+  int length = chunk->codeLength;
+  bool *labels = (bool *) hk_allocate(sizeof(*labels) * (length + 1));
+  memset(labels, 0, sizeof(*labels) * (length + 1));
+  bool *cases = NULL;
+  bool hasBranches = false;
+  for (int offset = 0; offset < length; )
+  {
+    JitInstruction ins;
+    if (!jit_decode(&code[offset], &ins))
+    {
+      hk_free(cases);
+      hk_free(labels);
+      return false;
+    }
+    mark_targets(&code[offset], &ins, labels);
+    hasBranches = hasBranches || ins.kind == JIT_KIND_BRANCH;
+    if (ins.kind == JIT_KIND_SWITCH && !cases)
+      cases = (bool *) hk_allocate(sizeof(*cases) * (length + 1));
+    offset += ins.length;
+  }
+  char *name = fn->name ? fn->name->chars : "<anonymous>";
+  fprintf(stream, "\n// %s\nstatic int fn%d(void *frame)\n{\n", name, index);
+  if (hasBranches)
+    fprintf(stream, "  int result;\n");
+  for (int offset = 0; offset < length; )
+  {
+    JitInstruction ins;
+    (void) jit_decode(&code[offset], &ins);
+    int op = code[offset];
+    int end = offset + ins.length;
+    if (labels[offset])
+      fprintf(stream, "l%d:\n", offset);
+    switch (ins.kind)
+    {
+    case JIT_KIND_CALL:
+    case JIT_KIND_BRANCH:
+    case JIT_KIND_CALL_RETURN:
+      fprintf(stream, "  %s", ins.kind == JIT_KIND_BRANCH ? "result = " : "if (");
+      fprintf(stream, "CALL%d(%d", ins.numArgs, op);
+      for (int i = 0; i < ins.numArgs; ++i)
+        fprintf(stream, ", %d", ins.args[i]);
+      if (ins.kind == JIT_KIND_BRANCH)
+      {
+        fprintf(stream, ");\n  if (result == %d)\n    goto l%d;\n", JIT_JUMP, ins.target);
+        fprintf(stream, "  if (result)\n    return %d;\n", end);
+        break;
+      }
+      fprintf(stream, "))\n    return %d;\n", end);
+      if (ins.kind == JIT_KIND_CALL_RETURN)
+        fprintf(stream, "  return -1;\n");
+      break;
+    case JIT_KIND_JUMP:
+      fprintf(stream, "  goto l%d;\n", ins.target);
+      break;
+    case JIT_KIND_SWITCH:
+      fprintf(stream, "  switch (CALL1(%d, %d))\n  {\n", op, offset);
+      memset(cases, 0, sizeof(*cases) * (length + 1));
+      mark_targets(&code[offset], &ins, cases);
+      for (int i = 0; i < length; ++i)
+        if (cases[i] && i != read_word(&code[offset + 1]))
+          fprintf(stream, "  case %d:\n    goto l%d;\n", i, i);
+      fprintf(stream, "  default:\n    goto l%d;\n  }\n", read_word(&code[offset + 1]));
+      break;
+    case JIT_KIND_RETURN:
+      fprintf(stream, "  return -1;\n");
+      break;
+    }
+    offset = end;
+  }
+  fprintf(stream, "}\n");
+  hk_free(cases);
+  hk_free(labels);
+  return true;
+}
+
+static bool emit_functions(HkFunction *fn, int *index, FILE *stream)
+{
+  if (!emit_function(fn, (*index)++, stream))
+    return false;
+  for (int i = 0; i < fn->functionsLength; ++i)
+    if (!emit_functions(fn->functions[i], index, stream))
+      return false;
+  return true;
+}
+
+static inline void emit_bytecode(HkFunction *fn, FILE *stream)
+{
+  FILE *tmp = tmpfile();
+  if (tmp)
+  {
+    hk_function_serialize(fn, tmp);
+    rewind(tmp);
+  }
+  fprintf(stream, "\nstatic const uint8_t bytecode[] = {");
+  int n = 0;
+  int c;
+  while (tmp && (c = fgetc(tmp)) != EOF)
+  {
+    fprintf(stream, "%s0x%02x", n % BYTES_PER_LINE ? ", " : (n ? ",\n  " : "\n  "), c);
+    ++n;
+  }
+  fprintf(stream, "\n};\n");
+  if (tmp)
+    (void) fclose(tmp);
+}
+
+static inline void emit_entries(int numFunctions, FILE *stream)
+{
+  fprintf(stream, "\nstatic HkAotEntry entries[] = {");
+  for (int i = 0; i < numFunctions; ++i)
+    fprintf(stream, "%sfn%d", i % 8 ? ", " : (i ? ",\n  " : "\n  "), i);
+  fprintf(stream, "\n};\n");
+}
+
+static FILE *open_bytecode(const uint8_t *data, int size)
+{
+  FILE *stream = tmpfile();
+  if (!stream)
+    return NULL;
+  if (fwrite(data, 1, size, stream) != (size_t) size)
+  {
+    (void) fclose(stream);
+    return NULL;
+  }
+  rewind(stream);
+  return stream;
+}
+
+static bool attach_entries(HkFunction *fn, HkAotEntry entries[], int numEntries, int *index)
+{
+  if (*index == numEntries)
+    return false;
+  JitCode *code = (JitCode *) hk_allocate(sizeof(*code));
+  code->entry = entries[(*index)++];
+  code->chunk = &fn->chunk;
+  code->base = NULL;
+  code->size = 0;
+  code->targets = NULL;
+  fn->native = code;
+  for (int i = 0; i < fn->functionsLength; ++i)
+    if (!attach_entries(fn->functions[i], entries, numEntries, index))
+      return false;
+  return true;
+}
+
+bool hk_aot_emit(HkFunction *fn, const char *name, FILE *stream)
+{
+  int numFunctions = count_functions(fn);
+  fprintf(stream, "//\n// Generated by `hook --emit-c`. Build it as a native module, e.g.:\n");
+  fprintf(stream, "//   cc -shared -fPIC -O2 -I$HOOK_HOME/include %s.c $HOOK_HOME/lib/libhook.a"
+    " -lm -o %s_mod.so\n//\n\n", name, name);
+  fprintf(stream, "#include <hook.h>\n\n");
+  fprintf(stream, "#define CALL0(o)          ((int (*)(void *)) helpers[o])(frame)\n");
+  fprintf(stream, "#define CALL1(o, a)       ((int (*)(void *, int)) helpers[o])(frame, a)\n");
+  fprintf(stream, "#define CALL2(o, a, b)    ((int (*)(void *, int, int)) helpers[o])"
+    "(frame, a, b)\n");
+  fprintf(stream, "#define CALL3(o, a, b, c) ((int (*)(void *, int, int, int)) helpers[o])"
+    "(frame, a, b, c)\n\n");
+  fprintf(stream, "static HkAotHelper *helpers;\n");
+  emit_bytecode(fn, stream);
+  int index = 0;
+  if (!emit_functions(fn, &index, stream))
+    return false;
+  emit_entries(numFunctions, stream);
+  fprintf(stream, "\nHK_LOAD_MODULE_HANDLER(");
+  for (const char *chars = name; *chars; ++chars)
+    fputc(isalnum((unsigned char) *chars) ? *chars : '_', stream);
+  fprintf(stream, ")\n{\n  helpers = hk_aot_helpers();\n");
+  fprintf(stream, "  hk_aot_load(vm, bytecode, (int) sizeof(bytecode), entries, %d);\n}\n",
+    numFunctions);
+  return true;
+}
+
+HkAotHelper *hk_aot_helpers(void)
+{
+  return jit_helpers();
+}
+
+void hk_aot_load(HkVM *vm, const uint8_t *data, int size, HkAotEntry entries[],
+  int numEntries)
+{
+  FILE *stream = open_bytecode(data, size);
+  if (!stream)
+  {
+    hk_vm_runtime_error(vm, "cannot read embedded bytecode");
+    return;
+  }
+  HkFunction *fn = hk_function_deserialize(stream);
+  (void) fclose(stream);
+  if (!fn)
+  {
+    hk_vm_runtime_error(vm, "invalid embedded bytecode");
+    return;
+  }
+  int index = 0;
+  if (!attach_entries(fn, entries, numEntries, &index) || index != numEntries)
+  {
+    hk_function_free(fn);
+    hk_vm_runtime_error(vm, "embedded bytecode does not match the compiled functions");
+    return;
+  }
+  HkClosure *cl = hk_closure_new(fn);
+  hk_vm_push_closure(vm, cl);
+  hk_return_if_not_ok(vm);
+  hk_vm_push_array(vm, hk_array_new());
+  hk_return_if_not_ok(vm);
+  hk_vm_call(vm, 1);
+}
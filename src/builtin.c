@@ -30,51 +30,6 @@
   #define strtok_r strtok_s
 #endif
 
-static const char *globals[] = {
-  "print",
-  "println",
-  "type",
-  "is_nil",
-  "is_bool",
-  "is_number",
-  "is_int",
-  "is_string",
-  "is_range",
-  "is_array",
-  "is_struct",
-  "is_instance",
-  "is_iterator",
-  "is_callable",
-  "is_userdata",
-  "is_object",
-  "is_comparable",
-  "is_iterable",
-  "to_bool",
-  "to_int",
-  "to_number",
-  "to_string",
-  "ord",
-  "chr",
-  "hex",
-  "bin",
-  "address",
-  "refcount",
-  "cap",
-  "len",
-  "is_empty",
-  "compare",
-  "split",
-  "join",
-  "iter",
-  "valid",
-  "current",
-  "next",
-  "sleep",
-  "exit",
-  "assert",
-  "panic"
-};
-
 static inline void string_to_double(HkVM *vm, HkString *str, double *result);
 static inline HkArray *split(HkString *str, HkString *sep);
 static inline void join(HkArray *arr, HkString *sep, HkString **result);
@@ -121,6 +76,51 @@ static void exit_call(HkVM *vm, HkValue *args);
 static void assert_call(HkVM *vm, HkValue *args);
 static void panic_call(HkVM *vm, HkValue *args);
 
+static const HkNativeEntry globals[] = {
+  { "print", 1, print_call },
+  { "println", 1, println_call },
+  { "type", 1, type_call },
+  { "is_nil", 1, is_nil_call },
+  { "is_bool", 1, is_bool_call },
+  { "is_number", 1, is_number_call },
+  { "is_int", 1, is_int_call },
+  { "is_string", 1, is_string_call },
+  { "is_range", 1, is_range_call },
+  { "is_array", 1, is_array_call },
+  { "is_struct", 1, is_struct_call },
+  { "is_instance", 1, is_instance_call },
+  { "is_iterator", 1, is_iterator_call },
+  { "is_callable", 1, is_callable_call },
+  { "is_userdata", 1, is_userdata_call },
+  { "is_object", 1, is_object_call },
+  { "is_comparable", 1, is_comparable_call },
+  { "is_iterable", 1, is_iterable_call },
+  { "to_bool", 1, to_bool_call },
+  { "to_int", 1, to_int_call },
+  { "to_number", 1, to_number_call },
+  { "to_string", 1, to_string_call },
+  { "ord", 1, ord_call },
+  { "chr", 1, chr_call },
+  { "hex", 1, hex_call },
+  { "bin", 1, bin_call },
+  { "address", 1, address_call },
+  { "refcount", 1, refcount_call },
+  { "cap", 1, cap_call },
+  { "len", 1, len_call },
+  { "is_empty", 1, is_empty_call },
+  { "compare", 2, compare_call },
+  { "split", 2, split_call },
+  { "join", 2, join_call },
+  { "iter", 1, iter_call },
+  { "valid", 1, valid_call },
+  { "current", 1, current_call },
+  { "next", 1, next_call },
+  { "sleep", 1, sleep_call },
+  { "exit", 1, exit_call },
+  { "assert", 2, assert_call },
+  { "panic", 1, panic_call }
+};
+
 static inline void string_to_double(HkVM *vm, HkString *str, double *result)
 {
   if (!str->length)
@@ -318,16 +318,14 @@ static void to_string_call(HkVM *vm, HkValue *args)
   }
   if (hk_is_number(val))
   {
-    char chars[32];
-    snprintf(chars, sizeof(chars) - 1,  "%g", hk_as_number(val));
-    str = hk_string_from_chars(-1, chars);
+    str = hk_string_from_number(hk_as_number(val));
     goto end;
   }
   hk_vm_push(vm, val);
   return;
 end:
   hk_vm_push_string(vm, str);
-  if (!hk_vm_is_ok(vm))
+  if (!hk_vm_is_ok(vm) && !str->refCount)
     hk_string_free(str);
 }
 
@@ -355,13 +353,7 @@ static void chr_call(HkVM *vm, HkValue *args)
     hk_vm_runtime_error(vm, "range error: argument #1 must be between 0 and %d", UCHAR_MAX);
     return;
   }
-  HkString *str = hk_string_new_with_capacity(1);
-  str->length = 1;
-  str->chars[0] = (char) data;
-  str->chars[1] = '\0';
-  hk_vm_push_string(vm, str);
-  if (!hk_vm_is_ok(vm))
-    hk_string_free(str);
+  hk_vm_push_string(vm, hk_string_from_char((char) data));
 }
 
 static void hex_call(HkVM *vm, HkValue *args)
@@ -670,89 +662,25 @@ static void panic_call(HkVM *vm, HkValue *args)
 
 void load_globals(HkVM *vm)
 {
-  hk_vm_push_new_native(vm, globals[0], 1, print_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[1], 1, println_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[2], 1, type_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[3], 1, is_nil_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[4], 1, is_bool_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[5], 1, is_number_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[6], 1, is_int_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[7], 1, is_string_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[8], 1, is_range_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[9], 1, is_array_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[10], 1, is_struct_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[11], 1, is_instance_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[12], 1, is_iterator_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[13], 1, is_callable_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[14], 1, is_userdata_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[15], 1, is_object_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[16], 1, is_comparable_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[17], 1, is_iterable_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[18], 1, to_bool_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[19], 1, to_int_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[20], 1, to_number_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[21], 1, to_string_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[22], 1, ord_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[23], 1, chr_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[24], 1, hex_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[25], 1, bin_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[26], 1, address_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[27], 1, refcount_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[28], 1, cap_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[29], 1, len_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[30], 1, is_empty_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[31], 2, compare_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[32], 2, split_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[33], 2, join_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[34], 1, iter_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[35], 1, valid_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[36], 1, current_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[37], 1, next_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[38], 1, sleep_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[39], 1, exit_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[40], 2, assert_call);
-  hk_return_if_not_ok(vm);
-  hk_vm_push_new_native(vm, globals[41], 1, panic_call);
+  // Only the slots are reserved here. Each native is created the first time
+  // the global is used.
+  int n = num_globals();
+  for (int i = 0; i < n; ++i)
+  {
+    hk_vm_push_nil(vm);
+    hk_return_if_not_ok(vm);
+  }
+}
+
+HkValue load_global(HkVM *vm, int index)
+{
+  const HkNativeEntry *entry = &globals[index];
+  HkString *name = hk_string_from_chars(-1, entry->name);
+  HkNative *native = hk_native_new(name, entry->arity, entry->call);
+  hk_incr_ref(native);
+  HkValue val = hk_native_value(native);
+  vm->vstk.base[index] = val;
+  return val;
 }
 
 int num_globals(void)
@@ -765,7 +693,7 @@ int lookup_global(int length, char *chars)
   int index = num_globals() - 1;
   for (; index > -1; --index)
   {
-    const char *global = globals[index];
+    const char *global = globals[index].name;
     if (!strncmp(global, chars, length) && !global[length])
       break;
   }
@@ -14,6 +14,7 @@
 #include "hook/vm.h"
 
 void load_globals(HkVM *vm);
+HkValue load_global(HkVM *vm, int index);
 int num_globals(void);
 int lookup_global(int length, char *chars);
 
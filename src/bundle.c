@@ -0,0 +1,152 @@
+//
+// bundle.c
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "hook/bundle.h"
+#include "hook/image.h"
+#include "hook/memory.h"
+#include "jit.h"
+#include "module.h"
+
+#define MIN_CAPACITY (1 << 3)
+
+typedef struct
+{
+  int         capacity;
+  int         length;
+  HkString    **names;
+  HkFunction  **modules;
+  ModuleState *state;
+  bool        openNatives;
+} Bundle;
+
+static inline void bundle_init(Bundle *bundle, ModuleState *state, bool openNatives);
+static inline void bundle_deinit(Bundle *bundle);
+static inline bool bundle_contains(Bundle *bundle, HkString *name);
+static inline void bundle_append(Bundle *bundle, HkString *name, HkFunction *fn);
+static void add_module(Bundle *bundle, HkString *name, HkString *currFile);
+static void add_imports(Bundle *bundle, HkFunction *fn);
+
+static inline void bundle_init(Bundle *bundle, ModuleState *state, bool openNatives)
+{
+  bundle->capacity = 0;
+  bundle->length = 0;
+  bundle->names = NULL;
+  bundle->modules = NULL;
+  bundle->state = state;
+  bundle->openNatives = openNatives;
+}
+
+static inline void bundle_deinit(Bundle *bundle)
+{
+  for (int i = 0; i < bundle->length; ++i)
+  {
+    hk_string_release(bundle->names[i]);
+    hk_function_release(bundle->modules[i]);
+  }
+  hk_free(bundle->names);
+  hk_free(bundle->modules);
+}
+
+static inline bool bundle_contains(Bundle *bundle, HkString *name)
+{
+  for (int i = 0; i < bundle->length; ++i)
+    if (hk_string_equal(bundle->names[i], name))
+      return true;
+  return false;
+}
+
+static inline void bundle_append(Bundle *bundle, HkString *name, HkFunction *fn)
+{
+  if (bundle->length == bundle->capacity)
+  {
+    int capacity = bundle->capacity ? bundle->capacity << 1 : MIN_CAPACITY;
+    bundle->capacity = capacity;
+    bundle->names = (HkString **) hk_reallocate(bundle->names,
+      sizeof(*bundle->names) * capacity);
+    bundle->modules = (HkFunction **) hk_reallocate(bundle->modules,
+      sizeof(*bundle->modules) * capacity);
+  }
+  hk_incr_ref(name);
+  hk_incr_ref(fn);
+  bundle->names[bundle->length] = name;
+  bundle->modules[bundle->length] = fn;
+  ++bundle->length;
+}
+
+static void add_module(Bundle *bundle, HkString *name, HkString *currFile)
+{
+  if (bundle_contains(bundle, name))
+    return;
+  // Native modules, and modules that cannot be found now, are still looked up
+  // when the bundle runs.
+  HkFunction *fn = module_compile(bundle->state, name, currFile);
+  if (!fn)
+  {
+    if (bundle->openNatives)
+      module_open_native(bundle->state, name, currFile);
+    return;
+  }
+  bundle_append(bundle, name, fn);
+  add_imports(bundle, fn);
+}
+
+static void add_imports(Bundle *bundle, HkFunction *fn)
+{
+  // The compiler always emits the module name as a constant right before
+  // loading the module.
+  HkChunk *chunk = &fn->chunk;
+  uint8_t *code = chunk->code;
+  HkValue *consts = chunk->consts->elements;
+  int prev = -1;
+  int offset = 0;
+  while (offset < chunk->codeLength)
+  {
+    JitInstruction ins;
+    if (!jit_decode(&code[offset], &ins))
+      break;
+    if (code[offset] == HK_OP_LOAD_MODULE && prev != -1 && code[prev] == HK_OP_CONSTANT)
+    {
+      HkValue val = consts[code[prev + 1]];
+      if (hk_is_string(val))
+        add_module(bundle, hk_as_string(val), fn->file);
+    }
+    prev = offset;
+    offset += ins.length;
+  }
+  for (int i = 0; i < fn->functionsLength; ++i)
+    add_imports(bundle, fn->functions[i]);
+}
+
+bool hk_bundle_save(HkFunction *fn, FILE *stream)
+{
+  ModuleState *state = module_state_new();
+  Bundle bundle;
+  bundle_init(&bundle, state, false);
+  add_imports(&bundle, fn);
+  bool result = hk_image_save_bundle(fn, bundle.length, bundle.names, bundle.modules,
+    stream);
+  bundle_deinit(&bundle);
+  module_state_free(state);
+  return result;
+}
+
+void hk_bundle_preload(HkVM *vm, HkFunction *fn)
+{
+  // Registered the same way as the modules of a loaded bundle, so that
+  // imports no longer touch the file system, and processes forked afterwards
+  // share the compiled modules and the opened libraries.
+  ModuleState *state = (ModuleState *) vm->modules;
+  Bundle bundle;
+  bundle_init(&bundle, state, true);
+  add_imports(&bundle, fn);
+  for (int i = 0; i < bundle.length; ++i)
+    module_bundle_put(state, bundle.names[i], bundle.modules[i]);
+  bundle_deinit(&bundle);
+}
@@ -0,0 +1,156 @@
+//
+// cache.c
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "hook/image.h"
+#include "hook/utils.h"
+
+#ifdef _WIN32
+  #include <process.h>
+  #include <Windows.h>
+#endif
+
+#ifndef _WIN32
+  #include <limits.h>
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+
+#ifdef _WIN32
+  #define PATH_MAX MAX_PATH
+  #define getpid   _getpid
+#endif
+
+#ifdef _WIN32
+  #define thread_id() ((unsigned long) GetCurrentThreadId())
+#else
+  #define thread_id() ((unsigned long) (uintptr_t) pthread_self())
+#endif
+
+#ifdef _WIN32
+  #define DIR_SEP "\\"
+#else
+  #define DIR_SEP "/"
+#endif
+
+#define NO_CACHE_ENV_VAR "HOOK_NO_CACHE"
+
+#define CACHE_DIR   "__hkcache__"
+#define CACHE_EXT   "c"
+#define CACHE_MAGIC "HKBC"
+
+typedef struct
+{
+  char     magic[4];
+  uint32_t version;
+  int64_t  size;
+  int64_t  mtime;
+  uint32_t hash;
+  uint32_t pathLength;
+} CacheHeader;
+
+static inline bool is_enabled(void);
+static inline bool cache_file(HkString *file, char *path);
+static inline bool make_header(HkString *file, HkString *source, CacheHeader *header);
+static inline size_t image_offset(HkString *file);
+
+static inline bool is_enabled(void)
+{
+  const char *value = getenv(NO_CACHE_ENV_VAR);
+  return !value || !value[0] || !strcmp(value, "0");
+}
+
+static inline bool cache_file(HkString *file, char *path)
+{
+  char *chars = file->chars;
+  char *sep = strrchr(chars, DIR_SEP[0]);
+  int length = sep ? (int) (sep - chars) + 1 : 0;
+  int n = snprintf(path, PATH_MAX + 1, "%.*s%s%s%s%s", length, chars, CACHE_DIR, DIR_SEP,
+    &chars[length], CACHE_EXT);
+  return n > 0 && n <= PATH_MAX;
+}
+
+static inline bool make_header(HkString *file, HkString *source, CacheHeader *header)
+{
+  struct stat st;
+  if (stat(file->chars, &st))
+    return false;
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+  header->version = HK_BYTECODE_VERSION;
+  header->size = (int64_t) st.st_size;
+  header->mtime = (int64_t) st.st_mtime;
+  header->hash = hk_string_hash(source);
+  header->pathLength = (uint32_t) file->length;
+  return true;
+}
+
+static inline size_t image_offset(HkString *file)
+{
+  size_t offset = sizeof(CacheHeader) + (size_t) file->length;
+  return (offset + HK_IMAGE_ALIGNMENT - 1) & ~((size_t) HK_IMAGE_ALIGNMENT - 1);
+}
+
+HkFunction *cache_load(HkString *file, HkString *source)
+{
+  char path[PATH_MAX + 1];
+  CacheHeader header;
+  if (!is_enabled() || !cache_file(file, path) || !make_header(file, source, &header))
+    return NULL;
+  size_t size;
+  uint8_t *data = hk_image_map(path, &size);
+  if (!data)
+    return NULL;
+  // The path is part of the key since it is recorded in the functions.
+  size_t offset = image_offset(file);
+  HkFunction *fn = NULL;
+  if (size >= offset && !memcmp(data, &header, sizeof(header))
+    && !memcmp(&data[sizeof(header)], file->chars, file->length))
+    fn = hk_image_load_mapped(NULL, data, size, offset);
+  if (!fn)
+    hk_image_unmap(data, size);
+  return fn;
+}
+
+void cache_store(HkString *file, HkString *source, HkFunction *fn)
+{
+  char path[PATH_MAX + 1];
+  CacheHeader header;
+  if (!is_enabled() || !cache_file(file, path) || !make_header(file, source, &header))
+    return;
+  hk_ensure_path(path);
+  // Written under a temporary name and renamed, so that concurrent imports
+  // never read a partial file. VMs on other threads may be storing the same
+  // module, hence the thread in the name.
+  char tmpPath[PATH_MAX + 1];
+  int n = snprintf(tmpPath, sizeof(tmpPath), "%s.%d.%lx.tmp", path, (int) getpid(),
+    thread_id());
+  if (n < 0 || n > PATH_MAX)
+    return;
+  FILE *stream = fopen(tmpPath, "wb");
+  if (!stream)
+    return;
+  static const uint8_t padding[HK_IMAGE_ALIGNMENT] = { 0 };
+  size_t length = sizeof(header) + (size_t) file->length;
+  (void) fwrite(&header, sizeof(header), 1, stream);
+  (void) fwrite(file->chars, file->length, 1, stream);
+  (void) fwrite(padding, image_offset(file) - length, 1, stream);
+  bool ok = hk_image_save(fn, stream);
+  ok = !fclose(stream) && ok;
+#ifdef _WIN32
+  if (ok)
+    (void) remove(path);
+#endif
+  if (!ok || rename(tmpPath, path))
+    (void) remove(tmpPath);
+}
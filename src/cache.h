@@ -0,0 +1,19 @@
+//
+// cache.h
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "hook/callable.h"
+
+HkFunction *cache_load(HkString *file, HkString *source);
+void cache_store(HkString *file, HkString *source, HkFunction *fn);
+
+#endif // CACHE_H
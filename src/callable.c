@@ -11,6 +11,7 @@
 #include "hook/callable.h"
 #include "hook/memory.h"
 #include "hook/utils.h"
+#include "jit.h"
 
 #define MIN_CAPACITY (1 << 3)
 
@@ -29,6 +30,10 @@ static inline HkFunction *function_allocate(int arity, HkString *name, HkString
   fn->name = name;
   hk_incr_ref(file);
   fn->file = file;
+  fn->hotness = 0;
+  fn->optimized = NULL;
+  fn->native = NULL;
+  fn->closure = NULL;
   return fn;
 }
 
@@ -42,7 +47,16 @@ static inline void init_functions(HkFunction *fn)
 static inline void free_functions(HkFunction *fn)
 {
   for (int i = 0; i < fn->functionsLength; ++i)
-    hk_function_release(fn->functions[i]);
+  {
+    HkFunction *child = fn->functions[i];
+    // The shared closure references its function, so it is dropped together
+    // with the reference held by the parent.
+    HkClosure *cl = child->closure;
+    child->closure = NULL;
+    if (cl)
+      hk_closure_release(cl);
+    hk_function_release(child);
+  }
   hk_free(fn->functions);
 }
 
@@ -65,13 +79,33 @@ HkFunction *hk_function_new(int arity, HkString *name, HkString *file)
   return fn;
 }
 
+HkFunction *hk_function_new_with_chunk(int arity, HkString *name, HkString *file,
+  HkChunk *chunk)
+{
+  HkFunction *fn = function_allocate(arity, name, file);
+  fn->chunk = *chunk;
+  init_functions(fn);
+  fn->numNonlocals = 0;
+  return fn;
+}
+
 void hk_function_free(HkFunction *fn)
 {
   HkString *name = fn->name;
   if (name)
     hk_string_release(name);
   hk_string_release(fn->file);
+  if (fn->native)
+    jit_free((JitCode *) fn->native);
   hk_chunk_deinit(&fn->chunk);
+  HkChunk *optimized = fn->optimized;
+  if (optimized && optimized != &fn->chunk)
+  {
+    // The optimized chunk shares the constants of the baseline one.
+    hk_free(optimized->code);
+    hk_line_table_deinit(&optimized->lines);
+    hk_free(optimized);
+  }
   free_functions(fn);
   hk_free(fn);
 }
@@ -94,7 +128,11 @@ void hk_function_append_child(HkFunction *fn, HkFunction *child)
 void hk_function_serialize(HkFunction *fn, FILE *stream)
 {
   fwrite(&fn->arity, sizeof(fn->arity), 1, stream);
-  hk_string_serialize(fn->name, stream);
+  // Anonymous functions are stored with an empty name.
+  HkString *name = fn->name ? fn->name : hk_string_new();
+  hk_string_serialize(name, stream);
+  if (!fn->name)
+    hk_string_free(name);
   hk_string_serialize(fn->file, stream);
   hk_chunk_serialize(&fn->chunk, stream);
   fwrite(&fn->functionsCapacity, sizeof(fn->functionsCapacity), 1, stream);
@@ -113,6 +151,11 @@ HkFunction *hk_function_deserialize(FILE *stream)
   HkString *name = hk_string_deserialize(stream);
   if (!name)
     return NULL;
+  if (!name->length)
+  {
+    hk_string_free(name);
+    name = NULL;
+  }
   HkString *file = hk_string_deserialize(stream);
   if (!file)
     return NULL;
@@ -9,14 +9,20 @@
 //
 
 #include "hook/chunk.h"
+#include "hook/image.h"
 #include "hook/memory.h"
 #include "hook/utils.h"
 
 #define MIN_CAPACITY (1 << 3)
 
 static inline void ensure_code_capacity(HkChunk *chunk, int minCapacity);
-static inline void init_lines(HkChunk *chunk);
-static inline void grow_lines(HkChunk *chunk);
+static inline void write_varint(HkLineTable *table, uint32_t value);
+static inline bool read_varint(uint8_t *data, int end, int *position, uint32_t *value);
+static inline bool check_lines(HkLineTable *table);
+static inline int count_lines(HkLineTable *table, int offset, bool inclusive, HkLine *last,
+  int *position);
+static inline void seek_line(HkLineTable *table, int i, HkLine *line, int *position);
+static inline void cut_lines(HkLineTable *table, int length, HkLine *last, int position);
 
 static inline void ensure_code_capacity(HkChunk *chunk, int minCapacity)
 {
@@ -27,21 +33,269 @@ static inline void ensure_code_capacity(HkChunk *chunk, int minCapacity)
   chunk->code = (uint8_t *) hk_reallocate(chunk->code, capacity);
 }
 
-static inline void init_lines(HkChunk *chunk)
+static inline void write_varint(HkLineTable *table, uint32_t value)
 {
-  chunk->linesCapacity = MIN_CAPACITY;
-  chunk->linesLength = 0;
-  chunk->lines = (HkLine *) hk_allocate(sizeof(*chunk->lines) * chunk->linesCapacity);
+  int minCapacity = table->dataLength + 5;
+  if (minCapacity > table->dataCapacity)
+  {
+    int capacity = hk_power_of_two_ceil(minCapacity);
+    table->dataCapacity = capacity;
+    table->data = (uint8_t *) hk_reallocate(table->data, capacity);
+  }
+  while (value >= 0x80)
+  {
+    table->data[table->dataLength++] = (uint8_t) (value | 0x80);
+    value >>= 7;
+  }
+  table->data[table->dataLength++] = (uint8_t) value;
+}
+
+static inline bool read_varint(uint8_t *data, int end, int *position, uint32_t *value)
+{
+  uint32_t result = 0;
+  for (int shift = 0; shift < 32; shift += 7)
+  {
+    if (*position >= end)
+      return false;
+    uint8_t byte = data[(*position)++];
+    result |= (uint32_t) (byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline bool check_lines(HkLineTable *table)
+{
+  // Tables read from a file are decoded once up front, so that lookups can
+  // trust them.
+  if (table->length < 0 || table->dataLength < 0)
+    return false;
+  int numIndex = hk_line_table_index_length(table->length);
+  if (!numIndex && table->dataLength)
+    return false;
+  int64_t offset = 0;
+  int64_t no = 0;
+  for (int i = 0; i < numIndex; ++i)
+  {
+    HkLineIndex *entry = &table->index[i];
+    int end = i + 1 < numIndex ? table->index[i + 1].position : table->dataLength;
+    if (entry->offset < offset || entry->position != (i ? entry->position : 0)
+      || entry->position > end || end > table->dataLength)
+      return false;
+    offset = entry->offset;
+    no = entry->no;
+    int position = entry->position;
+    int count = table->length - i * HK_LINE_INDEX_INTERVAL;
+    count = count < HK_LINE_INDEX_INTERVAL ? count : HK_LINE_INDEX_INTERVAL;
+    for (int j = 1; j < count; ++j)
+    {
+      uint32_t delta = 0;
+      uint32_t zigzag = 0;
+      if (!read_varint(table->data, end, &position, &delta)
+        || !read_varint(table->data, end, &position, &zigzag))
+        return false;
+      offset += delta;
+      no += (int32_t) ((zigzag >> 1) ^ -(zigzag & 1));
+      if (offset > INT32_MAX || no < INT32_MIN || no > INT32_MAX)
+        return false;
+    }
+    if (position != end)
+      return false;
+  }
+  table->lastOffset = (int) offset;
+  table->lastNo = (int) no;
+  return true;
+}
+
+static inline int count_lines(HkLineTable *table, int offset, bool inclusive, HkLine *last,
+  int *position)
+{
+  // Offsets never decrease, so the block holding the last line before the
+  // offset is found by a binary search over the index.
+  HkLineIndex *index = table->index;
+  int low = 0;
+  int high = hk_line_table_index_length(table->length);
+  while (low < high)
+  {
+    int mid = (low + high) >> 1;
+    if (index[mid].offset < offset || (inclusive && index[mid].offset == offset))
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (!low)
+    return 0;
+  HkLineIndex *entry = &index[low - 1];
+  int i = (low - 1) * HK_LINE_INDEX_INTERVAL;
+  int end = i + HK_LINE_INDEX_INTERVAL;
+  end = end < table->length ? end : table->length;
+  last->offset = entry->offset;
+  last->no = entry->no;
+  int curr = entry->position;
+  while (i + 1 < end)
+  {
+    int next = curr;
+    uint32_t delta = 0;
+    uint32_t zigzag = 0;
+    (void) read_varint(table->data, table->dataLength, &next, &delta);
+    (void) read_varint(table->data, table->dataLength, &next, &zigzag);
+    int lineOffset = last->offset + (int) delta;
+    if (lineOffset > offset || (!inclusive && lineOffset == offset))
+      break;
+    last->offset = lineOffset;
+    last->no += (int32_t) ((zigzag >> 1) ^ -(zigzag & 1));
+    curr = next;
+    ++i;
+  }
+  if (position)
+    *position = curr;
+  return i + 1;
+}
+
+static inline void seek_line(HkLineTable *table, int i, HkLine *line, int *position)
+{
+  HkLineIndex *entry = &table->index[i / HK_LINE_INDEX_INTERVAL];
+  line->offset = entry->offset;
+  line->no = entry->no;
+  int curr = entry->position;
+  for (int j = i % HK_LINE_INDEX_INTERVAL; j > 0; --j)
+  {
+    uint32_t delta = 0;
+    uint32_t zigzag = 0;
+    (void) read_varint(table->data, table->dataLength, &curr, &delta);
+    (void) read_varint(table->data, table->dataLength, &curr, &zigzag);
+    line->offset += (int) delta;
+    line->no += (int32_t) ((zigzag >> 1) ^ -(zigzag & 1));
+  }
+  *position = curr;
+}
+
+static inline void cut_lines(HkLineTable *table, int length, HkLine *last, int position)
+{
+  table->length = length;
+  table->lastOffset = length ? last->offset : 0;
+  table->lastNo = length ? last->no : 0;
+  table->dataLength = length ? position : 0;
+}
+
+void hk_line_table_init(HkLineTable *table)
+{
+  table->length = 0;
+  table->lastOffset = 0;
+  table->lastNo = 0;
+  table->indexCapacity = MIN_CAPACITY;
+  table->index = (HkLineIndex *) hk_allocate(sizeof(*table->index) * table->indexCapacity);
+  table->dataCapacity = MIN_CAPACITY;
+  table->dataLength = 0;
+  table->data = (uint8_t *) hk_allocate(table->dataCapacity);
+}
+
+bool hk_line_table_init_borrowed(HkLineTable *table, int length, HkLineIndex *index,
+  int dataLength, uint8_t *data)
+{
+  // A zero capacity marks memory owned by someone else, such as a mapped image.
+  table->length = length;
+  table->indexCapacity = 0;
+  table->index = index;
+  table->dataCapacity = 0;
+  table->dataLength = dataLength;
+  table->data = data;
+  return check_lines(table);
 }
 
-static inline void grow_lines(HkChunk *chunk)
+void hk_line_table_deinit(HkLineTable *table)
 {
-  if (chunk->linesLength < chunk->linesCapacity)
+  if (table->indexCapacity)
+    hk_free(table->index);
+  if (table->dataCapacity)
+    hk_free(table->data);
+}
+
+void hk_line_table_append(HkLineTable *table, int offset, int no)
+{
+  if (table->length % HK_LINE_INDEX_INTERVAL)
+  {
+    int delta = no - table->lastNo;
+    write_varint(table, (uint32_t) (offset - table->lastOffset));
+    write_varint(table, ((uint32_t) delta << 1) ^ (uint32_t) -(delta < 0));
+  }
+  else
+  {
+    int numIndex = table->length / HK_LINE_INDEX_INTERVAL;
+    if (numIndex == table->indexCapacity)
+    {
+      int capacity = table->indexCapacity << 1;
+      table->indexCapacity = capacity;
+      table->index = (HkLineIndex *) hk_reallocate(table->index,
+        sizeof(*table->index) * capacity);
+    }
+    HkLineIndex *entry = &table->index[numIndex];
+    entry->offset = offset;
+    entry->no = no;
+    entry->position = table->dataLength;
+  }
+  table->lastOffset = offset;
+  table->lastNo = no;
+  ++table->length;
+}
+
+void hk_line_table_truncate(HkLineTable *table, int length)
+{
+  if (length >= table->length)
     return;
-  int capacity = chunk->linesCapacity << 1;
-  chunk->linesCapacity = capacity;
-  chunk->lines = (HkLine *) hk_reallocate(chunk->lines,
-    sizeof(*chunk->lines) * capacity);
+  HkLine last = { 0, 0 };
+  int position = 0;
+  if (length)
+    seek_line(table, length - 1, &last, &position);
+  cut_lines(table, length, &last, position);
+}
+
+void hk_line_table_discard(HkLineTable *table, int offset)
+{
+  HkLine last = { 0, 0 };
+  int position = 0;
+  int length = count_lines(table, offset, true, &last, &position);
+  cut_lines(table, length, &last, position);
+}
+
+int hk_line_table_get(HkLineTable *table, int offset)
+{
+  HkLine last;
+  return count_lines(table, offset, false, &last, NULL) ? last.no : 1;
+}
+
+HkLine *hk_line_table_unpack(HkLineTable *table)
+{
+  HkLine *lines = (HkLine *) hk_allocate(sizeof(*lines) * (table->length + 1));
+  int position = 0;
+  for (int i = 0; i < table->length; ++i)
+  {
+    HkLine *line = &lines[i];
+    if (!(i % HK_LINE_INDEX_INTERVAL))
+    {
+      HkLineIndex *entry = &table->index[i / HK_LINE_INDEX_INTERVAL];
+      line->offset = entry->offset;
+      line->no = entry->no;
+      position = entry->position;
+      continue;
+    }
+    uint32_t delta = 0;
+    uint32_t zigzag = 0;
+    (void) read_varint(table->data, table->dataLength, &position, &delta);
+    (void) read_varint(table->data, table->dataLength, &position, &zigzag);
+    line->offset = lines[i - 1].offset + (int) delta;
+    line->no = lines[i - 1].no + (int32_t) ((zigzag >> 1) ^ -(zigzag & 1));
+  }
+  return lines;
+}
+
+int hk_line_table_index_length(int length)
+{
+  return (length + HK_LINE_INDEX_INTERVAL - 1) / HK_LINE_INDEX_INTERVAL;
 }
 
 void hk_chunk_init(HkChunk *chunk)
@@ -49,15 +303,37 @@ void hk_chunk_init(HkChunk *chunk)
   chunk->codeCapacity = MIN_CAPACITY;
   chunk->codeLength = 0;
   chunk->code = (uint8_t *) hk_allocate(chunk->codeCapacity);
-  init_lines(chunk);
+  hk_line_table_init(&chunk->lines);
   chunk->consts = hk_array_new();
+  chunk->mapping = NULL;
+}
+
+void hk_chunk_init_borrowed(HkChunk *chunk, uint8_t *code, int codeLength,
+  HkLineTable *lines, HkArray *consts, HkMapping *mapping)
+{
+  // A zero capacity marks memory owned by someone else, such as a mapped image.
+  chunk->codeCapacity = 0;
+  chunk->codeLength = codeLength;
+  chunk->code = code;
+  chunk->lines = *lines;
+  chunk->consts = consts;
+  chunk->mapping = mapping;
+  if (mapping)
+    ++mapping->refCount;
 }
 
 void hk_chunk_deinit(HkChunk *chunk)
 {
-  hk_free(chunk->code);
-  hk_free(chunk->lines);
+  if (chunk->codeCapacity)
+    hk_free(chunk->code);
+  hk_line_table_deinit(&chunk->lines);
   hk_array_free(chunk->consts);
+  HkMapping *mapping = chunk->mapping;
+  if (mapping && !--mapping->refCount)
+  {
+    hk_image_unmap(mapping->data, mapping->size);
+    hk_free(mapping);
+  }
 }
 
 void hk_chunk_emit_byte(HkChunk *chunk, uint8_t byte)
@@ -81,62 +357,60 @@ void hk_chunk_emit_opcode(HkChunk *chunk, HkOpCode op)
 
 void hk_chunk_append_line(HkChunk *chunk, int no)
 {
-  grow_lines(chunk);
-  HkLine *line = &chunk->lines[chunk->linesLength];
-  line->no = no;
-  line->offset = chunk->codeLength;
-  ++chunk->linesLength;
+  hk_line_table_append(&chunk->lines, chunk->codeLength, no);
 }
 
 int hk_chunk_get_line(HkChunk *chunk, int offset)
 {
-  int result = 1;
-  HkLine *lines = chunk->lines;
-  for (int i = 0; i < chunk->linesLength; ++i)
-  {
-    HkLine *line = &lines[i];
-    if (line->offset >= offset)
-      break;
-    result = line->no;
-  }
-  return result;
+  return hk_line_table_get(&chunk->lines, offset);
 }
 
 void hk_chunk_serialize(HkChunk *chunk, FILE *stream)
 {
-  fwrite(&chunk->codeCapacity, sizeof(chunk->codeCapacity), 1, stream);
+  // Borrowed chunks have no capacity of their own.
+  int codeCapacity = chunk->codeCapacity ? chunk->codeCapacity : chunk->codeLength;
+  HkLineTable *lines = &chunk->lines;
+  int numIndex = hk_line_table_index_length(lines->length);
+  fwrite(&codeCapacity, sizeof(codeCapacity), 1, stream);
   fwrite(&chunk->codeLength, sizeof(chunk->codeLength), 1, stream);
   fwrite(chunk->code, chunk->codeLength, 1, stream);
-  fwrite(&chunk->linesCapacity, sizeof(chunk->linesCapacity), 1, stream);
-  fwrite(&chunk->linesLength, sizeof(chunk->linesLength), 1, stream);
-  for (int i = 0; i < chunk->linesLength; ++i)
-  {
-    HkLine *line = &chunk->lines[i];
-    fwrite(line, sizeof(*line), 1, stream);
-  }
+  fwrite(&lines->length, sizeof(lines->length), 1, stream);
+  fwrite(&lines->dataLength, sizeof(lines->dataLength), 1, stream);
+  if (numIndex)
+    fwrite(lines->index, sizeof(*lines->index) * numIndex, 1, stream);
+  if (lines->dataLength)
+    fwrite(lines->data, lines->dataLength, 1, stream);
   hk_array_serialize(chunk->consts, stream);
 }
 
 bool hk_chunk_deserialize(HkChunk *chunk, FILE *stream)
 {
+  chunk->mapping = NULL;
   if (fread(&chunk->codeCapacity, sizeof(chunk->codeCapacity), 1, stream) != 1)
     return false;
   if (fread(&chunk->codeLength, sizeof(chunk->codeLength), 1, stream) != 1)
     return false;
+  if (chunk->codeLength < 1 || chunk->codeLength > chunk->codeCapacity)
+    return false;
   chunk->code = (uint8_t *) hk_allocate(chunk->codeCapacity);
   if (fread(chunk->code, chunk->codeLength, 1, stream) != 1)
     return false;
-  if (fread(&chunk->linesCapacity, sizeof(chunk->linesCapacity), 1, stream) != 1)
+  HkLineTable *lines = &chunk->lines;
+  if (fread(&lines->length, sizeof(lines->length), 1, stream) != 1)
     return false;
-  if (fread(&chunk->linesLength, sizeof(chunk->linesLength), 1, stream) != 1)
+  if (fread(&lines->dataLength, sizeof(lines->dataLength), 1, stream) != 1)
+    return false;
+  if (lines->length < 0 || lines->dataLength < 0)
+    return false;
+  int numIndex = hk_line_table_index_length(lines->length);
+  lines->indexCapacity = numIndex ? numIndex : 1;
+  lines->index = (HkLineIndex *) hk_allocate(sizeof(*lines->index) * lines->indexCapacity);
+  lines->dataCapacity = lines->dataLength ? lines->dataLength : 1;
+  lines->data = (uint8_t *) hk_allocate(lines->dataCapacity);
+  if ((numIndex && fread(lines->index, sizeof(*lines->index) * numIndex, 1, stream) != 1)
+    || (lines->dataLength && fread(lines->data, lines->dataLength, 1, stream) != 1)
+    || !check_lines(lines))
     return false;
-  chunk->lines = (HkLine *) hk_allocate(sizeof(*chunk->lines) * chunk->linesCapacity);
-  for (int i = 0; i < chunk->linesLength; ++i)
-  {
-    HkLine *line = &chunk->lines[i];
-    if (fread(line, sizeof(*line), 1, stream) != 1)
-      return false;
-  }
   chunk->consts = hk_array_deserialize(stream);
   if (!chunk->consts)
     return false;
@@ -17,11 +17,23 @@
 #include "hook/struct.h"
 #include "hook/utils.h"
 #include "builtin.h"
+#include "fold.h"
 #include "lexer.h"
+#include "peephole.h"
 
 #define MAX_CONSTANTS UINT8_MAX
 #define MAX_VARIABLES UINT8_MAX
 #define MAX_BREAKS    UINT8_MAX
+#define MAX_ARMS      UINT8_MAX
+
+#define MAX_FOLDED_CONSTANTS (MAX_CONSTANTS / 2)
+
+#define MAX_INLINE_SIZE   32
+#define MAX_INLINE_PARAMS 8
+
+#define MIN_JUMP_TABLE_ARMS  4
+#define MAX_JUMP_TABLE_BITS  12
+#define MAX_JUMP_TABLE_SEEDS 256
 
 #define analyze(c) ((c)->flags & HK_COMPILER_FLAG_ANALYZE)
 
@@ -49,12 +61,15 @@ typedef enum
 
 typedef struct
 {
-  bool    isLocal;
-  int     depth;
-  uint8_t index;
-  int     length;
-  char    *start;
-  bool    isMutable;
+  bool       isLocal;
+  int        depth;
+  uint8_t    index;
+  int        length;
+  char       *start;
+  bool       isMutable;
+  int        literalLength;
+  uint8_t    literal[3];
+  HkFunction *function;
 } Variable;
 
 typedef struct Loop
@@ -66,6 +81,16 @@ typedef struct Loop
   int         offsets[MAX_BREAKS];
 } Loop;
 
+typedef struct
+{
+  bool     isConstant;
+  HkOpCode op;
+  int      numArms;
+  int      patterns[MAX_ARMS];
+  uint16_t bodies[MAX_ARMS];
+  int      offset;
+} JumpTable;
+
 typedef struct Compiler
 {
   struct Compiler *parent;
@@ -108,6 +133,20 @@ static inline bool nonlocal_exists(Compiler *comp, Token *tk);
 static inline int emit_jump(HkChunk *chunk, HkOpCode op);
 static inline void patch_jump(Compiler *comp, int offset);
 static inline void patch_opcode(HkChunk *chunk, int offset, HkOpCode op);
+static inline bool read_literal(Compiler *comp, int start, int end, HkValue *val);
+static inline void record_literal(Compiler *comp, int start);
+static inline int literal_index(Compiler *comp, HkValue val);
+static inline bool emit_literal(Compiler *comp, HkValue val);
+static inline void discard_code(Compiler *comp, int offset);
+static inline void emit_unary(Compiler *comp, int start, HkOpCode op);
+static inline void emit_binary(Compiler *comp, int start1, int start2, HkOpCode op);
+static inline int inline_length(uint8_t *code, int arity);
+static inline bool is_inlinable(HkFunction *fn);
+static inline bool is_simple_argument(uint8_t *code, int length);
+static inline int final_return(HkFunction *fn);
+static bool inline_call(Compiler *comp, HkFunction *callee, int start, int *args);
+static int compile_inline_call(Compiler *comp, HkFunction *callee, int start);
+static inline void drop_unused_nonlocals(Compiler *comp, HkFunction *child, int start);
 static inline void start_loop(Compiler *comp, Loop *loop);
 static inline void end_loop(Compiler *comp);
 static inline void compiler_init(Compiler *comp, Compiler *parent, int flags,
@@ -126,12 +165,21 @@ static void compile_anonymous_function_without_params(Compiler *comp);
 static void compile_del_statement(Compiler *comp);
 static void compile_delete(Compiler *comp, bool inplace);
 static void compile_if_statement(Compiler *comp, bool not);
+static void compile_dead_statement(Compiler *comp);
+static inline void start_jump_table(Compiler *comp, JumpTable *table);
+static inline int compile_match_pattern(Compiler *comp, JumpTable *table);
+static inline void end_jump_table(Compiler *comp, JumpTable *table, uint16_t fallback);
+static inline void patch_jump_table(Compiler *comp, JumpTable *table, int jump);
+static inline bool emit_int_jump_table(Compiler *comp, JumpTable *table, uint16_t fallback);
+static inline bool emit_string_jump_table(Compiler *comp, JumpTable *table,
+  uint16_t fallback);
 static void compile_match_statement(Compiler *comp);
-static void compile_match_statement_member(Compiler *comp);
+static void compile_match_statement_member(Compiler *comp, JumpTable *table);
 static void compile_loop_statement(Compiler *comp);
 static void compile_while_statement(Compiler *comp, bool not);
 static void compile_do_statement(Compiler *comp);
 static void compile_for_statement(Compiler *comp);
+static bool compile_counted_loop(Compiler *comp, Variable *counter);
 static void compile_foreach_statement(Compiler *comp);
 static void compile_continue_statement(Compiler *comp);
 static void compile_break_statement(Compiler *comp);
@@ -155,10 +203,11 @@ static void compile_array_constructor(Compiler *comp);
 static void compile_struct_constructor(Compiler *comp);
 static void compile_if_expression(Compiler *comp, bool not);
 static void compile_match_expression(Compiler *comp);
-static void compile_match_expression_member(Compiler *comp);
+static void compile_match_expression_member(Compiler *comp, JumpTable *table);
 static void compile_subscript(Compiler *comp);
 static Variable compile_variable(Compiler *comp, Token *tk, bool emit);
 static Variable *compile_nonlocal(Compiler *comp, Token *tk);
+static Variable *lookup_captured_literal(Compiler *comp, Token *tk, HkValue *val);
 
 static inline void syntax_error(HkString *fnName, const char *file, int line,
   int col, const char *fmt, ...)
@@ -328,6 +377,8 @@ static inline void add_variable(Compiler *comp, bool isLocal, uint8_t index, Tok
   var->length = tk->length;
   var->start = tk->start;
   var->isMutable = isMutable;
+  var->literalLength = 0;
+  var->function = NULL;
   ++comp->numVariables;
 }
 
@@ -408,6 +459,433 @@ static inline void patch_opcode(HkChunk *chunk, int offset, HkOpCode op)
   chunk->code[offset] = (uint8_t) op;
 }
 
+static inline bool read_literal(Compiler *comp, int start, int end, HkValue *val)
+{
+  HkChunk *chunk = &comp->fn->chunk;
+  uint8_t *code = chunk->code;
+  int length = end - start;
+  if (length < 1)
+    return false;
+  switch (code[start])
+  {
+  case HK_OP_NIL:
+    *val = hk_nil_value();
+    return length == 1;
+  case HK_OP_FALSE:
+    *val = hk_bool_value(false);
+    return length == 1;
+  case HK_OP_TRUE:
+    *val = hk_bool_value(true);
+    return length == 1;
+  case HK_OP_INT:
+    *val = hk_number_value(*((uint16_t *) &code[start + 1]));
+    return length == 3;
+  case HK_OP_CONSTANT:
+    *val = chunk->consts->elements[code[start + 1]];
+    return length == 2 && (hk_is_number(*val) || hk_is_string(*val));
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline void record_literal(Compiler *comp, int start)
+{
+  HkChunk *chunk = &comp->fn->chunk;
+  HkValue val;
+  if (!read_literal(comp, start, chunk->codeLength, &val))
+    return;
+  Variable *var = &comp->variables[comp->numVariables - 1];
+  var->literalLength = chunk->codeLength - start;
+  memcpy(var->literal, &chunk->code[start], var->literalLength);
+}
+
+static inline int literal_index(Compiler *comp, HkValue val)
+{
+  HkArray *consts = comp->fn->chunk.consts;
+  for (int i = 0; i < consts->length; ++i)
+    if (hk_value_equal(consts->elements[i], val))
+      return i;
+  // Folding must not exhaust the constants the rest of the function needs.
+  if (consts->length >= MAX_FOLDED_CONSTANTS)
+    return -1;
+  return add_constant(comp, val);
+}
+
+static inline bool emit_literal(Compiler *comp, HkValue val)
+{
+  HkChunk *chunk = &comp->fn->chunk;
+  if (hk_is_nil(val))
+  {
+    hk_chunk_emit_opcode(chunk, HK_OP_NIL);
+    return true;
+  }
+  if (hk_is_bool(val))
+  {
+    hk_chunk_emit_opcode(chunk, hk_as_bool(val) ? HK_OP_TRUE : HK_OP_FALSE);
+    return true;
+  }
+  if (hk_is_number(val))
+  {
+    double data = hk_as_number(val);
+    if (data >= 0 && data <= UINT16_MAX && data == (uint16_t) data)
+    {
+      hk_chunk_emit_opcode(chunk, HK_OP_INT);
+      hk_chunk_emit_word(chunk, (uint16_t) data);
+      return true;
+    }
+  }
+  int index = literal_index(comp, val);
+  if (index == -1)
+    return false;
+  hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
+  hk_chunk_emit_byte(chunk, (uint8_t) index);
+  return true;
+}
+
+static inline void discard_code(Compiler *comp, int offset)
+{
+  HkChunk *chunk = &comp->fn->chunk;
+  chunk->codeLength = offset;
+  hk_line_table_discard(&chunk->lines, offset);
+  Loop *loop = comp->loop;
+  if (!loop)
+    return;
+  int n = 0;
+  for (int i = 0; i < loop->numOffsets; ++i)
+    if (loop->offsets[i] < offset)
+      loop->offsets[n++] = loop->offsets[i];
+  loop->numOffsets = n;
+}
+
+static inline void emit_unary(Compiler *comp, int start, HkOpCode op)
+{
+  HkChunk *chunk = &comp->fn->chunk;
+  HkValue val;
+  HkValue result;
+  if (read_literal(comp, start, chunk->codeLength, &val) && fold_unary(op, val, &result))
+  {
+    int end = chunk->codeLength;
+    chunk->codeLength = start;
+    if (emit_literal(comp, result))
+      return;
+    chunk->codeLength = end;
+  }
+  hk_chunk_emit_opcode(chunk, op);
+}
+
+static inline void emit_binary(Compiler *comp, int start1, int start2, HkOpCode op)
+{
+  HkChunk *chunk = &comp->fn->chunk;
+  HkValue val1;
+  HkValue val2;
+  HkValue result;
+  if (read_literal(comp, start1, start2, &val1)
+    && read_literal(comp, start2, chunk->codeLength, &val2)
+    && fold_binary(op, val1, val2, &result))
+  {
+    int end = chunk->codeLength;
+    hk_value_incr_ref(result);
+    chunk->codeLength = start1;
+    bool folded = emit_literal(comp, result);
+    hk_value_release(result);
+    if (folded)
+      return;
+    chunk->codeLength = end;
+  }
+  hk_chunk_emit_opcode(chunk, op);
+}
+
+static inline int inline_length(uint8_t *code, int arity)
+{
+  switch (code[0])
+  {
+  case HK_OP_NIL:
+  case HK_OP_FALSE:
+  case HK_OP_TRUE:
+  case HK_OP_RANGE:
+  case HK_OP_POP:
+  case HK_OP_GET_ELEMENT:
+  case HK_OP_EQUAL:
+  case HK_OP_GREATER:
+  case HK_OP_LESS:
+  case HK_OP_NOT_EQUAL:
+  case HK_OP_NOT_GREATER:
+  case HK_OP_NOT_LESS:
+  case HK_OP_BITWISE_OR:
+  case HK_OP_BITWISE_XOR:
+  case HK_OP_BITWISE_AND:
+  case HK_OP_LEFT_SHIFT:
+  case HK_OP_RIGHT_SHIFT:
+  case HK_OP_ADD:
+  case HK_OP_SUBTRACT:
+  case HK_OP_MULTIPLY:
+  case HK_OP_DIVIDE:
+  case HK_OP_QUOTIENT:
+  case HK_OP_REMAINDER:
+  case HK_OP_NEGATE:
+  case HK_OP_NOT:
+  case HK_OP_BITWISE_NOT:
+  case HK_OP_RETURN:
+  case HK_OP_RETURN_NIL:
+    return 1;
+  case HK_OP_CONSTANT:
+  case HK_OP_ARRAY:
+  case HK_OP_INSTANCE:
+  case HK_OP_CONSTRUCT:
+  case HK_OP_GLOBAL:
+  case HK_OP_GET_FIELD:
+  case HK_OP_CALL:
+    return 2;
+  case HK_OP_GET_LOCAL:
+    // Only parameters are read, so every use can take the argument instead.
+    return code[1] >= 1 && code[1] <= arity ? 2 : -1;
+  case HK_OP_INT:
+  case HK_OP_JUMP:
+  case HK_OP_JUMP_IF_FALSE:
+  case HK_OP_JUMP_IF_TRUE:
+  case HK_OP_JUMP_IF_TRUE_OR_POP:
+  case HK_OP_JUMP_IF_FALSE_OR_POP:
+    return 3;
+  default:
+    break;
+  }
+  return -1;
+}
+
+static inline bool is_inlinable(HkFunction *fn)
+{
+  HkChunk *chunk = &fn->chunk;
+  if (fn->numNonlocals || fn->functionsLength || fn->arity > MAX_INLINE_PARAMS
+    || chunk->codeLength > MAX_INLINE_SIZE)
+    return false;
+  for (int offset = 0; offset < chunk->codeLength; )
+  {
+    int length = inline_length(&chunk->code[offset], fn->arity);
+    if (length == -1)
+      return false;
+    offset += length;
+  }
+  return true;
+}
+
+static inline bool is_simple_argument(uint8_t *code, int length)
+{
+  switch (code[0])
+  {
+  case HK_OP_NIL:
+  case HK_OP_FALSE:
+  case HK_OP_TRUE:
+    return length == 1;
+  case HK_OP_CONSTANT:
+  case HK_OP_GLOBAL:
+  case HK_OP_NONLOCAL:
+  case HK_OP_GET_LOCAL:
+    return length == 2;
+  case HK_OP_INT:
+    return length == 3;
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline int final_return(HkFunction *fn)
+{
+  HkChunk *chunk = &fn->chunk;
+  uint8_t *code = chunk->code;
+  int length = chunk->codeLength;
+  int last = 0;
+  int prev = -1;
+  bool targeted = false;
+  for (int offset = 0; offset < length; offset += inline_length(&code[offset], fn->arity))
+  {
+    HkOpCode op = (HkOpCode) code[offset];
+    if (op >= HK_OP_JUMP && op <= HK_OP_JUMP_IF_FALSE_OR_POP
+      && *((uint16_t *) &code[offset + 1]) == length - 1)
+      targeted = true;
+    prev = last;
+    last = offset;
+  }
+  // A block body ends with an unreachable `return nil` after its last
+  // `return`.
+  if (code[last] == HK_OP_RETURN_NIL && prev != last && code[prev] == HK_OP_RETURN
+    && prev + 1 == last && !targeted)
+    return prev;
+  return last;
+}
+
+static bool inline_call(Compiler *comp, HkFunction *callee, int start, int *args)
+{
+  HkChunk *chunk = &comp->fn->chunk;
+  int arity = callee->arity;
+  for (int i = 0; i < arity; ++i)
+    if (!is_simple_argument(&chunk->code[args[i]], args[i + 1] - args[i]))
+      return false;
+  int end = chunk->codeLength;
+  uint8_t saved[2 + 3 * MAX_INLINE_PARAMS];
+  memcpy(saved, &chunk->code[start], end - start);
+  int numLines = chunk->lines.length;
+  int callerLine = numLines ? chunk->lines.lastNo : 0;
+  discard_code(comp, start);
+  HkChunk *calleeChunk = &callee->chunk;
+  int numCalleeLines = calleeChunk->lines.length;
+  HkLine *calleeLines = hk_line_table_unpack(&calleeChunk->lines);
+  uint8_t *code = calleeChunk->code;
+  int length = calleeChunk->codeLength;
+  HkValue *consts = calleeChunk->consts->elements;
+  int last = final_return(callee);
+  int offsets[MAX_INLINE_SIZE + 1];
+  int jumps[MAX_INLINE_SIZE];
+  int targets[MAX_INLINE_SIZE];
+  int numJumps = 0;
+  int line = 0;
+  bool replaced = false;
+  for (int offset = 0; offset <= last; )
+  {
+    offsets[offset] = chunk->codeLength;
+    // Errors raised by the inlined code report the lines of the callee, even
+    // where the caller has already recorded a line at the same offset.
+    for (; line < numCalleeLines && calleeLines[line].offset <= offset; ++line)
+    {
+      HkLineTable *lines = &chunk->lines;
+      if (lines->length == numLines && numLines && lines->lastOffset == chunk->codeLength)
+      {
+        replaced = true;
+        hk_line_table_truncate(lines, numLines - 1);
+      }
+      hk_chunk_append_line(chunk, calleeLines[line].no);
+    }
+    HkOpCode op = (HkOpCode) code[offset];
+    int n = inline_length(&code[offset], arity);
+    switch (op)
+    {
+    case HK_OP_GET_LOCAL:
+      {
+        int index = code[offset + 1] - 1;
+        int argLength = args[index + 1] - args[index];
+        for (int i = 0; i < argLength; ++i)
+          hk_chunk_emit_byte(chunk, saved[args[index] - start + i]);
+      }
+      break;
+    case HK_OP_CONSTANT:
+    case HK_OP_GET_FIELD:
+      {
+        int index = literal_index(comp, consts[code[offset + 1]]);
+        if (index == -1)
+          goto fail;
+        hk_chunk_emit_opcode(chunk, op);
+        hk_chunk_emit_byte(chunk, (uint8_t) index);
+      }
+      break;
+    case HK_OP_JUMP:
+    case HK_OP_JUMP_IF_FALSE:
+    case HK_OP_JUMP_IF_TRUE:
+    case HK_OP_JUMP_IF_TRUE_OR_POP:
+    case HK_OP_JUMP_IF_FALSE_OR_POP:
+      targets[numJumps] = *((uint16_t *) &code[offset + 1]);
+      jumps[numJumps++] = emit_jump(chunk, op);
+      break;
+    case HK_OP_RETURN:
+    case HK_OP_RETURN_NIL:
+      if (op == HK_OP_RETURN_NIL)
+        hk_chunk_emit_opcode(chunk, HK_OP_NIL);
+      if (offset == last)
+        break;
+      targets[numJumps] = length;
+      jumps[numJumps++] = emit_jump(chunk, HK_OP_JUMP);
+      break;
+    default:
+      for (int i = 0; i < n; ++i)
+        hk_chunk_emit_byte(chunk, code[offset + i]);
+      break;
+    }
+    offset += n;
+  }
+  for (int offset = last + inline_length(&code[last], arity); offset <= length; ++offset)
+    offsets[offset] = chunk->codeLength;
+  if (chunk->codeLength > UINT16_MAX)
+    goto fail;
+  for (int i = 0; i < numJumps; ++i)
+    *((uint16_t *) &chunk->code[jumps[i]]) = (uint16_t) offsets[targets[i]];
+  hk_free(calleeLines);
+  if (line && numLines)
+    hk_chunk_append_line(chunk, callerLine);
+  return true;
+fail:
+  hk_free(calleeLines);
+  discard_code(comp, start);
+  hk_line_table_truncate(&chunk->lines, replaced ? numLines - 1 : numLines);
+  if (replaced)
+    hk_chunk_append_line(chunk, callerLine);
+  for (int i = 0; i < end - start; ++i)
+    hk_chunk_emit_byte(chunk, saved[i]);
+  return false;
+}
+
+static int compile_inline_call(Compiler *comp, HkFunction *callee, int start)
+{
+  Lexer *lex = comp->lex;
+  HkChunk *chunk = &comp->fn->chunk;
+  lexer_next_token(lex);
+  int args[MAX_INLINE_PARAMS + 1];
+  args[0] = chunk->codeLength;
+  uint8_t numArgs = 0;
+  if (!match(lex, TOKEN_KIND_RPAREN))
+  {
+    compile_expression(comp);
+    if (++numArgs <= MAX_INLINE_PARAMS)
+      args[numArgs] = chunk->codeLength;
+    while (match(lex, TOKEN_KIND_COMMA))
+    {
+      lexer_next_token(lex);
+      compile_expression(comp);
+      if (++numArgs <= MAX_INLINE_PARAMS)
+        args[numArgs] = chunk->codeLength;
+    }
+  }
+  consume(comp, TOKEN_KIND_RPAREN);
+  if (numArgs == callee->arity && inline_call(comp, callee, start, args))
+    return numArgs;
+  hk_chunk_emit_opcode(chunk, HK_OP_CALL);
+  hk_chunk_emit_byte(chunk, numArgs);
+  return numArgs;
+}
+
+static inline void drop_unused_nonlocals(Compiler *comp, HkFunction *child, int start)
+{
+  // A capture whose every use was inlined is no longer read by the child, so
+  // the enclosing function need not load it when creating the closure.
+  HkChunk *chunk = &comp->fn->chunk;
+  int numNonlocals = child->numNonlocals;
+  if (!numNonlocals || chunk->codeLength - start != numNonlocals << 1)
+    return;
+  uint8_t *code = child->chunk.code;
+  int length = child->chunk.codeLength;
+  bool used[UINT8_MAX + 1] = { false };
+  for (int offset = 0; offset < length; offset += peephole_instruction_length(&code[offset]))
+    if (code[offset] == HK_OP_NONLOCAL)
+      used[code[offset + 1]] = true;
+  uint8_t indexes[UINT8_MAX + 1];
+  int n = 0;
+  for (int i = 0; i < numNonlocals; ++i)
+  {
+    if (!used[i])
+      continue;
+    indexes[i] = (uint8_t) n;
+    chunk->code[start + (n << 1)] = chunk->code[start + (i << 1)];
+    chunk->code[start + (n << 1) + 1] = chunk->code[start + (i << 1) + 1];
+    ++n;
+  }
+  if (n == numNonlocals)
+    return;
+  for (int offset = 0; offset < length; offset += peephole_instruction_length(&code[offset]))
+    if (code[offset] == HK_OP_NONLOCAL)
+      code[offset + 1] = indexes[code[offset + 1]];
+  child->numNonlocals = (uint8_t) n;
+  discard_code(comp, start + (n << 1));
+}
+
 static inline void start_loop(Compiler *comp, Loop *loop)
 {
   loop->parent = comp->loop;
@@ -645,8 +1123,16 @@ static void compile_constant_declaration(Compiler *comp)
     Token tk = lex->token;
     lexer_next_token(lex);
     consume(comp, TOKEN_KIND_EQ);
+    int start = chunk->codeLength;
     compile_expression(comp);
     define_local(comp, &tk, false);
+    record_literal(comp, start);
+    if (chunk->codeLength - start == 2 && chunk->code[start] == HK_OP_CLOSURE)
+    {
+      HkFunction *child = comp->fn->functions[chunk->code[start + 1]];
+      if (is_inlinable(child))
+        comp->variables[comp->numVariables - 1].function = child;
+    }
     return;
   }
   if (match(lex, TOKEN_KIND_LBRACKET))
@@ -827,8 +1313,17 @@ static void compile_assign_statement(Compiler *comp, Token *tk)
     compile_expression(comp);
     goto end;
   }
+  int start = chunk->codeLength;
   var = compile_variable(comp, tk, true);
-  if (compile_assign(comp, PRODUCTION_NONE, true) == PRODUCTION_CALL)
+  Production prod = PRODUCTION_NONE;
+  bool inplace = true;
+  if (var.function && match(lex, TOKEN_KIND_LPAREN))
+  {
+    (void) compile_inline_call(comp, var.function, start);
+    prod = PRODUCTION_CALL;
+    inplace = false;
+  }
+  if (compile_assign(comp, prod, inplace) == PRODUCTION_CALL)
   {
     hk_chunk_emit_opcode(chunk, HK_OP_POP);
     return;
@@ -1089,10 +1584,12 @@ static void compile_function_declaration(Compiler *comp)
   Token tk = lex->token;
   lexer_next_token(lex);
   define_local(comp, &tk, false);
+  Variable *var = &comp->variables[comp->numVariables - 1];
   HkString *fnName = hk_string_from_chars(tk.length, tk.start);
   compiler_init(&childComp, comp, comp->flags, lex, fnName);
   add_variable(&childComp, true, 0, &tk, false);
   HkChunk *childChunk = &childComp.fn->chunk;
+  int start = chunk->codeLength;
   consume(comp, TOKEN_KIND_LPAREN);
   if (match(lex, TOKEN_KIND_RPAREN))
   {
@@ -1100,6 +1597,7 @@ static void compile_function_declaration(Compiler *comp)
     if (match(lex, TOKEN_KIND_ARROW))
     {
       lexer_next_token(lex);
+      hk_chunk_append_line(childChunk, lex->token.line);
       compile_expression(&childComp);
       consume(comp, TOKEN_KIND_SEMICOLON);
       hk_chunk_emit_opcode(childChunk, HK_OP_RETURN);
@@ -1116,6 +1614,7 @@ static void compile_function_declaration(Compiler *comp)
   if (match(lex, TOKEN_KIND_ARROW))
   {
     lexer_next_token(lex);
+    hk_chunk_append_line(childChunk, lex->token.line);
     compile_expression(&childComp);
     consume(comp, TOKEN_KIND_SEMICOLON);
     hk_chunk_emit_opcode(childChunk, HK_OP_RETURN);
@@ -1127,10 +1626,13 @@ static void compile_function_declaration(Compiler *comp)
   hk_chunk_emit_opcode(childChunk, HK_OP_RETURN_NIL);
   uint8_t index;
 end:
+  drop_unused_nonlocals(comp, childComp.fn, start);
   index = fn->functionsLength;
   hk_function_append_child(fn, childComp.fn);
   hk_chunk_emit_opcode(chunk, HK_OP_CLOSURE);
   hk_chunk_emit_byte(chunk, index);
+  if (is_inlinable(childComp.fn))
+    var->function = childComp.fn;
 }
 
 static void compile_params(Compiler *comp)
@@ -1162,12 +1664,14 @@ static void compile_anonymous_function(Compiler *comp)
   Compiler childComp;
   compiler_init(&childComp, comp, comp->flags, lex, NULL);
   HkChunk *childChunk = &childComp.fn->chunk;
+  int start = chunk->codeLength;
   if (match(lex, TOKEN_KIND_PIPE))
   {
     lexer_next_token(lex);
     if (match(lex, TOKEN_KIND_ARROW))
     {
       lexer_next_token(lex);
+      hk_chunk_append_line(childChunk, lex->token.line);
       compile_expression(&childComp);
       hk_chunk_emit_opcode(childChunk, HK_OP_RETURN);
       goto end;
@@ -1183,6 +1687,7 @@ static void compile_anonymous_function(Compiler *comp)
   if (match(lex, TOKEN_KIND_ARROW))
   {
     lexer_next_token(lex);
+    hk_chunk_append_line(childChunk, lex->token.line);
     compile_expression(&childComp);
     hk_chunk_emit_opcode(childChunk, HK_OP_RETURN);
     goto end;
@@ -1193,6 +1698,7 @@ static void compile_anonymous_function(Compiler *comp)
   hk_chunk_emit_opcode(childChunk, HK_OP_RETURN_NIL);
   uint8_t index;
 end:
+  drop_unused_nonlocals(comp, childComp.fn, start);
   index = fn->functionsLength;
   hk_function_append_child(fn, childComp.fn);
   hk_chunk_emit_opcode(chunk, HK_OP_CLOSURE);
@@ -1208,9 +1714,11 @@ static void compile_anonymous_function_without_params(Compiler *comp)
   Compiler childComp;
   compiler_init(&childComp, comp, comp->flags, lex, NULL);
   HkChunk *childChunk = &childComp.fn->chunk;
+  int start = chunk->codeLength;
   if (match(lex, TOKEN_KIND_ARROW))
   {
     lexer_next_token(lex);
+    hk_chunk_append_line(childChunk, lex->token.line);
     compile_expression(&childComp);
     hk_chunk_emit_opcode(childChunk, HK_OP_RETURN);
     goto end;
@@ -1221,6 +1729,7 @@ static void compile_anonymous_function_without_params(Compiler *comp)
   hk_chunk_emit_opcode(childChunk, HK_OP_RETURN_NIL);
   uint8_t index;
 end:
+  drop_unused_nonlocals(comp, childComp.fn, start);
   index = fn->functionsLength;
   hk_function_append_child(fn, childComp.fn);
   hk_chunk_emit_opcode(chunk, HK_OP_CLOSURE);
@@ -1306,8 +1815,29 @@ static void compile_if_statement(Compiler *comp, bool not)
     compile_variable_declaration(comp);
     consume(comp, TOKEN_KIND_SEMICOLON);
   }
+  int start = chunk->codeLength;
   compile_expression(comp);
   consume(comp, TOKEN_KIND_RPAREN);
+  HkValue val;
+  if (read_literal(comp, start, chunk->codeLength, &val))
+  {
+    chunk->codeLength = start;
+    bool taken = hk_is_truthy(val) != not;
+    if (taken)
+      compile_statement(comp);
+    else
+      compile_dead_statement(comp);
+    if (match(lex, TOKEN_KIND_ELSE_KW))
+    {
+      lexer_next_token(lex);
+      if (taken)
+        compile_dead_statement(comp);
+      else
+        compile_statement(comp);
+    }
+    pop_scope(comp);
+    return;
+  }
   HkOpCode op = not ? HK_OP_JUMP_IF_TRUE : HK_OP_JUMP_IF_FALSE;
   int offset1 = emit_jump(chunk, op);
   compile_statement(comp);
@@ -1322,6 +1852,168 @@ static void compile_if_statement(Compiler *comp, bool not)
   pop_scope(comp);
 }
 
+static void compile_dead_statement(Compiler *comp)
+{
+  // Unreachable code is still compiled for its diagnostics, then dropped
+  // unless it declared a variable in the enclosing scope.
+  HkChunk *chunk = &comp->fn->chunk;
+  uint8_t nextIndex = comp->nextIndex;
+  int offset = emit_jump(chunk, HK_OP_JUMP);
+  compile_statement(comp);
+  if (comp->nextIndex == nextIndex)
+  {
+    discard_code(comp, offset - 1);
+    return;
+  }
+  patch_jump(comp, offset);
+}
+
+static inline void start_jump_table(Compiler *comp, JumpTable *table)
+{
+  table->isConstant = true;
+  table->op = HK_OP_NIL;
+  table->numArms = 0;
+  table->offset = emit_jump(&comp->fn->chunk, HK_OP_JUMP);
+}
+
+static inline int compile_match_pattern(Compiler *comp, JumpTable *table)
+{
+  HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
+  compile_expression(comp);
+  consume(comp, TOKEN_KIND_ARROW);
+  int offset = emit_jump(chunk, HK_OP_JUMP_IF_NOT_EQUAL);
+  if (!table->isConstant)
+    return offset;
+  uint8_t *code = chunk->code;
+  HkOpCode op = (HkOpCode) code[start];
+  int length = offset - 1 - start;
+  bool isInt = op == HK_OP_INT && length == 3;
+  bool isString = op == HK_OP_CONSTANT && length == 2
+    && hk_is_string(chunk->consts->elements[code[start + 1]]);
+  if ((!isInt && !isString) || (table->numArms && op != table->op)
+    || table->numArms == MAX_ARMS)
+  {
+    table->isConstant = false;
+    return offset;
+  }
+  table->op = op;
+  table->patterns[table->numArms] = start;
+  table->bodies[table->numArms] = (uint16_t) chunk->codeLength;
+  ++table->numArms;
+  return offset;
+}
+
+static inline void end_jump_table(Compiler *comp, JumpTable *table, uint16_t fallback)
+{
+  if (!table->isConstant || table->numArms < MIN_JUMP_TABLE_ARMS
+    || !(table->op == HK_OP_INT ? emit_int_jump_table(comp, table, fallback)
+    : emit_string_jump_table(comp, table, fallback)))
+    patch_jump_table(comp, table, table->offset + 2);
+}
+
+static inline void patch_jump_table(Compiler *comp, JumpTable *table, int jump)
+{
+  *((uint16_t *) &comp->fn->chunk.code[table->offset]) = (uint16_t) jump;
+}
+
+static inline bool emit_int_jump_table(Compiler *comp, JumpTable *table, uint16_t fallback)
+{
+  HkChunk *chunk = &comp->fn->chunk;
+  uint8_t *code = chunk->code;
+  int min = UINT16_MAX;
+  int max = 0;
+  for (int i = 0; i < table->numArms; ++i)
+  {
+    int key = *((uint16_t *) &code[table->patterns[i] + 1]);
+    min = key < min ? key : min;
+    max = key > max ? key : max;
+  }
+  int size = max - min + 1;
+  if (size > 2 * table->numArms)
+    return false;
+  uint16_t targets[2 * MAX_ARMS];
+  for (int i = 0; i < size; ++i)
+    targets[i] = fallback;
+  for (int i = table->numArms - 1; i > -1; --i)
+    targets[*((uint16_t *) &code[table->patterns[i] + 1]) - min] = table->bodies[i];
+  int offset = emit_jump(chunk, HK_OP_JUMP);
+  patch_jump_table(comp, table, chunk->codeLength);
+  hk_chunk_emit_opcode(chunk, HK_OP_MATCH_INT);
+  hk_chunk_emit_word(chunk, fallback);
+  hk_chunk_emit_word(chunk, (uint16_t) min);
+  hk_chunk_emit_word(chunk, (uint16_t) size);
+  for (int i = 0; i < size; ++i)
+    hk_chunk_emit_word(chunk, targets[i]);
+  patch_jump(comp, offset);
+  return true;
+}
+
+static inline bool emit_string_jump_table(Compiler *comp, JumpTable *table,
+  uint16_t fallback)
+{
+  // Searches for a seed that maps every key to its own slot, so a lookup
+  // costs one hash and one string comparison.
+  HkChunk *chunk = &comp->fn->chunk;
+  uint8_t *code = chunk->code;
+  HkValue *consts = chunk->consts->elements;
+  int numKeys = 0;
+  uint8_t indexes[MAX_ARMS];
+  uint16_t targets[MAX_ARMS];
+  uint32_t hashes[MAX_ARMS];
+  for (int i = 0; i < table->numArms; ++i)
+  {
+    uint8_t index = code[table->patterns[i] + 1];
+    HkString *key = hk_as_string(consts[index]);
+    bool isDuplicate = false;
+    for (int j = 0; j < numKeys && !isDuplicate; ++j)
+      isDuplicate = hk_string_equal(key, hk_as_string(consts[indexes[j]]));
+    if (isDuplicate)
+      continue;
+    indexes[numKeys] = index;
+    targets[numKeys] = table->bodies[i];
+    hashes[numKeys] = hk_string_hash(key);
+    ++numKeys;
+  }
+  int bits = 1;
+  while ((1 << bits) < 2 * numKeys)
+    ++bits;
+  uint8_t slots[1 << MAX_JUMP_TABLE_BITS];
+  for (; bits <= MAX_JUMP_TABLE_BITS; ++bits)
+  {
+    int size = 1 << bits;
+    for (uint16_t seed = 0; seed < MAX_JUMP_TABLE_SEEDS; ++seed)
+    {
+      memset(slots, 0, size);
+      int i = 0;
+      for (; i < numKeys; ++i)
+      {
+        uint32_t slot = hk_match_slot(hashes[i], seed, bits);
+        if (slots[slot])
+          break;
+        slots[slot] = (uint8_t) (i + 1);
+      }
+      if (i < numKeys)
+        continue;
+      int offset = emit_jump(chunk, HK_OP_JUMP);
+      patch_jump_table(comp, table, chunk->codeLength);
+      hk_chunk_emit_opcode(chunk, HK_OP_MATCH_STRING);
+      hk_chunk_emit_word(chunk, fallback);
+      hk_chunk_emit_word(chunk, seed);
+      hk_chunk_emit_byte(chunk, (uint8_t) bits);
+      for (int j = 0; j < size; ++j)
+      {
+        int k = slots[j] - 1;
+        hk_chunk_emit_byte(chunk, k < 0 ? 0 : indexes[k]);
+        hk_chunk_emit_word(chunk, k < 0 ? fallback : targets[k]);
+      }
+      patch_jump(comp, offset);
+      return true;
+    }
+  }
+  return false;
+}
+
 static void compile_match_statement(Compiler *comp)
 {
   Lexer *lex = comp->lex;
@@ -1342,25 +2034,27 @@ static void compile_match_statement(Compiler *comp)
   compile_expression(comp);
   consume(comp, TOKEN_KIND_RPAREN);
   consume(comp, TOKEN_KIND_LBRACE);
-  compile_expression(comp);
-  consume(comp, TOKEN_KIND_ARROW);
-  int offset1 = emit_jump(chunk, HK_OP_JUMP_IF_NOT_EQUAL);
+  JumpTable table;
+  start_jump_table(comp, &table);
+  int offset1 = compile_match_pattern(comp, &table);
   compile_statement(comp);
   int offset2 = emit_jump(chunk, HK_OP_JUMP);
   patch_jump(comp, offset1);
-  compile_match_statement_member(comp);
+  compile_match_statement_member(comp, &table);
   patch_jump(comp, offset2);
   pop_scope(comp);
 }
 
-static void compile_match_statement_member(Compiler *comp)
+static void compile_match_statement_member(Compiler *comp, JumpTable *table)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
+  uint16_t fallback = (uint16_t) chunk->codeLength;
   if (match(lex, TOKEN_KIND_RBRACE))
   {
     lexer_next_token(lex);
     hk_chunk_emit_opcode(chunk, HK_OP_POP);
+    end_jump_table(comp, table, fallback);
     return;
   }
   if (match(lex, TOKEN_KIND_UNDERSCORE_KW))
@@ -1370,15 +2064,14 @@ static void compile_match_statement_member(Compiler *comp)
     hk_chunk_emit_opcode(chunk, HK_OP_POP);
     compile_statement(comp);
     consume(comp, TOKEN_KIND_RBRACE);
+    end_jump_table(comp, table, fallback);
     return;
   }
-  compile_expression(comp);
-  consume(comp, TOKEN_KIND_ARROW);
-  int offset1 = emit_jump(chunk, HK_OP_JUMP_IF_NOT_EQUAL);
+  int offset1 = compile_match_pattern(comp, table);
   compile_statement(comp);
   int offset2 = emit_jump(chunk, HK_OP_JUMP);
   patch_jump(comp, offset1);
-  compile_match_statement_member(comp);
+  compile_match_statement_member(comp, table);
   patch_jump(comp, offset2);
 }
 
@@ -1405,8 +2098,24 @@ static void compile_while_statement(Compiler *comp, bool not)
   consume(comp, TOKEN_KIND_LPAREN);
   Loop loop;
   start_loop(comp, &loop);
+  int start = chunk->codeLength;
   compile_expression(comp);
   consume(comp, TOKEN_KIND_RPAREN);
+  HkValue val;
+  if (read_literal(comp, start, chunk->codeLength, &val))
+  {
+    chunk->codeLength = start;
+    if (hk_is_truthy(val) != not)
+    {
+      compile_statement(comp);
+      hk_chunk_emit_opcode(chunk, HK_OP_JUMP);
+      hk_chunk_emit_word(chunk, loop.jump);
+    }
+    else
+      compile_dead_statement(comp);
+    end_loop(comp);
+    return;
+  }
   HkOpCode op = not ? HK_OP_JUMP_IF_TRUE : HK_OP_JUMP_IF_FALSE;
   int offset = emit_jump(chunk, op);
   compile_statement(comp);
@@ -1461,8 +2170,15 @@ static void compile_for_statement(Compiler *comp)
     }
     else if (match(lex, TOKEN_KIND_VAR_KW))
     {
+      int numVariables = comp->numVariables;
       compile_variable_declaration(comp);
       consume(comp, TOKEN_KIND_SEMICOLON);
+      if (comp->numVariables == numVariables + 1
+        && compile_counted_loop(comp, &comp->variables[numVariables]))
+      {
+        pop_scope(comp);
+        return;
+      }
     }
     else if (match(lex, TOKEN_KIND_NAME))
     {
@@ -1515,6 +2231,98 @@ static void compile_for_statement(Compiler *comp)
   pop_scope(comp);
 }
 
+static bool compile_counted_loop(Compiler *comp, Variable *counter)
+{
+  // Matches `i < bound; i++)` and its `<=`, `>`, `>=` and `i--` forms, where
+  // bound is an integer literal or another local variable.
+  Lexer *lex = comp->lex;
+  HkChunk *chunk = &comp->fn->chunk;
+  Lexer saved = *lex;
+  if (!match(lex, TOKEN_KIND_NAME) || !variable_match(&lex->token, counter))
+    goto fail;
+  lexer_next_token(lex);
+  HkOpCode op;
+  TokenKind step = TOKEN_KIND_PLUSPLUS;
+  switch (lex->token.kind)
+  {
+  case TOKEN_KIND_LT:
+    op = HK_OP_LESS;
+    break;
+  case TOKEN_KIND_LTEQ:
+    op = HK_OP_NOT_GREATER;
+    break;
+  case TOKEN_KIND_GT:
+    op = HK_OP_GREATER;
+    step = TOKEN_KIND_DASHDASH;
+    break;
+  case TOKEN_KIND_GTEQ:
+    op = HK_OP_NOT_LESS;
+    step = TOKEN_KIND_DASHDASH;
+    break;
+  default:
+    goto fail;
+  }
+  lexer_next_token(lex);
+  HkOpCode loopOp;
+  uint16_t bound;
+  if (match(lex, TOKEN_KIND_INT))
+  {
+    double data = parse_double(comp);
+    if (data > UINT16_MAX)
+      goto fail;
+    loopOp = HK_OP_FOR_LOOP_INT;
+    bound = (uint16_t) data;
+  }
+  else if (match(lex, TOKEN_KIND_NAME))
+  {
+    Variable *var = lookup_variable(comp, &lex->token);
+    if (!var || !var->isLocal || var == counter)
+      goto fail;
+    loopOp = HK_OP_FOR_LOOP;
+    bound = var->index;
+  }
+  else
+    goto fail;
+  lexer_next_token(lex);
+  if (!match(lex, TOKEN_KIND_SEMICOLON))
+    goto fail;
+  lexer_next_token(lex);
+  if (!match(lex, TOKEN_KIND_NAME) || !variable_match(&lex->token, counter))
+    goto fail;
+  lexer_next_token(lex);
+  if (!match(lex, step))
+    goto fail;
+  lexer_next_token(lex);
+  if (!match(lex, TOKEN_KIND_RPAREN))
+    goto fail;
+  *lex = saved;
+  compile_expression(comp);
+  consume(comp, TOKEN_KIND_SEMICOLON);
+  int offset1 = emit_jump(chunk, HK_OP_JUMP_IF_FALSE);
+  lexer_next_token(lex);
+  lexer_next_token(lex);
+  consume(comp, TOKEN_KIND_RPAREN);
+  int offset2 = emit_jump(chunk, HK_OP_JUMP);
+  Loop loop;
+  start_loop(comp, &loop);
+  int offset3 = emit_jump(chunk, HK_OP_JUMP);
+  patch_jump(comp, offset2);
+  uint16_t jump = (uint16_t) chunk->codeLength;
+  compile_statement(comp);
+  patch_jump(comp, offset3);
+  hk_chunk_emit_opcode(chunk, loopOp);
+  hk_chunk_emit_word(chunk, jump);
+  hk_chunk_emit_byte(chunk, counter->index);
+  hk_chunk_emit_byte(chunk, (uint8_t) op);
+  hk_chunk_emit_word(chunk, bound);
+  patch_jump(comp, offset1);
+  end_loop(comp);
+  return true;
+fail:
+  *lex = saved;
+  return false;
+}
+
 static void compile_foreach_statement(Compiler *comp)
 {
   Lexer *lex = comp->lex;
@@ -1531,19 +2339,22 @@ static void compile_foreach_statement(Compiler *comp)
   consume(comp, TOKEN_KIND_IN_KW);
   compile_expression(comp);
   consume(comp, TOKEN_KIND_RPAREN);
-  hk_chunk_emit_opcode(chunk, HK_OP_ITERATOR);
+  // The iterable and the loop state live in two unnamed locals.
+  Token hidden = tk;
+  hidden.length = 0;
+  add_local(comp, &hidden, false);
+  add_local(comp, &hidden, false);
+  hk_chunk_emit_opcode(chunk, HK_OP_FOREACH_INIT);
   int offset1 = emit_jump(chunk, HK_OP_JUMP);
   Loop loop;
   start_loop(comp, &loop);
-  hk_chunk_emit_opcode(chunk, HK_OP_NEXT);
+  hk_chunk_emit_opcode(chunk, HK_OP_FOREACH_NEXT);
   patch_jump(comp, offset1);
-  int offset2 = emit_jump(chunk, HK_OP_JUMP_IF_NOT_VALID);
-  hk_chunk_emit_opcode(chunk, HK_OP_CURRENT);
+  int offset2 = emit_jump(chunk, HK_OP_FOREACH_CURRENT);
   compile_statement(comp);
   hk_chunk_emit_opcode(chunk, HK_OP_JUMP);
   hk_chunk_emit_word(chunk, loop.jump);
   patch_jump(comp, offset2);
-  hk_chunk_emit_opcode(chunk, HK_OP_POP);
   end_loop(comp);
   pop_scope(comp);
 }
@@ -1626,11 +2437,27 @@ static void compile_block(Compiler *comp)
 static void compile_expression(Compiler *comp)
 {
   Lexer *lex = comp->lex;
+  HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
   compile_and_expression(comp);
   while (match(lex, TOKEN_KIND_PIPEPIPE))
   {
     lexer_next_token(lex);
-    int offset = emit_jump(&comp->fn->chunk, HK_OP_JUMP_IF_TRUE_OR_POP);
+    HkValue val;
+    if (read_literal(comp, start, chunk->codeLength, &val))
+    {
+      int offset = chunk->codeLength;
+      if (hk_is_falsey(val))
+      {
+        chunk->codeLength = start;
+        compile_and_expression(comp);
+        continue;
+      }
+      compile_and_expression(comp);
+      chunk->codeLength = offset;
+      continue;
+    }
+    int offset = emit_jump(chunk, HK_OP_JUMP_IF_TRUE_OR_POP);
     compile_and_expression(comp);
     patch_jump(comp, offset);
   }
@@ -1639,11 +2466,27 @@ static void compile_expression(Compiler *comp)
 static void compile_and_expression(Compiler *comp)
 {
   Lexer *lex = comp->lex;
+  HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
   compile_equal_expression(comp);
   while (match(lex, TOKEN_KIND_AMPAMP))
   {
     lexer_next_token(lex);
-    int offset = emit_jump(&comp->fn->chunk, HK_OP_JUMP_IF_FALSE_OR_POP);
+    HkValue val;
+    if (read_literal(comp, start, chunk->codeLength, &val))
+    {
+      int offset = chunk->codeLength;
+      if (hk_is_truthy(val))
+      {
+        chunk->codeLength = start;
+        compile_equal_expression(comp);
+        continue;
+      }
+      compile_equal_expression(comp);
+      chunk->codeLength = offset;
+      continue;
+    }
+    int offset = emit_jump(chunk, HK_OP_JUMP_IF_FALSE_OR_POP);
     compile_equal_expression(comp);
     patch_jump(comp, offset);
   }
@@ -1653,21 +2496,24 @@ static void compile_equal_expression(Compiler *comp)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
   compile_comp_expression(comp);
   for (;;)
   {
     if (match(lex, TOKEN_KIND_EQEQ))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_comp_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_EQUAL);
+      emit_binary(comp, start, offset, HK_OP_EQUAL);
       continue;
     }
     if (match(lex, TOKEN_KIND_BANGEQ))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_comp_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_NOT_EQUAL);
+      emit_binary(comp, start, offset, HK_OP_NOT_EQUAL);
       continue;
     }
     break;
@@ -1678,35 +2524,40 @@ static void compile_comp_expression(Compiler *comp)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
   compile_bitwise_or_expression(comp);
   for (;;)
   {
     if (match(lex, TOKEN_KIND_GT))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_bitwise_or_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_GREATER);
+      emit_binary(comp, start, offset, HK_OP_GREATER);
       continue;
     }
     if (match(lex, TOKEN_KIND_GTEQ))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_bitwise_or_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_NOT_LESS);
+      emit_binary(comp, start, offset, HK_OP_NOT_LESS);
       continue;
     }
     if (match(lex, TOKEN_KIND_LT))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_bitwise_or_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_LESS);
+      emit_binary(comp, start, offset, HK_OP_LESS);
       continue;
     }
     if (match(lex, TOKEN_KIND_LTEQ))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_bitwise_or_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_NOT_GREATER);
+      emit_binary(comp, start, offset, HK_OP_NOT_GREATER);
       continue;
     }
     break;
@@ -1717,12 +2568,14 @@ static void compile_bitwise_or_expression(Compiler *comp)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
   compile_bitwise_xor_expression(comp);
   while (match(lex, TOKEN_KIND_PIPE))
   {
     lexer_next_token(lex);
+    int offset = chunk->codeLength;
     compile_bitwise_xor_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_BITWISE_OR);
+    emit_binary(comp, start, offset, HK_OP_BITWISE_OR);
   }
 }
 
@@ -1730,12 +2583,14 @@ static void compile_bitwise_xor_expression(Compiler *comp)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
   compile_bitwise_and_expression(comp);
   while (match(lex, TOKEN_KIND_CARET))
   {
     lexer_next_token(lex);
+    int offset = chunk->codeLength;
     compile_bitwise_and_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_BITWISE_XOR);
+    emit_binary(comp, start, offset, HK_OP_BITWISE_XOR);
   }
 }
 
@@ -1743,12 +2598,14 @@ static void compile_bitwise_and_expression(Compiler *comp)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
   compile_left_shift_expression(comp);
   while (match(lex, TOKEN_KIND_AMP))
   {
     lexer_next_token(lex);
+    int offset = chunk->codeLength;
     compile_left_shift_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_BITWISE_AND);
+    emit_binary(comp, start, offset, HK_OP_BITWISE_AND);
   }
 }
 
@@ -1756,12 +2613,14 @@ static void compile_left_shift_expression(Compiler *comp)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
   compile_right_shift_expression(comp);
   while (match(lex, TOKEN_KIND_LTLT))
   {
     lexer_next_token(lex);
+    int offset = chunk->codeLength;
     compile_right_shift_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_LEFT_SHIFT);
+    emit_binary(comp, start, offset, HK_OP_LEFT_SHIFT);
   }
 }
 
@@ -1769,12 +2628,14 @@ static void compile_right_shift_expression(Compiler *comp)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
   compile_range_expression(comp);
   while (match(lex, TOKEN_KIND_GTGT))
   {
     lexer_next_token(lex);
+    int offset = chunk->codeLength;
     compile_range_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_RIGHT_SHIFT);
+    emit_binary(comp, start, offset, HK_OP_RIGHT_SHIFT);
   }
 }
 
@@ -1795,21 +2656,24 @@ static void compile_add_expression(Compiler *comp)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
   compile_mul_expression(comp);
   for (;;)
   {
     if (match(lex, TOKEN_KIND_PLUS))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_mul_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_ADD);
+      emit_binary(comp, start, offset, HK_OP_ADD);
       continue;
     }
     if (match(lex, TOKEN_KIND_DASH))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_mul_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_SUBTRACT);
+      emit_binary(comp, start, offset, HK_OP_SUBTRACT);
       continue;
     }
     break;
@@ -1818,37 +2682,42 @@ static void compile_add_expression(Compiler *comp)
 
 static void compile_mul_expression(Compiler *comp)
 {
-  compile_unary_expression(comp);
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
+  int start = chunk->codeLength;
+  compile_unary_expression(comp);
   for (;;)
   {
     if (match(lex, TOKEN_KIND_STAR))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_unary_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_MULTIPLY);
+      emit_binary(comp, start, offset, HK_OP_MULTIPLY);
       continue;
     }
     if (match(lex, TOKEN_KIND_SLASH))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_unary_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_DIVIDE);
+      emit_binary(comp, start, offset, HK_OP_DIVIDE);
       continue;
     }
     if (match(lex, TOKEN_KIND_TILDESLASH))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_unary_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_QUOTIENT);
+      emit_binary(comp, start, offset, HK_OP_QUOTIENT);
       continue;
     }
     if (match(lex, TOKEN_KIND_PERCENT))
     {
       lexer_next_token(lex);
+      int offset = chunk->codeLength;
       compile_unary_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_REMAINDER);
+      emit_binary(comp, start, offset, HK_OP_REMAINDER);
       continue;
     }
     break;
@@ -1862,22 +2731,25 @@ static void compile_unary_expression(Compiler *comp)
   if (match(lex, TOKEN_KIND_DASH))
   {
     lexer_next_token(lex);
+    int start = chunk->codeLength;
     compile_unary_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_NEGATE);
+    emit_unary(comp, start, HK_OP_NEGATE);
     return;
   }
   if (match(lex, TOKEN_KIND_BANG))
   {
     lexer_next_token(lex);
+    int start = chunk->codeLength;
     compile_unary_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_NOT);
+    emit_unary(comp, start, HK_OP_NOT);
     return;
   }
   if (match(lex, TOKEN_KIND_TILDE))
   {
     lexer_next_token(lex);
+    int start = chunk->codeLength;
     compile_unary_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_BITWISE_NOT);
+    emit_unary(comp, start, HK_OP_BITWISE_NOT);
     return;
   }
   compile_prim_expression(comp);
@@ -2067,8 +2939,24 @@ static void compile_if_expression(Compiler *comp, bool not)
   HkChunk *chunk = &comp->fn->chunk;
   lexer_next_token(lex);
   consume(comp, TOKEN_KIND_LPAREN);
+  int start = chunk->codeLength;
   compile_expression(comp);
   consume(comp, TOKEN_KIND_RPAREN);
+  HkValue val;
+  if (read_literal(comp, start, chunk->codeLength, &val))
+  {
+    chunk->codeLength = start;
+    bool taken = hk_is_truthy(val) != not;
+    compile_expression(comp);
+    int offset = chunk->codeLength;
+    if (!taken)
+      chunk->codeLength = start;
+    consume(comp, TOKEN_KIND_ELSE_KW);
+    compile_expression(comp);
+    if (taken)
+      chunk->codeLength = offset;
+    return;
+  }
   HkOpCode op = not ? HK_OP_JUMP_IF_TRUE : HK_OP_JUMP_IF_FALSE;
   int offset1 = emit_jump(chunk, op);
   compile_expression(comp);
@@ -2088,9 +2976,9 @@ static void compile_match_expression(Compiler *comp)
   compile_expression(comp);
   consume(comp, TOKEN_KIND_RPAREN);
   consume(comp, TOKEN_KIND_LBRACE);
-  compile_expression(comp);
-  consume(comp, TOKEN_KIND_ARROW);
-  int offset1 = emit_jump(chunk, HK_OP_JUMP_IF_NOT_EQUAL);
+  JumpTable table;
+  start_jump_table(comp, &table);
+  int offset1 = compile_match_pattern(comp, &table);
   compile_expression(comp);
   int offset2 = emit_jump(chunk, HK_OP_JUMP);
   patch_jump(comp, offset1);
@@ -2101,26 +2989,26 @@ static void compile_match_expression(Compiler *comp)
     {
       lexer_next_token(lex);
       consume(comp, TOKEN_KIND_ARROW);
+      uint16_t fallback = (uint16_t) chunk->codeLength;
       hk_chunk_emit_opcode(chunk, HK_OP_POP);
       compile_expression(comp);
       consume(comp, TOKEN_KIND_RBRACE);
+      end_jump_table(comp, &table, fallback);
       patch_jump(comp, offset2);
       return;
     }
-    compile_match_expression_member(comp);
+    compile_match_expression_member(comp, &table);
     patch_jump(comp, offset2);
     return;
   }
   syntax_error_unexpected(comp);
 }
 
-static void compile_match_expression_member(Compiler *comp)
+static void compile_match_expression_member(Compiler *comp, JumpTable *table)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
-  compile_expression(comp);
-  consume(comp, TOKEN_KIND_ARROW);
-  int offset1 = emit_jump(chunk, HK_OP_JUMP_IF_NOT_EQUAL);
+  int offset1 = compile_match_pattern(comp, table);
   compile_expression(comp);
   int offset2 = emit_jump(chunk, HK_OP_JUMP);
   patch_jump(comp, offset1);
@@ -2131,13 +3019,15 @@ static void compile_match_expression_member(Compiler *comp)
     {
       lexer_next_token(lex);
       consume(comp, TOKEN_KIND_ARROW);
+      uint16_t fallback = (uint16_t) chunk->codeLength;
       hk_chunk_emit_opcode(chunk, HK_OP_POP);
       compile_expression(comp);
       consume(comp, TOKEN_KIND_RBRACE);
+      end_jump_table(comp, table, fallback);
       patch_jump(comp, offset2);
       return;
     }
-    compile_match_expression_member(comp);
+    compile_match_expression_member(comp, table);
     patch_jump(comp, offset2);
     return;
   }
@@ -2148,8 +3038,13 @@ static void compile_subscript(Compiler *comp)
 {
   Lexer *lex = comp->lex;
   HkChunk *chunk = &comp->fn->chunk;
-  compile_variable(comp, &lex->token, true);
+  int start = chunk->codeLength;
+  Variable var = compile_variable(comp, &lex->token, true);
   lexer_next_token(lex);
+  // Like any other call, a call without arguments ends the subscript.
+  if (var.function && match(lex, TOKEN_KIND_LPAREN)
+    && !compile_inline_call(comp, var.function, start))
+    return;
   for (;;)
   {
     if (match(lex, TOKEN_KIND_LBRACKET))
@@ -2230,14 +3125,27 @@ static Variable compile_variable(Compiler *comp, Token *tk, bool emit)
   {
     if (!emit)
       return *var;
+    if (var->literalLength)
+    {
+      for (int i = 0; i < var->literalLength; ++i)
+        hk_chunk_emit_byte(chunk, var->literal[i]);
+      return *var;
+    }
     hk_chunk_emit_opcode(chunk, var->isLocal ? HK_OP_GET_LOCAL : HK_OP_NONLOCAL);
     hk_chunk_emit_byte(chunk, var->index);
     return *var;
   }
+  // A captured constant is copied into this function instead, so closures
+  // capturing only constants need no non-locals and can be shared.
+  HkValue val;
+  var = lookup_captured_literal(comp->parent, tk, &val);
+  if (var && (!emit || emit_literal(comp, val)))
+    return *var;
   var = compile_nonlocal(comp->parent, tk);
   if (var)
   {
     uint8_t index = add_nonlocal(comp, tk);
+    comp->variables[comp->numVariables - 1].function = var->function;
     hk_chunk_emit_opcode(chunk, HK_OP_NONLOCAL);
     hk_chunk_emit_byte(chunk, index);
     return *var;
@@ -2293,6 +3201,7 @@ static Variable *compile_nonlocal(Compiler *comp, Token *tk)
   if (var)
   {
     uint8_t index = add_nonlocal(comp, tk);
+    comp->variables[comp->numVariables - 1].function = var->function;
     hk_chunk_emit_opcode(chunk, HK_OP_NONLOCAL);
     hk_chunk_emit_byte(chunk, index);
     return var;
@@ -2300,6 +3209,37 @@ static Variable *compile_nonlocal(Compiler *comp, Token *tk)
   return NULL;
 }
 
+static Variable *lookup_captured_literal(Compiler *comp, Token *tk, HkValue *val)
+{
+  if (!comp)
+    return NULL;
+  Variable *var = lookup_variable(comp, tk);
+  if (!var)
+    return lookup_captured_literal(comp->parent, tk, val);
+  if (!var->literalLength)
+    return NULL;
+  uint8_t *literal = var->literal;
+  switch (literal[0])
+  {
+  case HK_OP_NIL:
+    *val = hk_nil_value();
+    break;
+  case HK_OP_FALSE:
+    *val = hk_bool_value(false);
+    break;
+  case HK_OP_TRUE:
+    *val = hk_bool_value(true);
+    break;
+  case HK_OP_INT:
+    *val = hk_number_value(*((uint16_t *) &literal[1]));
+    break;
+  default:
+    *val = comp->fn->chunk.consts->elements[literal[1]];
+    break;
+  }
+  return var;
+}
+
 HkClosure *hk_compile(HkString *file, HkString *source, int flags)
 {
   Lexer lex;
@@ -2315,6 +3255,7 @@ HkClosure *hk_compile(HkString *file, HkString *source, int flags)
   fn->arity = 1;
   HkChunk *chunk = &fn->chunk;
   hk_chunk_emit_opcode(chunk, HK_OP_RETURN_NIL);
+  peephole_optimize(fn);
   HkClosure *cl = hk_closure_new(fn);
   lexer_deinit(&lex);
   return cl;
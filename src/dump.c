@@ -10,22 +10,6 @@
 
 #include "hook/dump.h"
 
-static inline int get_line(HkChunk *chunk, int offset);
-
-static inline int get_line(HkChunk *chunk, int offset)
-{
-  int result = 1;
-  HkLine *lines = chunk->lines;
-  for (int i = 0; i < chunk->linesLength; ++i)
-  {
-    HkLine *line = &lines[i];
-    if (line->offset > offset)
-      break;
-    result = line->no;
-  }
-  return result;
-}
-
 void hk_dump(HkFunction *fn, FILE *stream)
 {
   HkString *name = fn->name;
@@ -45,7 +29,7 @@ void hk_dump(HkFunction *fn, FILE *stream)
     HkOpCode op = (HkOpCode) code[i];
     int j = i++;
     ++n;
-    int line = get_line(chunk, j);
+    int line = hk_chunk_get_line(chunk, j + 1);
     if (line != last_line)
     {
       fprintf(stream, "  %-5d %5d ", line, j);
@@ -291,6 +275,171 @@ void hk_dump(HkFunction *fn, FILE *stream)
     case HK_OP_RETURN_NIL:
       fprintf(stream, "ReturnNil\n");
       break;
+    case HK_OP_GET_ELEMENT_ARRAY_INT:
+      fprintf(stream, "GetElementArrayInt\n");
+      break;
+    case HK_OP_GREATER_NUM_NUM:
+      fprintf(stream, "GreaterNumNum\n");
+      break;
+    case HK_OP_LESS_NUM_NUM:
+      fprintf(stream, "LessNumNum\n");
+      break;
+    case HK_OP_NOT_GREATER_NUM_NUM:
+      fprintf(stream, "NotGreaterNumNum\n");
+      break;
+    case HK_OP_NOT_LESS_NUM_NUM:
+      fprintf(stream, "NotLessNumNum\n");
+      break;
+    case HK_OP_ADD_NUM_NUM:
+      fprintf(stream, "AddNumNum\n");
+      break;
+    case HK_OP_SUBTRACT_NUM_NUM:
+      fprintf(stream, "SubtractNumNum\n");
+      break;
+    case HK_OP_MULTIPLY_NUM_NUM:
+      fprintf(stream, "MultiplyNumNum\n");
+      break;
+    case HK_OP_ADD_UNCHECKED:
+      fprintf(stream, "AddUnchecked\n");
+      break;
+    case HK_OP_SUBTRACT_UNCHECKED:
+      fprintf(stream, "SubtractUnchecked\n");
+      break;
+    case HK_OP_MULTIPLY_UNCHECKED:
+      fprintf(stream, "MultiplyUnchecked\n");
+      break;
+    case HK_OP_RETURN_ARRAY:
+      fprintf(stream, "ReturnArray           %5d\n", code[i++]);
+      break;
+    case HK_OP_CALL_UNPACK:
+      {
+        int numArgs = code[i++];
+        int numResults = code[i++];
+        fprintf(stream, "CallUnpack            %5d %5d\n", numArgs, numResults);
+      }
+      break;
+    case HK_OP_GET_LOCAL_LOCAL:
+      {
+        int index1 = code[i++];
+        int index2 = code[i++];
+        fprintf(stream, "GetLocalLocal         %5d %5d\n", index1, index2);
+      }
+      break;
+    case HK_OP_GET_LOCAL_INT:
+      {
+        int index = code[i++];
+        int data = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "GetLocalInt           %5d %5d\n", index, data);
+      }
+      break;
+    case HK_OP_INCREMENT_LOCAL:
+      fprintf(stream, "IncrementLocal        %5d\n", code[i++]);
+      break;
+    case HK_OP_DECREMENT_LOCAL:
+      fprintf(stream, "DecrementLocal        %5d\n", code[i++]);
+      break;
+    case HK_OP_JUMP_IF_NOT_LESS:
+      {
+        int offset = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "JumpIfNotLess         %5d\n", offset);
+      }
+      break;
+    case HK_OP_JUMP_IF_NOT_GREATER:
+      {
+        int offset = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "JumpIfNotGreater      %5d\n", offset);
+      }
+      break;
+    case HK_OP_JUMP_IF_LESS:
+      {
+        int offset = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "JumpIfLess            %5d\n", offset);
+      }
+      break;
+    case HK_OP_JUMP_IF_GREATER:
+      {
+        int offset = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "JumpIfGreater         %5d\n", offset);
+      }
+      break;
+    case HK_OP_CALL_POP:
+      fprintf(stream, "CallPop               %5d\n", code[i++]);
+      break;
+    case HK_OP_FOREACH_INIT:
+      fprintf(stream, "ForeachInit\n");
+      break;
+    case HK_OP_FOREACH_NEXT:
+      fprintf(stream, "ForeachNext\n");
+      break;
+    case HK_OP_FOREACH_CURRENT:
+      {
+        int offset = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "ForeachCurrent        %5d\n", offset);
+      }
+      break;
+    case HK_OP_FOR_LOOP:
+      {
+        int offset = *((uint16_t*) &code[i]);
+        i += 2;
+        int index = code[i++];
+        int cmp = code[i++];
+        int bound = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "ForLoop               %5d %5d %5d %5d\n", offset, index, cmp, bound);
+      }
+      break;
+    case HK_OP_FOR_LOOP_INT:
+      {
+        int offset = *((uint16_t*) &code[i]);
+        i += 2;
+        int index = code[i++];
+        int cmp = code[i++];
+        int bound = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "ForLoopInt            %5d %5d %5d %5d\n", offset, index, cmp, bound);
+      }
+      break;
+    case HK_OP_MATCH_INT:
+      {
+        int fallback = *((uint16_t*) &code[i]);
+        i += 2;
+        int min = *((uint16_t*) &code[i]);
+        i += 2;
+        int size = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "MatchInt              %5d %5d %5d\n", fallback, min, size);
+        for (int k = 0; k < size; ++k)
+        {
+          int target = *((uint16_t*) &code[i]);
+          i += 2;
+          fprintf(stream, "            ; %5d => %5d\n", min + k, target);
+        }
+      }
+      break;
+    case HK_OP_MATCH_STRING:
+      {
+        int fallback = *((uint16_t*) &code[i]);
+        i += 2;
+        int seed = *((uint16_t*) &code[i]);
+        i += 2;
+        int bits = code[i++];
+        fprintf(stream, "MatchString           %5d %5d %5d\n", fallback, seed, bits);
+        for (int k = 0; k < 1 << bits; ++k)
+        {
+          int index = code[i++];
+          int target = *((uint16_t*) &code[i]);
+          i += 2;
+          if (target != fallback)
+            fprintf(stream, "            ; %5d => %5d\n", index, target);
+        }
+      }
+      break;
     }
   }
   fprintf(stream, "; %d instruction(s)\n\n", n);
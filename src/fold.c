@@ -0,0 +1,163 @@
+//
+// fold.c
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "fold.h"
+#include <math.h>
+#include <stdint.h>
+#include "hook/string.h"
+
+static inline bool is_int64(double num);
+static inline bool number_value(double num, HkValue *result);
+static inline bool fold_numbers(HkOpCode op, double num1, double num2, HkValue *result);
+static inline bool fold_bitwise(HkOpCode op, double num1, double num2, HkValue *result);
+static inline bool fold_comparison(HkOpCode op, HkValue val1, HkValue val2,
+  HkValue *result);
+
+static inline bool is_int64(double num)
+{
+  return num >= -9223372036854775808.0 && num < 9223372036854775808.0;
+}
+
+static inline bool number_value(double num, HkValue *result)
+{
+  // Number constants are deduplicated with ==, which cannot tell -0 from 0.
+  if (num == 0 && signbit(num))
+    return false;
+  *result = hk_number_value(num);
+  return true;
+}
+
+static inline bool fold_numbers(HkOpCode op, double num1, double num2, HkValue *result)
+{
+  switch (op)
+  {
+  case HK_OP_ADD:
+    return number_value(num1 + num2, result);
+  case HK_OP_SUBTRACT:
+    return number_value(num1 - num2, result);
+  case HK_OP_MULTIPLY:
+    return number_value(num1 * num2, result);
+  case HK_OP_DIVIDE:
+    return number_value(num1 / num2, result);
+  case HK_OP_QUOTIENT:
+    return number_value(floor(num1 / num2), result);
+  case HK_OP_REMAINDER:
+    return number_value(fmod(num1, num2), result);
+  default:
+    break;
+  }
+  return fold_bitwise(op, num1, num2, result);
+}
+
+static inline bool fold_bitwise(HkOpCode op, double num1, double num2, HkValue *result)
+{
+  if (!is_int64(num1) || !is_int64(num2))
+    return false;
+  int64_t data1 = (int64_t) num1;
+  int64_t data2 = (int64_t) num2;
+  switch (op)
+  {
+  case HK_OP_BITWISE_OR:
+    return number_value((double) (data1 | data2), result);
+  case HK_OP_BITWISE_XOR:
+    return number_value((double) (data1 ^ data2), result);
+  case HK_OP_BITWISE_AND:
+    return number_value((double) (data1 & data2), result);
+  case HK_OP_LEFT_SHIFT:
+    if (data1 < 0 || data2 < 0 || data2 > 62 || data1 > (INT64_MAX >> data2))
+      return false;
+    return number_value((double) (data1 << data2), result);
+  case HK_OP_RIGHT_SHIFT:
+    if (data1 < 0 || data2 < 0 || data2 > 62)
+      return false;
+    return number_value((double) (data1 >> data2), result);
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline bool fold_comparison(HkOpCode op, HkValue val1, HkValue val2,
+  HkValue *result)
+{
+  if (op == HK_OP_EQUAL || op == HK_OP_NOT_EQUAL)
+  {
+    bool equal = hk_value_equal(val1, val2);
+    *result = hk_bool_value(op == HK_OP_EQUAL ? equal : !equal);
+    return true;
+  }
+  int cmp;
+  if (val1.type != val2.type || !hk_value_compare(val1, val2, &cmp))
+    return false;
+  switch (op)
+  {
+  case HK_OP_GREATER:
+    *result = hk_bool_value(cmp > 0);
+    return true;
+  case HK_OP_LESS:
+    *result = hk_bool_value(cmp < 0);
+    return true;
+  case HK_OP_NOT_GREATER:
+    *result = hk_bool_value(cmp <= 0);
+    return true;
+  case HK_OP_NOT_LESS:
+    *result = hk_bool_value(cmp >= 0);
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+bool fold_unary(HkOpCode op, HkValue val, HkValue *result)
+{
+  switch (op)
+  {
+  case HK_OP_NOT:
+    *result = hk_bool_value(hk_is_falsey(val));
+    return true;
+  case HK_OP_NEGATE:
+    return hk_is_number(val) && number_value(-hk_as_number(val), result);
+  case HK_OP_BITWISE_NOT:
+    if (!hk_is_number(val) || !is_int64(hk_as_number(val)))
+      return false;
+    return number_value((double) ~((int64_t) hk_as_number(val)), result);
+  default:
+    break;
+  }
+  return false;
+}
+
+bool fold_binary(HkOpCode op, HkValue val1, HkValue val2, HkValue *result)
+{
+  switch (op)
+  {
+  case HK_OP_EQUAL:
+  case HK_OP_NOT_EQUAL:
+  case HK_OP_GREATER:
+  case HK_OP_LESS:
+  case HK_OP_NOT_GREATER:
+  case HK_OP_NOT_LESS:
+    return fold_comparison(op, val1, val2, result);
+  case HK_OP_ADD:
+    if (hk_is_string(val1) && hk_is_string(val2))
+    {
+      HkString *str = hk_string_concat(hk_as_string(val1), hk_as_string(val2));
+      *result = hk_string_value(str);
+      return true;
+    }
+    break;
+  default:
+    break;
+  }
+  if (!hk_is_number(val1) || !hk_is_number(val2))
+    return false;
+  return fold_numbers(op, hk_as_number(val1), hk_as_number(val2), result);
+}
@@ -0,0 +1,19 @@
+//
+// fold.h
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "hook/chunk.h"
+
+bool fold_unary(HkOpCode op, HkValue val, HkValue *result);
+bool fold_binary(HkOpCode op, HkValue val1, HkValue val2, HkValue *result);
+
+#endif // FOLD_H
@@ -0,0 +1,597 @@
+//
+// image.c
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "hook/image.h"
+#include <string.h>
+#include "hook/memory.h"
+#include "module.h"
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#define IMAGE_MAGIC "HKIM"
+
+#define MIN_CAPACITY (1 << 8)
+
+#define align(n) (((n) + HK_IMAGE_ALIGNMENT - 1) & ~((size_t) HK_IMAGE_ALIGNMENT - 1))
+
+typedef enum
+{
+  SECTION_FUNCTIONS,
+  SECTION_STRINGS,
+  SECTION_CHARS,
+  SECTION_CONSTANTS,
+  SECTION_CODE,
+  SECTION_LINES,
+  SECTION_LINE_DATA,
+  SECTION_MODULES,
+  NUM_SECTIONS
+} Section;
+
+typedef struct
+{
+  uint32_t offset;
+  uint32_t length;
+} ImageSection;
+
+typedef struct
+{
+  char         magic[4];
+  uint32_t     version;
+  uint32_t     size;
+  uint32_t     numSections;
+  ImageSection sections[NUM_SECTIONS];
+} ImageHeader;
+
+typedef struct
+{
+  int32_t  arity;
+  int32_t  name;
+  int32_t  file;
+  uint32_t numNonlocals;
+  uint32_t code;
+  uint32_t codeLength;
+  uint32_t lines;
+  uint32_t linesLength;
+  uint32_t lineData;
+  uint32_t lineDataLength;
+  uint32_t consts;
+  uint32_t numConsts;
+  uint32_t functions;
+  uint32_t numFunctions;
+} ImageFunction;
+
+typedef struct
+{
+  uint32_t offset;
+  uint32_t length;
+  uint32_t hash;
+} ImageString;
+
+typedef struct
+{
+  uint32_t type;
+  uint32_t string;
+  double   number;
+} ImageConstant;
+
+typedef struct
+{
+  uint32_t name;
+  uint32_t function;
+} ImageModule;
+
+typedef struct
+{
+  int     capacity;
+  int     length;
+  uint8_t *data;
+} Buffer;
+
+typedef struct
+{
+  Buffer      sections[NUM_SECTIONS];
+  int         numStrings;
+  int         stringsCapacity;
+  HkString    **strings;
+} Writer;
+
+static inline void buffer_write(Buffer *buf, const void *data, int size);
+static inline void writer_init(Writer *writer);
+static inline void writer_deinit(Writer *writer);
+static inline int32_t add_string(Writer *writer, HkString *str);
+static inline bool add_function(Writer *writer, HkFunction *fn, uint32_t functions);
+static inline bool section_in_bounds(ImageHeader *header, size_t size);
+static inline void *section_at(uint8_t *data, ImageHeader *header, Section section,
+  size_t itemSize, uint32_t *count);
+static inline bool check_strings(ImageString *strings, uint32_t numStrings, char *chars,
+  uint32_t numChars);
+static inline bool check_constants(ImageConstant *consts, uint32_t numConsts,
+  uint32_t numStrings);
+static inline bool check_functions(ImageFunction *functions, uint32_t numFunctions,
+  uint32_t numStrings, uint32_t numConsts, uint32_t codeLength, uint32_t numLines,
+  uint32_t lineDataLength);
+static inline bool check_modules(ImageModule *modules, uint32_t numModules,
+  uint32_t numStrings, uint32_t numFunctions);
+static inline uint8_t *allocate_pages(size_t size);
+static inline HkFunction *load_image(HkVM *vm, uint8_t *data, size_t size,
+  HkMapping *mapping);
+
+static inline void buffer_write(Buffer *buf, const void *data, int size)
+{
+  int minCapacity = buf->length + size;
+  if (minCapacity > buf->capacity)
+  {
+    int capacity = buf->capacity ? buf->capacity : MIN_CAPACITY;
+    while (capacity < minCapacity)
+      capacity <<= 1;
+    buf->capacity = capacity;
+    buf->data = (uint8_t *) hk_reallocate(buf->data, capacity);
+  }
+  memcpy(&buf->data[buf->length], data, size);
+  buf->length += size;
+}
+
+static inline void writer_init(Writer *writer)
+{
+  memset(writer, 0, sizeof(*writer));
+}
+
+static inline void writer_deinit(Writer *writer)
+{
+  for (int i = 0; i < NUM_SECTIONS; ++i)
+    hk_free(writer->sections[i].data);
+  hk_free(writer->strings);
+}
+
+static inline int32_t add_string(Writer *writer, HkString *str)
+{
+  if (!str)
+    return -1;
+  for (int i = 0; i < writer->numStrings; ++i)
+    if (hk_string_equal(writer->strings[i], str))
+      return i;
+  if (writer->numStrings == writer->stringsCapacity)
+  {
+    int capacity = writer->stringsCapacity ? writer->stringsCapacity << 1 : MIN_CAPACITY;
+    writer->stringsCapacity = capacity;
+    writer->strings = (HkString **) hk_reallocate(writer->strings,
+      sizeof(*writer->strings) * capacity);
+  }
+  Buffer *chars = &writer->sections[SECTION_CHARS];
+  ImageString entry = {
+    .offset = (uint32_t) chars->length,
+    .length = (uint32_t) str->length,
+    .hash = hk_string_hash(str)
+  };
+  buffer_write(chars, str->chars, str->length + 1);
+  buffer_write(&writer->sections[SECTION_STRINGS], &entry, sizeof(entry));
+  writer->strings[writer->numStrings] = str;
+  return writer->numStrings++;
+}
+
+static inline bool add_function(Writer *writer, HkFunction *fn, uint32_t functions)
+{
+  HkChunk *chunk = &fn->chunk;
+  Buffer *sections = writer->sections;
+  HkArray *consts = chunk->consts;
+  HkLineTable *lines = &chunk->lines;
+  ImageFunction entry = {
+    .arity = fn->arity,
+    .name = add_string(writer, fn->name),
+    .file = add_string(writer, fn->file),
+    .numNonlocals = fn->numNonlocals,
+    .code = (uint32_t) sections[SECTION_CODE].length,
+    .codeLength = (uint32_t) chunk->codeLength,
+    .lines = (uint32_t) (sections[SECTION_LINES].length / sizeof(HkLineIndex)),
+    .linesLength = (uint32_t) lines->length,
+    .lineData = (uint32_t) sections[SECTION_LINE_DATA].length,
+    .lineDataLength = (uint32_t) lines->dataLength,
+    .consts = (uint32_t) (sections[SECTION_CONSTANTS].length / sizeof(ImageConstant)),
+    .numConsts = (uint32_t) consts->length,
+    .functions = functions,
+    .numFunctions = fn->functionsLength
+  };
+  for (int i = 0; i < consts->length; ++i)
+  {
+    HkValue val = consts->elements[i];
+    ImageConstant constant = { .type = val.type };
+    if (hk_is_number(val))
+      constant.number = hk_as_number(val);
+    else if (hk_is_string(val))
+      constant.string = (uint32_t) add_string(writer, hk_as_string(val));
+    else
+      return false;
+    buffer_write(&sections[SECTION_CONSTANTS], &constant, sizeof(constant));
+  }
+  buffer_write(&sections[SECTION_CODE], chunk->code, chunk->codeLength);
+  buffer_write(&sections[SECTION_LINES], lines->index,
+    (int) sizeof(*lines->index) * hk_line_table_index_length(lines->length));
+  buffer_write(&sections[SECTION_LINE_DATA], lines->data, lines->dataLength);
+  buffer_write(&sections[SECTION_FUNCTIONS], &entry, sizeof(entry));
+  return true;
+}
+
+static inline bool section_in_bounds(ImageHeader *header, size_t size)
+{
+  for (int i = 0; i < NUM_SECTIONS; ++i)
+  {
+    ImageSection *section = &header->sections[i];
+    if (section->offset % HK_IMAGE_ALIGNMENT || section->offset > size
+      || section->length > size - section->offset)
+      return false;
+  }
+  return true;
+}
+
+static inline void *section_at(uint8_t *data, ImageHeader *header, Section section,
+  size_t itemSize, uint32_t *count)
+{
+  ImageSection *entry = &header->sections[section];
+  *count = (uint32_t) (entry->length / itemSize);
+  return &data[entry->offset];
+}
+
+static inline bool check_strings(ImageString *strings, uint32_t numStrings, char *chars,
+  uint32_t numChars)
+{
+  for (uint32_t i = 0; i < numStrings; ++i)
+  {
+    ImageString *str = &strings[i];
+    if (str->offset >= numChars || str->length >= numChars - str->offset
+      || str->length > INT32_MAX - 1 || chars[str->offset + str->length])
+      return false;
+  }
+  return true;
+}
+
+static inline bool check_constants(ImageConstant *consts, uint32_t numConsts,
+  uint32_t numStrings)
+{
+  for (uint32_t i = 0; i < numConsts; ++i)
+  {
+    ImageConstant *constant = &consts[i];
+    if (constant->type == HK_TYPE_NUMBER)
+      continue;
+    if (constant->type != HK_TYPE_STRING || constant->string >= numStrings)
+      return false;
+  }
+  return true;
+}
+
+static inline bool check_functions(ImageFunction *functions, uint32_t numFunctions,
+  uint32_t numStrings, uint32_t numConsts, uint32_t codeLength, uint32_t numLines,
+  uint32_t lineDataLength)
+{
+  if (!numFunctions)
+    return false;
+  for (uint32_t i = 0; i < numFunctions; ++i)
+  {
+    ImageFunction *fn = &functions[i];
+    // Children always come after their parent, so the functions form a tree.
+    if ((fn->name != -1 && (fn->name < 0 || (uint32_t) fn->name >= numStrings))
+      || fn->file < 0 || (uint32_t) fn->file >= numStrings
+      || fn->numNonlocals > UINT8_MAX
+      || !fn->codeLength || fn->code > codeLength || fn->codeLength > codeLength - fn->code
+      || fn->linesLength > INT32_MAX - HK_LINE_INDEX_INTERVAL || fn->lines > numLines
+      || (uint32_t) hk_line_table_index_length((int) fn->linesLength) > numLines - fn->lines
+      || fn->lineData > lineDataLength || fn->lineDataLength > lineDataLength - fn->lineData
+      || fn->consts > numConsts || fn->numConsts > numConsts - fn->consts
+      || fn->numFunctions > UINT8_MAX || fn->functions <= i
+      || fn->functions > numFunctions || fn->numFunctions > numFunctions - fn->functions)
+      return false;
+  }
+  return true;
+}
+
+static inline bool check_modules(ImageModule *modules, uint32_t numModules,
+  uint32_t numStrings, uint32_t numFunctions)
+{
+  for (uint32_t i = 0; i < numModules; ++i)
+  {
+    ImageModule *mod = &modules[i];
+    if (mod->name >= numStrings || !mod->function || mod->function >= numFunctions)
+      return false;
+  }
+  return true;
+}
+
+static inline uint8_t *allocate_pages(size_t size)
+{
+#ifdef _WIN32
+  return (uint8_t *) hk_allocate(size);
+#else
+  void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return data == MAP_FAILED ? NULL : (uint8_t *) data;
+#endif
+}
+
+bool hk_image_save(HkFunction *fn, FILE *stream)
+{
+  return hk_image_save_bundle(fn, 0, NULL, NULL, stream);
+}
+
+bool hk_image_save_bundle(HkFunction *fn, int numModules, HkString **names,
+  HkFunction **modules, FILE *stream)
+{
+  Writer writer;
+  writer_init(&writer);
+  // Functions are laid out breadth-first, so the children of each function
+  // are stored next to each other. The main function comes first, followed by
+  // the main function of each bundled module.
+  int length = numModules + 1;
+  int capacity = MIN_CAPACITY;
+  while (capacity < length)
+    capacity <<= 1;
+  HkFunction **queue = (HkFunction **) hk_allocate(sizeof(*queue) * capacity);
+  queue[0] = fn;
+  for (int i = 0; i < numModules; ++i)
+  {
+    queue[i + 1] = modules[i];
+    ImageModule mod = {
+      .name = (uint32_t) add_string(&writer, names[i]),
+      .function = (uint32_t) (i + 1)
+    };
+    buffer_write(&writer.sections[SECTION_MODULES], &mod, sizeof(mod));
+  }
+  bool result = true;
+  for (int i = 0; i < length && result; ++i)
+  {
+    HkFunction *curr = queue[i];
+    result = add_function(&writer, curr, (uint32_t) length);
+    for (int j = 0; j < curr->functionsLength; ++j)
+    {
+      if (length == capacity)
+      {
+        capacity <<= 1;
+        queue = (HkFunction **) hk_reallocate(queue, sizeof(*queue) * capacity);
+      }
+      queue[length++] = curr->functions[j];
+    }
+  }
+  hk_free(queue);
+  if (!result)
+  {
+    writer_deinit(&writer);
+    return false;
+  }
+  ImageHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+  header.version = HK_BYTECODE_VERSION;
+  header.numSections = NUM_SECTIONS;
+  size_t offset = align(sizeof(header));
+  for (int i = 0; i < NUM_SECTIONS; ++i)
+  {
+    header.sections[i].offset = (uint32_t) offset;
+    header.sections[i].length = (uint32_t) writer.sections[i].length;
+    offset = align(offset + writer.sections[i].length);
+  }
+  header.size = (uint32_t) offset;
+  static const uint8_t padding[HK_IMAGE_ALIGNMENT] = { 0 };
+  (void) fwrite(&header, sizeof(header), 1, stream);
+  size_t position = sizeof(header);
+  for (int i = 0; i < NUM_SECTIONS; ++i)
+  {
+    (void) fwrite(padding, header.sections[i].offset - position, 1, stream);
+    Buffer *buf = &writer.sections[i];
+    if (buf->length)
+      (void) fwrite(buf->data, buf->length, 1, stream);
+    position = header.sections[i].offset + buf->length;
+  }
+  (void) fwrite(padding, header.size - position, 1, stream);
+  writer_deinit(&writer);
+  return !ferror(stream);
+}
+
+static inline HkFunction *load_image(HkVM *vm, uint8_t *data, size_t size,
+  HkMapping *mapping)
+{
+  if ((uintptr_t) data % HK_IMAGE_ALIGNMENT || size < sizeof(ImageHeader))
+    return NULL;
+  ImageHeader *header = (ImageHeader *) data;
+  if (memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic))
+    || header->version != HK_BYTECODE_VERSION || header->numSections != NUM_SECTIONS
+    || header->size > size || !section_in_bounds(header, header->size))
+    return NULL;
+  uint32_t numFunctions, numStrings, numChars, numConsts, codeLength, numLines, lineDataLength,
+    numModules;
+  ImageFunction *functions = (ImageFunction *) section_at(data, header, SECTION_FUNCTIONS,
+    sizeof(ImageFunction), &numFunctions);
+  ImageString *strings = (ImageString *) section_at(data, header, SECTION_STRINGS,
+    sizeof(ImageString), &numStrings);
+  char *chars = (char *) section_at(data, header, SECTION_CHARS, 1, &numChars);
+  ImageConstant *consts = (ImageConstant *) section_at(data, header, SECTION_CONSTANTS,
+    sizeof(ImageConstant), &numConsts);
+  uint8_t *code = (uint8_t *) section_at(data, header, SECTION_CODE, 1, &codeLength);
+  HkLineIndex *lines = (HkLineIndex *) section_at(data, header, SECTION_LINES,
+    sizeof(HkLineIndex), &numLines);
+  uint8_t *lineData = (uint8_t *) section_at(data, header, SECTION_LINE_DATA, 1,
+    &lineDataLength);
+  ImageModule *modules = (ImageModule *) section_at(data, header, SECTION_MODULES,
+    sizeof(ImageModule), &numModules);
+  if (!check_strings(strings, numStrings, chars, numChars)
+    || !check_constants(consts, numConsts, numStrings)
+    || !check_functions(functions, numFunctions, numStrings, numConsts, codeLength, numLines,
+      lineDataLength)
+    || !check_modules(modules, numModules, numStrings, numFunctions))
+    return NULL;
+  // Bundled modules are registered with the VM that runs the bundle.
+  if (numModules && !vm)
+    return NULL;
+  // The line tables are used in place too, once every one of them decodes.
+  HkLineTable *tables = (HkLineTable *) hk_allocate(sizeof(*tables) * numFunctions);
+  for (uint32_t i = 0; i < numFunctions; ++i)
+  {
+    ImageFunction *entry = &functions[i];
+    if (!hk_line_table_init_borrowed(&tables[i], (int) entry->linesLength,
+      &lines[entry->lines], (int) entry->lineDataLength, &lineData[entry->lineData]))
+    {
+      hk_free(tables);
+      return NULL;
+    }
+  }
+  // Each string is created once and shared by every constant and name that
+  // refers to it. Unlike the code, the characters are copied: a string with a
+  // single reference is grown in place, so it has to own its buffer.
+  HkString **table = (HkString **) hk_allocate(sizeof(*table) * (numStrings + 1));
+  for (uint32_t i = 0; i < numStrings; ++i)
+  {
+    ImageString *entry = &strings[i];
+    HkString *str = hk_string_from_chars((int) entry->length, &chars[entry->offset]);
+    str->hash = entry->hash;
+    hk_incr_ref(str);
+    table[i] = str;
+  }
+  HkFunction **fns = (HkFunction **) hk_allocate(sizeof(*fns) * numFunctions);
+  for (uint32_t i = numFunctions; i-- > 0; )
+  {
+    ImageFunction *entry = &functions[i];
+    HkArray *arr = hk_array_new_with_capacity((int) entry->numConsts);
+    for (uint32_t j = 0; j < entry->numConsts; ++j)
+    {
+      ImageConstant *constant = &consts[entry->consts + j];
+      HkValue val = constant->type == HK_TYPE_NUMBER ? hk_number_value(constant->number)
+        : hk_string_value(table[constant->string]);
+      hk_array_inplace_append_element(arr, val);
+    }
+    HkChunk chunk;
+    hk_chunk_init_borrowed(&chunk, &code[entry->code], (int) entry->codeLength, &tables[i],
+      arr, mapping);
+    HkString *name = entry->name == -1 ? NULL : table[entry->name];
+    HkFunction *fn = hk_function_new_with_chunk(entry->arity, name, table[entry->file],
+      &chunk);
+    fn->numNonlocals = (uint8_t) entry->numNonlocals;
+    for (uint32_t j = 0; j < entry->numFunctions; ++j)
+      hk_function_append_child(fn, fns[entry->functions + j]);
+    fns[i] = fn;
+  }
+  for (uint32_t i = 0; i < numModules; ++i)
+  {
+    ImageModule *mod = &modules[i];
+    module_bundle_put((ModuleState *) vm->modules, table[mod->name], fns[mod->function]);
+  }
+  HkFunction *result = fns[0];
+  hk_free(fns);
+  hk_free(tables);
+  for (uint32_t i = 0; i < numStrings; ++i)
+    hk_string_release(table[i]);
+  hk_free(table);
+  return result;
+}
+
+HkFunction *hk_image_load(HkVM *vm, uint8_t *data, size_t size)
+{
+  return load_image(vm, data, size, NULL);
+}
+
+HkFunction *hk_image_load_mapped(HkVM *vm, uint8_t *data, size_t size, size_t offset)
+{
+  // The functions share the mapping, so it goes away with the last of them.
+  HkMapping *mapping = (HkMapping *) hk_allocate(sizeof(*mapping));
+  mapping->refCount = 0;
+  mapping->data = data;
+  mapping->size = size;
+  HkFunction *fn = offset <= size ? load_image(vm, &data[offset], size - offset, mapping)
+    : NULL;
+  if (!fn)
+    hk_free(mapping);
+  return fn;
+}
+
+uint8_t *hk_image_map(const char *filename, size_t *size)
+{
+#ifdef _WIN32
+  FILE *stream = NULL;
+  (void) fopen_s(&stream, filename, "rb");
+  if (!stream)
+    return NULL;
+  long length = fseek(stream, 0, SEEK_END) ? -1 : ftell(stream);
+  if (length <= 0 || fseek(stream, 0, SEEK_SET))
+  {
+    (void) fclose(stream);
+    return NULL;
+  }
+  uint8_t *data = (uint8_t *) hk_allocate((size_t) length);
+  size_t n = fread(data, 1, (size_t) length, stream);
+  (void) fclose(stream);
+  if (n != (size_t) length)
+  {
+    hk_free(data);
+    return NULL;
+  }
+  *size = n;
+  return data;
+#else
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) || !st.st_size)
+  {
+    (void) close(fd);
+    return NULL;
+  }
+  // Private pages let the interpreter rewrite instructions in place without
+  // touching the file.
+  void *data = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  (void) close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+  *size = (size_t) st.st_size;
+  return (uint8_t *) data;
+#endif
+}
+
+void hk_image_unmap(uint8_t *data, size_t size)
+{
+#ifdef _WIN32
+  (void) size;
+  hk_free(data);
+#else
+  (void) munmap(data, size);
+#endif
+}
+
+HkFunction *hk_image_load_file(HkVM *vm, const char *filename)
+{
+  size_t size;
+  uint8_t *data = hk_image_map(filename, &size);
+  if (!data)
+    return NULL;
+  HkFunction *fn = hk_image_load_mapped(vm, data, size, 0);
+  if (!fn)
+    hk_image_unmap(data, size);
+  return fn;
+}
+
+HkFunction *hk_image_load_stream(HkVM *vm, FILE *stream)
+{
+  Buffer buf = { 0 };
+  uint8_t chunk[BUFSIZ];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), stream)) > 0)
+    buffer_write(&buf, chunk, (int) n);
+  size_t size = (size_t) buf.length;
+  uint8_t *data = size ? allocate_pages(size) : NULL;
+  if (data)
+    memcpy(data, buf.data, size);
+  hk_free(buf.data);
+  if (!data)
+    return NULL;
+  HkFunction *fn = hk_image_load_mapped(vm, data, size, 0);
+  if (!fn)
+    hk_image_unmap(data, size);
+  return fn;
+}
@@ -0,0 +1,1341 @@
+//
+// ir.c
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "ir.h"
+#include <string.h>
+#include "hook/memory.h"
+#include "peephole.h"
+
+#define MAX_SLOTS UINT8_MAX
+#define MAX_TEMPS 8
+#define UNKNOWN   -1
+
+typedef enum
+{
+  EMIT_NODE,
+  EMIT_NONE,
+  EMIT_LOCAL,
+  EMIT_TEMP,
+  EMIT_LITERAL
+} Emit;
+
+typedef struct
+{
+  HkOpCode op;
+  int      offset;
+  int      line;
+  int      arg;
+  int      pops;
+  int      pushes;
+  int      depth;
+  bool     feedback;
+  bool     proven;
+  bool     hoisted;
+  Emit     emit;
+  int      data;
+  int      extra;
+} Node;
+
+typedef struct
+{
+  int  op;
+  int  arg;
+  int  operand1;
+  int  operand2;
+  bool isNumber;
+} Value;
+
+typedef struct
+{
+  int     first;
+  int     end;
+  int     depth;
+  bool    *numbers;
+  bool    *loop;
+  bool    *written;
+  int     numHoisted;
+  int     starts[MAX_TEMPS];
+  int     roots[MAX_TEMPS];
+  int     temps[MAX_TEMPS];
+  int     offset;
+  int     preheader;
+} Block;
+
+typedef struct
+{
+  int from;
+  int to;
+  int delta;
+} Edge;
+
+typedef struct
+{
+  int position;
+  int from;
+  int to;
+} Fixup;
+
+typedef struct
+{
+  HkFunction *fn;
+  uint8_t    *code;
+  int        numNodes;
+  Node       *nodes;
+  int        *nodeAt;
+  int        *blockOf;
+  int        numBlocks;
+  Block      *blocks;
+  int        numEdges;
+  int        edgesCapacity;
+  Edge       *edges;
+  int        numValues;
+  int        valuesCapacity;
+  Value      *values;
+  int        maxDepth;
+  int        *stack;
+  int        *starts;
+  int        numTemps;
+  int        numFixups;
+  int        fixupsCapacity;
+  Fixup      *fixups;
+} Ir;
+
+static inline uint16_t read_word(uint8_t *code);
+static inline bool is_leaf(HkOpCode op);
+static inline bool is_pure(HkOpCode op);
+static inline bool is_terminal(HkOpCode op);
+static inline bool result_is_number(HkOpCode op, bool num1, bool num2);
+static inline void add_node(Ir *ir, HkOpCode op, int offset, int line, int arg, bool feedback);
+static bool lift(Ir *ir);
+static inline int jump_target(Ir *ir, int offset);
+static inline void add_edge(Ir *ir, int from, int to, int delta);
+static bool build_blocks(Ir *ir);
+static bool build_edges(Ir *ir);
+static bool compute_depths(Ir *ir);
+static inline int fresh_value(Ir *ir, bool isNumber);
+static inline int intern_value(Ir *ir, int op, int arg, int operand1, int operand2,
+  bool isNumber);
+static bool simulate(Ir *ir, int index, bool rewrite);
+static inline bool merge_numbers(Ir *ir, int index);
+static bool infer_numbers(Ir *ir);
+static void find_loops(Ir *ir);
+static inline void mark_written(Ir *ir, Block *header, Node *node);
+static inline bool try_hoist(Ir *ir, Block *block, int start, int root);
+static inline bool try_reuse(Ir *ir, int start, int root, int position);
+static inline int shift_slot(Ir *ir, int slot);
+static inline void emit_jump_word(Ir *ir, HkChunk *chunk, int from, int offset);
+static void emit_node(Ir *ir, HkChunk *chunk, int from, Node *node, bool raw);
+static HkChunk *lower(Ir *ir);
+static void ir_free(Ir *ir);
+
+static inline uint16_t read_word(uint8_t *code)
+{
+  return *((uint16_t *) code);
+}
+
+static inline bool is_leaf(HkOpCode op)
+{
+  switch (op)
+  {
+  case HK_OP_NIL:
+  case HK_OP_FALSE:
+  case HK_OP_TRUE:
+  case HK_OP_INT:
+  case HK_OP_CONSTANT:
+  case HK_OP_GLOBAL:
+  case HK_OP_NONLOCAL:
+  case HK_OP_GET_LOCAL:
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline bool is_pure(HkOpCode op)
+{
+  switch (op)
+  {
+  case HK_OP_EQUAL:
+  case HK_OP_GREATER:
+  case HK_OP_LESS:
+  case HK_OP_NOT_EQUAL:
+  case HK_OP_NOT_GREATER:
+  case HK_OP_NOT_LESS:
+  case HK_OP_BITWISE_OR:
+  case HK_OP_BITWISE_XOR:
+  case HK_OP_BITWISE_AND:
+  case HK_OP_LEFT_SHIFT:
+  case HK_OP_RIGHT_SHIFT:
+  case HK_OP_ADD:
+  case HK_OP_SUBTRACT:
+  case HK_OP_MULTIPLY:
+  case HK_OP_DIVIDE:
+  case HK_OP_QUOTIENT:
+  case HK_OP_REMAINDER:
+  case HK_OP_NEGATE:
+  case HK_OP_NOT:
+  case HK_OP_BITWISE_NOT:
+  case HK_OP_INCREMENT:
+  case HK_OP_DECREMENT:
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline bool is_terminal(HkOpCode op)
+{
+  switch (op)
+  {
+  case HK_OP_JUMP:
+  case HK_OP_JUMP_IF_FALSE:
+  case HK_OP_JUMP_IF_TRUE:
+  case HK_OP_JUMP_IF_TRUE_OR_POP:
+  case HK_OP_JUMP_IF_FALSE_OR_POP:
+  case HK_OP_JUMP_IF_NOT_EQUAL:
+  case HK_OP_JUMP_IF_NOT_VALID:
+  case HK_OP_FOREACH_CURRENT:
+  case HK_OP_FOR_LOOP:
+  case HK_OP_FOR_LOOP_INT:
+  case HK_OP_MATCH_INT:
+  case HK_OP_MATCH_STRING:
+  case HK_OP_RETURN:
+  case HK_OP_RETURN_NIL:
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline bool result_is_number(HkOpCode op, bool num1, bool num2)
+{
+  switch (op)
+  {
+  case HK_OP_ADD:
+  case HK_OP_SUBTRACT:
+    // Both also concatenate or diff arrays and strings.
+    return num1 && num2;
+  case HK_OP_BITWISE_OR:
+  case HK_OP_BITWISE_XOR:
+  case HK_OP_BITWISE_AND:
+  case HK_OP_LEFT_SHIFT:
+  case HK_OP_RIGHT_SHIFT:
+  case HK_OP_MULTIPLY:
+  case HK_OP_DIVIDE:
+  case HK_OP_QUOTIENT:
+  case HK_OP_REMAINDER:
+  case HK_OP_NEGATE:
+  case HK_OP_BITWISE_NOT:
+  case HK_OP_INCREMENT:
+  case HK_OP_DECREMENT:
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline void add_node(Ir *ir, HkOpCode op, int offset, int line, int arg, bool feedback)
+{
+  Node *node = &ir->nodes[ir->numNodes];
+  ++ir->numNodes;
+  node->op = op;
+  node->offset = offset;
+  node->line = line;
+  node->arg = arg;
+  node->pops = 0;
+  node->pushes = 0;
+  node->depth = UNKNOWN;
+  node->feedback = feedback;
+  node->proven = false;
+  node->hoisted = false;
+  node->emit = EMIT_NODE;
+  node->data = 0;
+  node->extra = 0;
+  if (is_leaf(op) || op == HK_OP_FOREACH_INIT)
+  {
+    node->pushes = 1;
+    return;
+  }
+  if (is_pure(op))
+  {
+    bool unary = op == HK_OP_NEGATE || op == HK_OP_NOT || op == HK_OP_BITWISE_NOT
+      || op == HK_OP_INCREMENT || op == HK_OP_DECREMENT;
+    node->pops = unary ? 1 : 2;
+    node->pushes = 1;
+    return;
+  }
+  switch (op)
+  {
+  case HK_OP_SET_LOCAL:
+  case HK_OP_POP:
+    node->pops = 1;
+    break;
+  case HK_OP_RANGE:
+  case HK_OP_GET_ELEMENT:
+    node->pops = 2;
+    node->pushes = 1;
+    break;
+  case HK_OP_ARRAY:
+    node->pops = arg;
+    node->pushes = 1;
+    break;
+  case HK_OP_CLOSURE:
+    node->pops = ir->fn->functions[arg]->numNonlocals;
+    node->pushes = 1;
+    break;
+  case HK_OP_GET_FIELD:
+    node->pops = 1;
+    node->pushes = 1;
+    break;
+  case HK_OP_CALL:
+    node->pops = arg + 1;
+    node->pushes = 1;
+    break;
+  default:
+    break;
+  }
+}
+
+static bool lift(Ir *ir)
+{
+  HkChunk *chunk = &ir->fn->chunk;
+  uint8_t *code = chunk->code;
+  int length = chunk->codeLength;
+  ir->nodes = (Node *) hk_allocate(sizeof(*ir->nodes) * 2 * length);
+  ir->nodeAt = (int *) hk_allocate(sizeof(*ir->nodeAt) * (length + 1));
+  for (int i = 0; i <= length; ++i)
+    ir->nodeAt[i] = UNKNOWN;
+  int i = 0;
+  while (i < length)
+  {
+    HkOpCode op = (HkOpCode) code[i];
+    int line = hk_chunk_get_line(chunk, i + 1);
+    ir->nodeAt[i] = ir->numNodes;
+    switch (op)
+    {
+    case HK_OP_NIL:
+    case HK_OP_FALSE:
+    case HK_OP_TRUE:
+    case HK_OP_RANGE:
+    case HK_OP_POP:
+    case HK_OP_GET_ELEMENT:
+    case HK_OP_EQUAL:
+    case HK_OP_GREATER:
+    case HK_OP_LESS:
+    case HK_OP_NOT_EQUAL:
+    case HK_OP_NOT_GREATER:
+    case HK_OP_NOT_LESS:
+    case HK_OP_BITWISE_OR:
+    case HK_OP_BITWISE_XOR:
+    case HK_OP_BITWISE_AND:
+    case HK_OP_LEFT_SHIFT:
+    case HK_OP_RIGHT_SHIFT:
+    case HK_OP_ADD:
+    case HK_OP_SUBTRACT:
+    case HK_OP_MULTIPLY:
+    case HK_OP_DIVIDE:
+    case HK_OP_QUOTIENT:
+    case HK_OP_REMAINDER:
+    case HK_OP_NEGATE:
+    case HK_OP_NOT:
+    case HK_OP_BITWISE_NOT:
+    case HK_OP_INCREMENT:
+    case HK_OP_DECREMENT:
+    case HK_OP_RETURN:
+    case HK_OP_RETURN_NIL:
+    case HK_OP_FOREACH_INIT:
+    case HK_OP_FOREACH_NEXT:
+      add_node(ir, op, i, line, 0, false);
+      i += 1;
+      break;
+    // Quickened opcodes are the type feedback collected by the baseline.
+    case HK_OP_GET_ELEMENT_ARRAY_INT:
+      add_node(ir, HK_OP_GET_ELEMENT, i, line, 0, true);
+      i += 1;
+      break;
+    case HK_OP_GREATER_NUM_NUM:
+      add_node(ir, HK_OP_GREATER, i, line, 0, true);
+      i += 1;
+      break;
+    case HK_OP_LESS_NUM_NUM:
+      add_node(ir, HK_OP_LESS, i, line, 0, true);
+      i += 1;
+      break;
+    case HK_OP_NOT_GREATER_NUM_NUM:
+      add_node(ir, HK_OP_NOT_GREATER, i, line, 0, true);
+      i += 1;
+      break;
+    case HK_OP_NOT_LESS_NUM_NUM:
+      add_node(ir, HK_OP_NOT_LESS, i, line, 0, true);
+      i += 1;
+      break;
+    case HK_OP_ADD_NUM_NUM:
+    case HK_OP_ADD_UNCHECKED:
+      add_node(ir, HK_OP_ADD, i, line, 0, true);
+      i += 1;
+      break;
+    case HK_OP_SUBTRACT_NUM_NUM:
+    case HK_OP_SUBTRACT_UNCHECKED:
+      add_node(ir, HK_OP_SUBTRACT, i, line, 0, true);
+      i += 1;
+      break;
+    case HK_OP_MULTIPLY_NUM_NUM:
+    case HK_OP_MULTIPLY_UNCHECKED:
+      add_node(ir, HK_OP_MULTIPLY, i, line, 0, true);
+      i += 1;
+      break;
+    case HK_OP_CONSTANT:
+    case HK_OP_ARRAY:
+    case HK_OP_CLOSURE:
+    case HK_OP_GLOBAL:
+    case HK_OP_NONLOCAL:
+    case HK_OP_GET_LOCAL:
+    case HK_OP_SET_LOCAL:
+    case HK_OP_GET_FIELD:
+    case HK_OP_CALL:
+    case HK_OP_INCREMENT_LOCAL:
+    case HK_OP_DECREMENT_LOCAL:
+      add_node(ir, op, i, line, code[i + 1], false);
+      i += 2;
+      break;
+    case HK_OP_CALL_POP:
+      add_node(ir, HK_OP_CALL, i, line, code[i + 1], false);
+      add_node(ir, HK_OP_POP, i, line, 0, false);
+      i += 2;
+      break;
+    case HK_OP_RETURN_ARRAY:
+      add_node(ir, HK_OP_ARRAY, i, line, code[i + 1], false);
+      add_node(ir, HK_OP_RETURN, i, line, 0, false);
+      i += 2;
+      break;
+    case HK_OP_INT:
+    case HK_OP_JUMP:
+    case HK_OP_JUMP_IF_FALSE:
+    case HK_OP_JUMP_IF_TRUE:
+    case HK_OP_JUMP_IF_TRUE_OR_POP:
+    case HK_OP_JUMP_IF_FALSE_OR_POP:
+    case HK_OP_JUMP_IF_NOT_EQUAL:
+    case HK_OP_JUMP_IF_NOT_VALID:
+    case HK_OP_FOREACH_CURRENT:
+      add_node(ir, op, i, line, read_word(&code[i + 1]), false);
+      i += 3;
+      break;
+    case HK_OP_GET_LOCAL_LOCAL:
+      add_node(ir, HK_OP_GET_LOCAL, i, line, code[i + 1], false);
+      add_node(ir, HK_OP_GET_LOCAL, i, line, code[i + 2], false);
+      i += 3;
+      break;
+    case HK_OP_GET_LOCAL_INT:
+      add_node(ir, HK_OP_GET_LOCAL, i, line, code[i + 1], false);
+      add_node(ir, HK_OP_INT, i, line, read_word(&code[i + 2]), false);
+      i += 4;
+      break;
+    case HK_OP_JUMP_IF_NOT_LESS:
+    case HK_OP_JUMP_IF_NOT_GREATER:
+    case HK_OP_JUMP_IF_LESS:
+    case HK_OP_JUMP_IF_GREATER:
+      {
+        HkOpCode cmp = op == HK_OP_JUMP_IF_NOT_LESS ? HK_OP_LESS
+          : op == HK_OP_JUMP_IF_NOT_GREATER ? HK_OP_GREATER
+          : op == HK_OP_JUMP_IF_LESS ? HK_OP_NOT_LESS : HK_OP_NOT_GREATER;
+        add_node(ir, cmp, i, line, 0, false);
+        add_node(ir, HK_OP_JUMP_IF_FALSE, i, line, read_word(&code[i + 1]), false);
+        i += 3;
+      }
+      break;
+    case HK_OP_FOR_LOOP:
+    case HK_OP_FOR_LOOP_INT:
+      add_node(ir, op, i, line, read_word(&code[i + 1]), false);
+      i += 7;
+      break;
+    case HK_OP_MATCH_INT:
+      add_node(ir, op, i, line, read_word(&code[i + 1]), false);
+      i += 7 + 2 * read_word(&code[i + 5]);
+      break;
+    case HK_OP_MATCH_STRING:
+      add_node(ir, op, i, line, read_word(&code[i + 1]), false);
+      i += 6 + 3 * (1 << code[i + 5]);
+      break;
+    default:
+      // Anything else keeps the function in the baseline tier.
+      return false;
+    }
+  }
+  return ir->numNodes > 0 && is_terminal(ir->nodes[ir->numNodes - 1].op);
+}
+
+static inline int jump_target(Ir *ir, int offset)
+{
+  if (offset < 0 || offset >= ir->fn->chunk.codeLength)
+    return UNKNOWN;
+  int index = ir->nodeAt[offset];
+  return index == UNKNOWN ? UNKNOWN : ir->blockOf[index];
+}
+
+static inline void add_edge(Ir *ir, int from, int to, int delta)
+{
+  if (ir->numEdges == ir->edgesCapacity)
+  {
+    int capacity = ir->edgesCapacity << 1;
+    ir->edgesCapacity = capacity;
+    ir->edges = (Edge *) hk_reallocate(ir->edges, sizeof(*ir->edges) * capacity);
+  }
+  Edge *edge = &ir->edges[ir->numEdges];
+  ++ir->numEdges;
+  edge->from = from;
+  edge->to = to;
+  edge->delta = delta;
+}
+
+static bool build_blocks(Ir *ir)
+{
+  int numNodes = ir->numNodes;
+  uint8_t *code = ir->fn->chunk.code;
+  bool *leaders = (bool *) hk_allocate(sizeof(*leaders) * (numNodes + 1));
+  memset(leaders, 0, sizeof(*leaders) * (numNodes + 1));
+  leaders[0] = true;
+  bool ok = true;
+  for (int i = 0; i < numNodes && ok; ++i)
+  {
+    Node *node = &ir->nodes[i];
+    if (!is_terminal(node->op))
+      continue;
+    leaders[i + 1] = true;
+    if (node->op == HK_OP_RETURN || node->op == HK_OP_RETURN_NIL)
+      continue;
+    int numTargets = 1;
+    if (node->op == HK_OP_MATCH_INT)
+      numTargets += read_word(&code[node->offset + 5]);
+    else if (node->op == HK_OP_MATCH_STRING)
+      numTargets += 1 << code[node->offset + 5];
+    for (int k = 0; k < numTargets; ++k)
+    {
+      int offset = !k ? node->arg
+        : node->op == HK_OP_MATCH_INT ? read_word(&code[node->offset + 7 + 2 * (k - 1)])
+        : read_word(&code[node->offset + 6 + 3 * (k - 1) + 1]);
+      int index = offset < ir->fn->chunk.codeLength ? ir->nodeAt[offset] : UNKNOWN;
+      if (index == UNKNOWN)
+      {
+        ok = false;
+        break;
+      }
+      leaders[index] = true;
+    }
+  }
+  if (!ok)
+  {
+    hk_free(leaders);
+    return false;
+  }
+  int numBlocks = 0;
+  for (int i = 0; i < numNodes; ++i)
+    numBlocks += leaders[i] ? 1 : 0;
+  ir->blocks = (Block *) hk_allocate(sizeof(*ir->blocks) * numBlocks);
+  ir->blockOf = (int *) hk_allocate(sizeof(*ir->blockOf) * numNodes);
+  ir->numBlocks = 0;
+  for (int i = 0; i < numNodes; ++i)
+  {
+    if (leaders[i])
+    {
+      Block *block = &ir->blocks[ir->numBlocks];
+      ++ir->numBlocks;
+      block->first = i;
+      block->depth = UNKNOWN;
+      block->numbers = NULL;
+      block->loop = NULL;
+      block->written = NULL;
+      block->numHoisted = 0;
+      block->offset = 0;
+      block->preheader = 0;
+    }
+    ir->blocks[ir->numBlocks - 1].end = i + 1;
+    ir->blockOf[i] = ir->numBlocks - 1;
+  }
+  hk_free(leaders);
+  return true;
+}
+
+static bool build_edges(Ir *ir)
+{
+  uint8_t *code = ir->fn->chunk.code;
+  ir->edgesCapacity = 8;
+  ir->edges = (Edge *) hk_allocate(sizeof(*ir->edges) * ir->edgesCapacity);
+  for (int i = 0; i < ir->numBlocks; ++i)
+  {
+    Block *block = &ir->blocks[i];
+    int delta = 0;
+    for (int j = block->first; j < block->end; ++j)
+    {
+      Node *node = &ir->nodes[j];
+      // The depth is relative to the block entry until the entry depths are known.
+      node->depth = delta;
+      delta += node->pushes - node->pops;
+    }
+    Node *last = &ir->nodes[block->end - 1];
+    int depth = last->depth;
+    switch (last->op)
+    {
+    case HK_OP_RETURN:
+    case HK_OP_RETURN_NIL:
+      break;
+    case HK_OP_JUMP:
+      add_edge(ir, i, jump_target(ir, last->arg), depth);
+      break;
+    case HK_OP_JUMP_IF_FALSE:
+    case HK_OP_JUMP_IF_TRUE:
+      add_edge(ir, i, jump_target(ir, last->arg), depth - 1);
+      add_edge(ir, i, i + 1, depth - 1);
+      break;
+    case HK_OP_JUMP_IF_TRUE_OR_POP:
+    case HK_OP_JUMP_IF_FALSE_OR_POP:
+      add_edge(ir, i, jump_target(ir, last->arg), depth);
+      add_edge(ir, i, i + 1, depth - 1);
+      break;
+    case HK_OP_JUMP_IF_NOT_EQUAL:
+      add_edge(ir, i, jump_target(ir, last->arg), depth - 1);
+      add_edge(ir, i, i + 1, depth - 2);
+      break;
+    case HK_OP_JUMP_IF_NOT_VALID:
+    case HK_OP_FOREACH_CURRENT:
+    case HK_OP_FOR_LOOP:
+    case HK_OP_FOR_LOOP_INT:
+      add_edge(ir, i, jump_target(ir, last->arg), depth);
+      add_edge(ir, i, i + 1, depth);
+      break;
+    case HK_OP_MATCH_INT:
+    case HK_OP_MATCH_STRING:
+      {
+        // A hit pops the subject, a miss leaves it for the default arm.
+        add_edge(ir, i, jump_target(ir, last->arg), depth);
+        bool isInt = last->op == HK_OP_MATCH_INT;
+        int size = isInt ? read_word(&code[last->offset + 5]) : 1 << code[last->offset + 5];
+        for (int k = 0; k < size; ++k)
+        {
+          int offset = isInt ? read_word(&code[last->offset + 7 + 2 * k])
+            : read_word(&code[last->offset + 6 + 3 * k + 1]);
+          if (offset != last->arg)
+            add_edge(ir, i, jump_target(ir, offset), depth - 1);
+        }
+      }
+      break;
+    default:
+      add_edge(ir, i, i + 1, delta);
+      break;
+    }
+  }
+  for (int i = 0; i < ir->numEdges; ++i)
+  {
+    Edge *edge = &ir->edges[i];
+    if (edge->to == UNKNOWN || edge->to >= ir->numBlocks)
+      return false;
+  }
+  return true;
+}
+
+static bool compute_depths(Ir *ir)
+{
+  ir->blocks[0].depth = ir->fn->arity + 1;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (int i = 0; i < ir->numEdges; ++i)
+    {
+      Edge *edge = &ir->edges[i];
+      int depth = ir->blocks[edge->from].depth;
+      if (depth == UNKNOWN)
+        continue;
+      Block *to = &ir->blocks[edge->to];
+      if (to->depth == UNKNOWN)
+      {
+        to->depth = depth + edge->delta;
+        changed = true;
+        continue;
+      }
+      if (to->depth != depth + edge->delta)
+        return false;
+    }
+  }
+  int maxDepth = 0;
+  for (int i = 0; i < ir->numBlocks; ++i)
+  {
+    Block *block = &ir->blocks[i];
+    if (block->depth == UNKNOWN)
+      continue;
+    for (int j = block->first; j < block->end; ++j)
+    {
+      Node *node = &ir->nodes[j];
+      node->depth += block->depth;
+      if (node->depth < node->pops)
+        return false;
+      int depth = node->depth + node->pushes;
+      maxDepth = depth > maxDepth ? depth : maxDepth;
+    }
+  }
+  ir->maxDepth = maxDepth;
+  ir->stack = (int *) hk_allocate(sizeof(*ir->stack) * (maxDepth + 1));
+  ir->starts = (int *) hk_allocate(sizeof(*ir->starts) * (maxDepth + 1));
+  return true;
+}
+
+static inline int fresh_value(Ir *ir, bool isNumber)
+{
+  if (ir->numValues == ir->valuesCapacity)
+  {
+    int capacity = ir->valuesCapacity << 1;
+    ir->valuesCapacity = capacity;
+    ir->values = (Value *) hk_reallocate(ir->values, sizeof(*ir->values) * capacity);
+  }
+  Value *val = &ir->values[ir->numValues];
+  val->op = UNKNOWN;
+  val->arg = 0;
+  val->operand1 = UNKNOWN;
+  val->operand2 = UNKNOWN;
+  val->isNumber = isNumber;
+  return ir->numValues++;
+}
+
+static inline int intern_value(Ir *ir, int op, int arg, int operand1, int operand2,
+  bool isNumber)
+{
+  for (int i = 0; i < ir->numValues; ++i)
+  {
+    Value *val = &ir->values[i];
+    if (val->op == op && val->arg == arg && val->operand1 == operand1
+      && val->operand2 == operand2)
+      return i;
+  }
+  int index = fresh_value(ir, isNumber);
+  Value *val = &ir->values[index];
+  val->op = op;
+  val->arg = arg;
+  val->operand1 = operand1;
+  val->operand2 = operand2;
+  return index;
+}
+
+static bool simulate(Ir *ir, int index, bool rewrite)
+{
+  Block *block = &ir->blocks[index];
+  HkValue *consts = ir->fn->chunk.consts->elements;
+  int *stack = ir->stack;
+  int *starts = ir->starts;
+  ir->numValues = 0;
+  for (int i = 0; i < block->depth; ++i)
+  {
+    stack[i] = fresh_value(ir, block->numbers[i]);
+    starts[i] = UNKNOWN;
+  }
+  for (int i = block->first; i < block->end; ++i)
+  {
+    Node *node = &ir->nodes[i];
+    int depth = node->depth;
+    HkOpCode op = node->op;
+    switch (op)
+    {
+    case HK_OP_NIL:
+    case HK_OP_FALSE:
+    case HK_OP_TRUE:
+    case HK_OP_INT:
+    case HK_OP_CONSTANT:
+    case HK_OP_GLOBAL:
+    case HK_OP_NONLOCAL:
+      {
+        bool isNumber = op == HK_OP_INT
+          || (op == HK_OP_CONSTANT && hk_is_number(consts[node->arg]));
+        stack[depth] = intern_value(ir, op, node->arg, UNKNOWN, UNKNOWN, isNumber);
+        starts[depth] = i;
+      }
+      break;
+    case HK_OP_GET_LOCAL:
+      {
+        if (node->arg >= depth)
+          return false;
+        int val = stack[node->arg];
+        stack[depth] = val;
+        starts[depth] = i;
+        int valOp = ir->values[val].op;
+        if (rewrite && (valOp == HK_OP_NIL || valOp == HK_OP_FALSE || valOp == HK_OP_TRUE
+          || valOp == HK_OP_INT))
+        {
+          node->emit = EMIT_LITERAL;
+          node->data = valOp;
+          node->extra = ir->values[val].arg;
+        }
+      }
+      break;
+    case HK_OP_SET_LOCAL:
+      if (node->arg >= depth - 1)
+        return false;
+      stack[node->arg] = stack[depth - 1];
+      break;
+    case HK_OP_INCREMENT_LOCAL:
+    case HK_OP_DECREMENT_LOCAL:
+      if (node->arg >= depth)
+        return false;
+      stack[node->arg] = fresh_value(ir, true);
+      break;
+    case HK_OP_FOR_LOOP:
+    case HK_OP_FOR_LOOP_INT:
+      {
+        int slot = ir->code[node->offset + 3];
+        if (slot >= depth)
+          return false;
+        stack[slot] = fresh_value(ir, true);
+      }
+      break;
+    case HK_OP_FOREACH_INIT:
+      stack[depth - 1] = fresh_value(ir, false);
+      stack[depth] = fresh_value(ir, false);
+      starts[depth] = UNKNOWN;
+      break;
+    case HK_OP_FOREACH_NEXT:
+      stack[depth - 1] = fresh_value(ir, false);
+      stack[depth - 2] = fresh_value(ir, false);
+      break;
+    case HK_OP_FOREACH_CURRENT:
+      stack[depth - 3] = fresh_value(ir, false);
+      break;
+    default:
+      {
+        int position = depth - node->pops;
+        if (!is_pure(op))
+        {
+          for (int k = 0; k < node->pushes; ++k)
+          {
+            stack[position + k] = fresh_value(ir, false);
+            starts[position + k] = UNKNOWN;
+          }
+          break;
+        }
+        int operand1 = stack[position];
+        int operand2 = node->pops == 2 ? stack[position + 1] : UNKNOWN;
+        bool num1 = ir->values[operand1].isNumber;
+        bool num2 = operand2 == UNKNOWN || ir->values[operand2].isNumber;
+        int val = intern_value(ir, op, 0, operand1, operand2,
+          result_is_number(op, num1, num2));
+        int start = starts[position];
+        stack[position] = val;
+        starts[position] = start;
+        if (!rewrite)
+          break;
+        node->proven = num1 && num2;
+        if (start == UNKNOWN)
+          break;
+        if (block->loop && try_hoist(ir, block, start, i))
+          break;
+        try_reuse(ir, start, i, position);
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+static inline bool merge_numbers(Ir *ir, int index)
+{
+  bool changed = false;
+  for (int i = 0; i < ir->numEdges; ++i)
+  {
+    Edge *edge = &ir->edges[i];
+    if (edge->from != index)
+      continue;
+    Block *to = &ir->blocks[edge->to];
+    if (!to->numbers)
+    {
+      to->numbers = (bool *) hk_allocate(sizeof(*to->numbers) * (to->depth + 1));
+      for (int j = 0; j < to->depth; ++j)
+        to->numbers[j] = ir->values[ir->stack[j]].isNumber;
+      changed = true;
+      continue;
+    }
+    for (int j = 0; j < to->depth; ++j)
+    {
+      if (!to->numbers[j] || ir->values[ir->stack[j]].isNumber)
+        continue;
+      to->numbers[j] = false;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+static bool infer_numbers(Ir *ir)
+{
+  Block *entry = &ir->blocks[0];
+  entry->numbers = (bool *) hk_allocate(sizeof(*entry->numbers) * (entry->depth + 1));
+  memset(entry->numbers, 0, sizeof(*entry->numbers) * (entry->depth + 1));
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (int i = 0; i < ir->numBlocks; ++i)
+    {
+      Block *block = &ir->blocks[i];
+      if (!block->numbers)
+        continue;
+      if (!simulate(ir, i, false))
+        return false;
+      changed = merge_numbers(ir, i) || changed;
+    }
+  }
+  return true;
+}
+
+static void find_loops(Ir *ir)
+{
+  int numBlocks = ir->numBlocks;
+  int *worklist = (int *) hk_allocate(sizeof(*worklist) * numBlocks);
+  for (int i = 0; i < ir->numEdges; ++i)
+  {
+    Edge *edge = &ir->edges[i];
+    Block *header = &ir->blocks[edge->to];
+    if (edge->to > edge->from || header->depth == UNKNOWN
+      || ir->blocks[edge->from].depth == UNKNOWN)
+      continue;
+    if (!header->loop)
+    {
+      header->loop = (bool *) hk_allocate(sizeof(*header->loop) * numBlocks);
+      memset(header->loop, 0, sizeof(*header->loop) * numBlocks);
+      header->loop[edge->to] = true;
+    }
+    bool *loop = header->loop;
+    int n = 0;
+    if (!loop[edge->from])
+    {
+      loop[edge->from] = true;
+      worklist[n++] = edge->from;
+    }
+    while (n)
+    {
+      int index = worklist[--n];
+      for (int j = 0; j < ir->numEdges; ++j)
+      {
+        Edge *pred = &ir->edges[j];
+        if (pred->to != index || loop[pred->from]
+          || ir->blocks[pred->from].depth == UNKNOWN)
+          continue;
+        loop[pred->from] = true;
+        worklist[n++] = pred->from;
+      }
+    }
+  }
+  hk_free(worklist);
+  for (int i = 0; i < numBlocks; ++i)
+  {
+    Block *header = &ir->blocks[i];
+    bool *loop = header->loop;
+    if (!loop)
+      continue;
+    // Only loops entered through their header get a preheader, and the block
+    // laid out before the header must not fall through from inside the loop.
+    bool ok = !i || !loop[i - 1];
+    for (int j = 0; j < ir->numEdges && ok; ++j)
+    {
+      Edge *edge = &ir->edges[j];
+      if (edge->to != i && loop[edge->to] && !loop[edge->from]
+        && ir->blocks[edge->from].depth != UNKNOWN)
+        ok = false;
+    }
+    if (!ok)
+    {
+      hk_free(loop);
+      header->loop = NULL;
+      continue;
+    }
+    header->written = (bool *) hk_allocate(sizeof(*header->written) * (ir->maxDepth + 1));
+    memset(header->written, 0, sizeof(*header->written) * (ir->maxDepth + 1));
+    for (int j = 0; j < numBlocks; ++j)
+    {
+      if (!loop[j])
+        continue;
+      Block *block = &ir->blocks[j];
+      for (int k = block->first; k < block->end; ++k)
+        mark_written(ir, header, &ir->nodes[k]);
+    }
+  }
+}
+
+static inline void mark_written(Ir *ir, Block *header, Node *node)
+{
+  bool *written = header->written;
+  int depth = node->depth;
+  switch (node->op)
+  {
+  case HK_OP_SET_LOCAL:
+  case HK_OP_INCREMENT_LOCAL:
+  case HK_OP_DECREMENT_LOCAL:
+    written[node->arg] = true;
+    return;
+  case HK_OP_FOR_LOOP:
+  case HK_OP_FOR_LOOP_INT:
+    written[ir->code[node->offset + 3]] = true;
+    return;
+  case HK_OP_FOREACH_INIT:
+    written[depth - 1] = true;
+    break;
+  case HK_OP_FOREACH_NEXT:
+    written[depth - 1] = true;
+    written[depth - 2] = true;
+    return;
+  case HK_OP_FOREACH_CURRENT:
+    written[depth - 3] = true;
+    return;
+  default:
+    break;
+  }
+  for (int i = 0; i < node->pushes; ++i)
+    written[depth - node->pops + i] = true;
+}
+
+static inline bool try_hoist(Ir *ir, Block *block, int start, int root)
+{
+  // The header runs first in every iteration, so an invariant expression
+  // preceded only by loads can be evaluated once before entering the loop.
+  for (int i = block->first; i < start; ++i)
+  {
+    Node *node = &ir->nodes[i];
+    if (!node->hoisted && !is_leaf(node->op))
+      return false;
+  }
+  for (int i = start; i <= root; ++i)
+  {
+    Node *node = &ir->nodes[i];
+    if (is_pure(node->op))
+      continue;
+    if (!is_leaf(node->op))
+      return false;
+    if (node->op == HK_OP_GET_LOCAL
+      && (node->arg >= block->depth || block->written[node->arg]))
+      return false;
+  }
+  // A larger invariant expression replaces the ones nested in it.
+  int n = 0;
+  for (int i = 0; i < block->numHoisted; ++i)
+    n += block->roots[i] < start ? 1 : 0;
+  if (ir->numTemps - (block->numHoisted - n) == MAX_TEMPS)
+    return false;
+  ir->numTemps -= block->numHoisted - n;
+  n = 0;
+  for (int i = 0; i < block->numHoisted; ++i)
+  {
+    if (block->roots[i] >= start)
+      continue;
+    block->starts[n] = block->starts[i];
+    block->roots[n] = block->roots[i];
+    ++n;
+  }
+  block->numHoisted = n;
+  block->starts[n] = start;
+  block->roots[n] = root;
+  ++block->numHoisted;
+  ++ir->numTemps;
+  for (int i = start; i <= root; ++i)
+    ir->nodes[i].hoisted = true;
+  return true;
+}
+
+static inline bool try_reuse(Ir *ir, int start, int root, int position)
+{
+  // A pure expression whose value number already lives in a frame slot is
+  // replaced by a load of that slot.
+  for (int i = start; i <= root; ++i)
+  {
+    Node *node = &ir->nodes[i];
+    if (node->hoisted || (!is_leaf(node->op) && !is_pure(node->op)))
+      return false;
+  }
+  int val = ir->stack[position];
+  for (int i = 0; i < position; ++i)
+  {
+    if (ir->stack[i] != val)
+      continue;
+    for (int j = start; j < root; ++j)
+      ir->nodes[j].emit = EMIT_NONE;
+    Node *node = &ir->nodes[root];
+    node->emit = EMIT_LOCAL;
+    node->data = i;
+    return true;
+  }
+  return false;
+}
+
+static inline int shift_slot(Ir *ir, int slot)
+{
+  return slot > ir->fn->arity ? slot + ir->numTemps : slot;
+}
+
+static inline void emit_jump_word(Ir *ir, HkChunk *chunk, int from, int offset)
+{
+  if (ir->numFixups == ir->fixupsCapacity)
+  {
+    int capacity = ir->fixupsCapacity << 1;
+    ir->fixupsCapacity = capacity;
+    ir->fixups = (Fixup *) hk_reallocate(ir->fixups, sizeof(*ir->fixups) * capacity);
+  }
+  Fixup *fixup = &ir->fixups[ir->numFixups];
+  ++ir->numFixups;
+  fixup->position = chunk->codeLength;
+  fixup->from = from;
+  fixup->to = jump_target(ir, offset);
+  hk_chunk_emit_word(chunk, 0);
+}
+
+static void emit_node(Ir *ir, HkChunk *chunk, int from, Node *node, bool raw)
+{
+  uint8_t *code = &ir->code[node->offset];
+  HkOpCode op = node->op;
+  Emit emit = raw ? EMIT_NODE : node->emit;
+  switch (emit)
+  {
+  case EMIT_NONE:
+    return;
+  case EMIT_LOCAL:
+    hk_chunk_emit_opcode(chunk, HK_OP_GET_LOCAL);
+    hk_chunk_emit_byte(chunk, (uint8_t) shift_slot(ir, node->data));
+    return;
+  case EMIT_TEMP:
+    hk_chunk_emit_opcode(chunk, HK_OP_GET_LOCAL);
+    hk_chunk_emit_byte(chunk, (uint8_t) node->data);
+    return;
+  case EMIT_LITERAL:
+    hk_chunk_emit_opcode(chunk, (HkOpCode) node->data);
+    if (node->data == HK_OP_INT)
+      hk_chunk_emit_word(chunk, (uint16_t) node->extra);
+    return;
+  case EMIT_NODE:
+    break;
+  }
+  switch (op)
+  {
+  case HK_OP_CONSTANT:
+  case HK_OP_ARRAY:
+  case HK_OP_CLOSURE:
+  case HK_OP_GLOBAL:
+  case HK_OP_NONLOCAL:
+  case HK_OP_GET_FIELD:
+  case HK_OP_CALL:
+    hk_chunk_emit_opcode(chunk, op);
+    hk_chunk_emit_byte(chunk, (uint8_t) node->arg);
+    return;
+  case HK_OP_GET_LOCAL:
+  case HK_OP_SET_LOCAL:
+  case HK_OP_INCREMENT_LOCAL:
+  case HK_OP_DECREMENT_LOCAL:
+    hk_chunk_emit_opcode(chunk, op);
+    hk_chunk_emit_byte(chunk, (uint8_t) shift_slot(ir, node->arg));
+    return;
+  case HK_OP_INT:
+    hk_chunk_emit_opcode(chunk, op);
+    hk_chunk_emit_word(chunk, (uint16_t) node->arg);
+    return;
+  case HK_OP_JUMP:
+  case HK_OP_JUMP_IF_FALSE:
+  case HK_OP_JUMP_IF_TRUE:
+  case HK_OP_JUMP_IF_TRUE_OR_POP:
+  case HK_OP_JUMP_IF_FALSE_OR_POP:
+  case HK_OP_JUMP_IF_NOT_EQUAL:
+  case HK_OP_JUMP_IF_NOT_VALID:
+  case HK_OP_FOREACH_CURRENT:
+    hk_chunk_emit_opcode(chunk, op);
+    emit_jump_word(ir, chunk, from, node->arg);
+    return;
+  case HK_OP_FOR_LOOP:
+  case HK_OP_FOR_LOOP_INT:
+    {
+      hk_chunk_emit_opcode(chunk, op);
+      emit_jump_word(ir, chunk, from, node->arg);
+      hk_chunk_emit_byte(chunk, (uint8_t) shift_slot(ir, code[3]));
+      hk_chunk_emit_byte(chunk, code[4]);
+      int bound = read_word(&code[5]);
+      hk_chunk_emit_word(chunk, (uint16_t) (op == HK_OP_FOR_LOOP ? shift_slot(ir, bound) : bound));
+    }
+    return;
+  case HK_OP_MATCH_INT:
+    {
+      hk_chunk_emit_opcode(chunk, op);
+      emit_jump_word(ir, chunk, from, node->arg);
+      hk_chunk_emit_word(chunk, read_word(&code[3]));
+      int size = read_word(&code[5]);
+      hk_chunk_emit_word(chunk, (uint16_t) size);
+      for (int i = 0; i < size; ++i)
+        emit_jump_word(ir, chunk, from, read_word(&code[7 + 2 * i]));
+    }
+    return;
+  case HK_OP_MATCH_STRING:
+    {
+      hk_chunk_emit_opcode(chunk, op);
+      emit_jump_word(ir, chunk, from, node->arg);
+      hk_chunk_emit_word(chunk, read_word(&code[3]));
+      int bits = code[5];
+      hk_chunk_emit_byte(chunk, (uint8_t) bits);
+      for (int i = 0; i < (1 << bits); ++i)
+      {
+        uint8_t *entry = &code[6 + 3 * i];
+        hk_chunk_emit_byte(chunk, entry[0]);
+        emit_jump_word(ir, chunk, from, read_word(&entry[1]));
+      }
+    }
+    return;
+  case HK_OP_ADD:
+    hk_chunk_emit_opcode(chunk, node->proven ? HK_OP_ADD_UNCHECKED
+      : node->feedback ? HK_OP_ADD_NUM_NUM : op);
+    return;
+  case HK_OP_SUBTRACT:
+    hk_chunk_emit_opcode(chunk, node->proven ? HK_OP_SUBTRACT_UNCHECKED
+      : node->feedback ? HK_OP_SUBTRACT_NUM_NUM : op);
+    return;
+  case HK_OP_MULTIPLY:
+    hk_chunk_emit_opcode(chunk, node->proven ? HK_OP_MULTIPLY_UNCHECKED
+      : node->feedback ? HK_OP_MULTIPLY_NUM_NUM : op);
+    return;
+  case HK_OP_GET_ELEMENT:
+    hk_chunk_emit_opcode(chunk, node->feedback ? HK_OP_GET_ELEMENT_ARRAY_INT : op);
+    return;
+  default:
+    break;
+  }
+  hk_chunk_emit_opcode(chunk, op);
+}
+
+static HkChunk *lower(Ir *ir)
+{
+  HkFunction *fn = ir->fn;
+  Node *nodes = ir->nodes;
+  int numTemps = ir->numTemps;
+  if (ir->maxDepth + numTemps > MAX_SLOTS)
+    numTemps = 0;
+  ir->numTemps = numTemps;
+  int temp = fn->arity + 1;
+  for (int i = 0; i < ir->numBlocks; ++i)
+  {
+    Block *block = &ir->blocks[i];
+    if (!numTemps)
+      block->numHoisted = 0;
+    for (int j = 0; j < block->numHoisted; ++j)
+    {
+      block->temps[j] = temp++;
+      for (int k = block->starts[j]; k < block->roots[j]; ++k)
+        nodes[k].emit = EMIT_NONE;
+      Node *root = &nodes[block->roots[j]];
+      root->emit = EMIT_TEMP;
+      root->data = block->temps[j];
+    }
+  }
+  HkChunk *chunk = (HkChunk *) hk_allocate(sizeof(*chunk));
+  hk_chunk_init(chunk);
+  hk_array_free(chunk->consts);
+  chunk->consts = fn->chunk.consts;
+  ir->fixupsCapacity = 8;
+  ir->fixups = (Fixup *) hk_allocate(sizeof(*ir->fixups) * ir->fixupsCapacity);
+  int line = nodes[0].line;
+  hk_chunk_append_line(chunk, line);
+  for (int i = 0; i < numTemps; ++i)
+    hk_chunk_emit_opcode(chunk, HK_OP_NIL);
+  for (int i = 0; i < ir->numBlocks; ++i)
+  {
+    Block *block = &ir->blocks[i];
+    if (block->depth == UNKNOWN)
+      continue;
+    block->preheader = chunk->codeLength;
+    for (int j = 0; j < block->numHoisted; ++j)
+    {
+      for (int k = block->starts[j]; k <= block->roots[j]; ++k)
+      {
+        Node *node = &nodes[k];
+        if (node->line != line)
+        {
+          line = node->line;
+          hk_chunk_append_line(chunk, line);
+        }
+        emit_node(ir, chunk, i, node, true);
+      }
+      hk_chunk_emit_opcode(chunk, HK_OP_SET_LOCAL);
+      hk_chunk_emit_byte(chunk, (uint8_t) block->temps[j]);
+    }
+    block->offset = chunk->codeLength;
+    for (int j = block->first; j < block->end; ++j)
+    {
+      Node *node = &nodes[j];
+      if (node->emit != EMIT_NONE && node->line != line)
+      {
+        line = node->line;
+        hk_chunk_append_line(chunk, line);
+      }
+      emit_node(ir, chunk, i, node, false);
+    }
+  }
+  for (int i = 0; i < ir->numFixups; ++i)
+  {
+    Fixup *fixup = &ir->fixups[i];
+    Block *to = &ir->blocks[fixup->to];
+    bool fromOutside = to->numHoisted && !to->loop[fixup->from];
+    uint16_t offset = (uint16_t) (fromOutside ? to->preheader : to->offset);
+    *((uint16_t *) &chunk->code[fixup->position]) = offset;
+  }
+  peephole_optimize_chunk(chunk);
+  return chunk;
+}
+
+static void ir_free(Ir *ir)
+{
+  for (int i = 0; i < ir->numBlocks; ++i)
+  {
+    Block *block = &ir->blocks[i];
+    hk_free(block->numbers);
+    hk_free(block->loop);
+    hk_free(block->written);
+  }
+  hk_free(ir->nodes);
+  hk_free(ir->nodeAt);
+  hk_free(ir->blockOf);
+  hk_free(ir->blocks);
+  hk_free(ir->edges);
+  hk_free(ir->values);
+  hk_free(ir->stack);
+  hk_free(ir->starts);
+  hk_free(ir->fixups);
+}
+
+void ir_optimize(HkFunction *fn)
+{
+  // Functions the tier cannot handle keep running the baseline bytecode.
+  fn->optimized = &fn->chunk;
+  Ir ir;
+  memset(&ir, 0, sizeof(ir));
+  ir.fn = fn;
+  ir.code = fn->chunk.code;
+  ir.valuesCapacity = 16;
+  ir.values = (Value *) hk_allocate(sizeof(*ir.values) * ir.valuesCapacity);
+  if (!lift(&ir) || !build_blocks(&ir) || !build_edges(&ir) || !compute_depths(&ir)
+    || !infer_numbers(&ir))
+  {
+    ir_free(&ir);
+    return;
+  }
+  find_loops(&ir);
+  for (int i = 0; i < ir.numBlocks; ++i)
+  {
+    if (ir.blocks[i].depth == UNKNOWN)
+      continue;
+    if (!simulate(&ir, i, true))
+    {
+      ir_free(&ir);
+      return;
+    }
+  }
+  fn->optimized = lower(&ir);
+  ir_free(&ir);
+}
+
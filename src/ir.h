@@ -0,0 +1,20 @@
+//
+// ir.h
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef IR_H
+#define IR_H
+
+#include "hook/callable.h"
+
+#define IR_HOT_THRESHOLD 1000
+
+void ir_optimize(HkFunction *fn);
+
+#endif // IR_H
@@ -0,0 +1,519 @@
+//
+// jit.c
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "jit.h"
+
+#include <string.h>
+#include "hook/memory.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+  #include <sys/mman.h>
+#endif
+
+static JitCode unavailable = { NULL, NULL, NULL, 0, NULL };
+
+static inline uint16_t read_word(uint8_t *code);
+
+static inline uint16_t read_word(uint8_t *code)
+{
+  return *((uint16_t *) code);
+}
+
+bool jit_decode(uint8_t *code, JitInstruction *ins)
+{
+  ins->kind = JIT_KIND_CALL;
+  ins->length = 1;
+  ins->numArgs = 0;
+  ins->target = -1;
+  switch (code[0])
+  {
+  case HK_OP_NIL:
+  case HK_OP_FALSE:
+  case HK_OP_TRUE:
+  case HK_OP_RANGE:
+  case HK_OP_ITERATOR:
+  case HK_OP_POP:
+  case HK_OP_APPEND_ELEMENT:
+  case HK_OP_GET_ELEMENT:
+  case HK_OP_FETCH_ELEMENT:
+  case HK_OP_SET_ELEMENT:
+  case HK_OP_PUT_ELEMENT:
+  case HK_OP_DELETE_ELEMENT:
+  case HK_OP_INPLACE_APPEND_ELEMENT:
+  case HK_OP_INPLACE_PUT_ELEMENT:
+  case HK_OP_INPLACE_DELETE_ELEMENT:
+  case HK_OP_SET_FIELD:
+  case HK_OP_CURRENT:
+  case HK_OP_NEXT:
+  case HK_OP_EQUAL:
+  case HK_OP_GREATER:
+  case HK_OP_LESS:
+  case HK_OP_NOT_EQUAL:
+  case HK_OP_NOT_GREATER:
+  case HK_OP_NOT_LESS:
+  case HK_OP_BITWISE_OR:
+  case HK_OP_BITWISE_XOR:
+  case HK_OP_BITWISE_AND:
+  case HK_OP_LEFT_SHIFT:
+  case HK_OP_RIGHT_SHIFT:
+  case HK_OP_ADD:
+  case HK_OP_SUBTRACT:
+  case HK_OP_MULTIPLY:
+  case HK_OP_DIVIDE:
+  case HK_OP_QUOTIENT:
+  case HK_OP_REMAINDER:
+  case HK_OP_NEGATE:
+  case HK_OP_NOT:
+  case HK_OP_BITWISE_NOT:
+  case HK_OP_INCREMENT:
+  case HK_OP_DECREMENT:
+  case HK_OP_LOAD_MODULE:
+  case HK_OP_GET_ELEMENT_ARRAY_INT:
+  case HK_OP_GREATER_NUM_NUM:
+  case HK_OP_LESS_NUM_NUM:
+  case HK_OP_NOT_GREATER_NUM_NUM:
+  case HK_OP_NOT_LESS_NUM_NUM:
+  case HK_OP_ADD_NUM_NUM:
+  case HK_OP_SUBTRACT_NUM_NUM:
+  case HK_OP_MULTIPLY_NUM_NUM:
+  case HK_OP_FOREACH_INIT:
+  case HK_OP_FOREACH_NEXT:
+  case HK_OP_ADD_UNCHECKED:
+  case HK_OP_SUBTRACT_UNCHECKED:
+  case HK_OP_MULTIPLY_UNCHECKED:
+    break;
+  case HK_OP_CONSTANT:
+  case HK_OP_ARRAY:
+  case HK_OP_STRUCT:
+  case HK_OP_INSTANCE:
+  case HK_OP_CONSTRUCT:
+  case HK_OP_CLOSURE:
+  case HK_OP_UNPACK_ARRAY:
+  case HK_OP_UNPACK_STRUCT:
+  case HK_OP_GLOBAL:
+  case HK_OP_NONLOCAL:
+  case HK_OP_GET_LOCAL:
+  case HK_OP_SET_LOCAL:
+  case HK_OP_GET_FIELD:
+  case HK_OP_FETCH_FIELD:
+  case HK_OP_PUT_FIELD:
+  case HK_OP_INPLACE_PUT_FIELD:
+  case HK_OP_CALL:
+  case HK_OP_INCREMENT_LOCAL:
+  case HK_OP_DECREMENT_LOCAL:
+  case HK_OP_CALL_POP:
+    ins->length = 2;
+    ins->numArgs = 1;
+    ins->args[0] = code[1];
+    break;
+  case HK_OP_CALL_UNPACK:
+    ins->length = 3;
+    ins->numArgs = 2;
+    ins->args[0] = code[1];
+    ins->args[1] = code[2];
+    break;
+  case HK_OP_INT:
+    ins->length = 3;
+    ins->numArgs = 1;
+    ins->args[0] = read_word(&code[1]);
+    break;
+  case HK_OP_GET_LOCAL_LOCAL:
+    ins->length = 3;
+    ins->numArgs = 2;
+    ins->args[0] = code[1];
+    ins->args[1] = code[2];
+    break;
+  case HK_OP_GET_LOCAL_INT:
+    ins->length = 4;
+    ins->numArgs = 2;
+    ins->args[0] = code[1];
+    ins->args[1] = read_word(&code[2]);
+    break;
+  case HK_OP_JUMP:
+    ins->kind = JIT_KIND_JUMP;
+    ins->length = 3;
+    ins->target = read_word(&code[1]);
+    break;
+  case HK_OP_JUMP_IF_FALSE:
+  case HK_OP_JUMP_IF_TRUE:
+  case HK_OP_JUMP_IF_TRUE_OR_POP:
+  case HK_OP_JUMP_IF_FALSE_OR_POP:
+  case HK_OP_JUMP_IF_NOT_EQUAL:
+  case HK_OP_JUMP_IF_NOT_VALID:
+  case HK_OP_JUMP_IF_NOT_LESS:
+  case HK_OP_JUMP_IF_NOT_GREATER:
+  case HK_OP_JUMP_IF_LESS:
+  case HK_OP_JUMP_IF_GREATER:
+  case HK_OP_FOREACH_CURRENT:
+    ins->kind = JIT_KIND_BRANCH;
+    ins->length = 3;
+    ins->target = read_word(&code[1]);
+    break;
+  case HK_OP_FOR_LOOP:
+  case HK_OP_FOR_LOOP_INT:
+    ins->kind = JIT_KIND_BRANCH;
+    ins->length = 7;
+    ins->numArgs = 3;
+    ins->target = read_word(&code[1]);
+    ins->args[0] = code[3];
+    ins->args[1] = code[4];
+    ins->args[2] = read_word(&code[5]);
+    break;
+  case HK_OP_MATCH_INT:
+    ins->kind = JIT_KIND_SWITCH;
+    ins->length = 7 + 2 * read_word(&code[5]);
+    break;
+  case HK_OP_MATCH_STRING:
+    ins->kind = JIT_KIND_SWITCH;
+    ins->length = 6 + 3 * (1 << code[5]);
+    break;
+  case HK_OP_RETURN:
+    ins->kind = JIT_KIND_RETURN;
+    break;
+  case HK_OP_RETURN_NIL:
+    ins->kind = JIT_KIND_CALL_RETURN;
+    break;
+  case HK_OP_RETURN_ARRAY:
+    ins->kind = JIT_KIND_CALL_RETURN;
+    ins->length = 2;
+    ins->numArgs = 1;
+    ins->args[0] = code[1];
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+#if defined(__x86_64__) && defined(__linux__)
+
+
+//
+// Each instruction is translated by copying a fixed machine-code stencil and
+// patching its holes: operands, the address of the runtime helper that
+// implements the opcode, and the rel32 displacements of jumps. The frame
+// pointer lives in rbx for the whole function, and helpers report through
+// their return value whether to fall through, jump, or leave with an error.
+//
+
+typedef struct
+{
+  int position;
+  int target;
+} Fixup;
+
+typedef struct
+{
+  int     length;
+  int     capacity;
+  uint8_t *bytes;
+} Buffer;
+
+typedef struct
+{
+  Buffer buf;
+  int    *labels;
+  int    numJumps;
+  int    jumpsCapacity;
+  Fixup  *jumps;
+  int    numErrors;
+  int    errorsCapacity;
+  Fixup  *errors;
+  int    numSwitches;
+  int    switchesCapacity;
+  int    *switches;
+} Jit;
+
+static const uint8_t prologue[] = {
+  0x53,                                     // push rbx
+  0x48, 0x89, 0xfb                          // mov rbx, rdi
+};
+
+static const uint8_t epilogue[] = {
+  0x5b,                                     // pop rbx
+  0xc3                                      // ret
+};
+
+static const uint8_t loadArgs[][5] = {
+  { 0xbe, 0x00, 0x00, 0x00, 0x00 },         // mov esi, imm32
+  { 0xba, 0x00, 0x00, 0x00, 0x00 },         // mov edx, imm32
+  { 0xb9, 0x00, 0x00, 0x00, 0x00 }          // mov ecx, imm32
+};
+
+static const uint8_t callHelper[] = {
+  0x48, 0x89, 0xdf,                         // mov rdi, rbx
+  0x48, 0xb8, 0x00, 0x00, 0x00, 0x00,       // mov rax, imm64
+  0x00, 0x00, 0x00, 0x00,
+  0xff, 0xd0                                // call rax
+};
+
+static const uint8_t checkError[] = {
+  0x85, 0xc0,                               // test eax, eax
+  0x0f, 0x85, 0x00, 0x00, 0x00, 0x00        // jnz rel32
+};
+
+static const uint8_t checkBranch[] = {
+  0x83, 0xf8, 0x01,                         // cmp eax, 1
+  0x0f, 0x84, 0x00, 0x00, 0x00, 0x00,       // je rel32
+  0x0f, 0x87, 0x00, 0x00, 0x00, 0x00        // ja rel32
+};
+
+static const uint8_t jump[] = {
+  0xe9, 0x00, 0x00, 0x00, 0x00              // jmp rel32
+};
+
+static const uint8_t dispatch[] = {
+  0x89, 0xc0,                               // mov eax, eax
+  0x48, 0xb9, 0x00, 0x00, 0x00, 0x00,       // mov rcx, imm64
+  0x00, 0x00, 0x00, 0x00,
+  0xff, 0x24, 0xc1                          // jmp [rcx + rax * 8]
+};
+
+static const uint8_t leave[] = {
+  0xb8, 0x00, 0x00, 0x00, 0x00,             // mov eax, imm32
+  0xe9, 0x00, 0x00, 0x00, 0x00              // jmp rel32
+};
+
+static inline void add_fixup(Fixup **fixups, int *length, int *capacity, int position,
+  int target);
+static inline int emit(Buffer *buf, const uint8_t *stencil, int length);
+static inline void patch32(Buffer *buf, int position, int32_t data);
+static inline void patch64(Buffer *buf, int position, uint64_t data);
+static inline void emit_call(Buffer *buf, JitHelper helper);
+static inline void emit_return(Jit *jit);
+static bool translate(Jit *jit, HkChunk *chunk, JitHelper helpers[]);
+static void jit_deinit(Jit *jit);
+
+static inline void add_fixup(Fixup **fixups, int *length, int *capacity, int position,
+  int target)
+{
+  if (*length == *capacity)
+  {
+    *capacity = *capacity ? *capacity << 1 : 16;
+    *fixups = (Fixup *) hk_reallocate(*fixups, sizeof(**fixups) * *capacity);
+  }
+  (*fixups)[*length] = (Fixup) { .position = position, .target = target };
+  ++(*length);
+}
+
+static inline int emit(Buffer *buf, const uint8_t *stencil, int length)
+{
+  if (buf->length + length > buf->capacity)
+  {
+    int capacity = buf->capacity ? buf->capacity : 256;
+    while (buf->length + length > capacity)
+      capacity <<= 1;
+    buf->bytes = (uint8_t *) hk_reallocate(buf->bytes, capacity);
+    buf->capacity = capacity;
+  }
+  int position = buf->length;
+  memcpy(&buf->bytes[position], stencil, length);
+  buf->length += length;
+  return position;
+}
+
+static inline void patch32(Buffer *buf, int position, int32_t data)
+{
+  memcpy(&buf->bytes[position], &data, sizeof(data));
+}
+
+static inline void patch64(Buffer *buf, int position, uint64_t data)
+{
+  memcpy(&buf->bytes[position], &data, sizeof(data));
+}
+
+static inline void emit_call(Buffer *buf, JitHelper helper)
+{
+  int position = emit(buf, callHelper, sizeof(callHelper));
+  patch64(buf, position + 5, (uint64_t) (uintptr_t) helper);
+}
+
+static inline void emit_return(Jit *jit)
+{
+  Buffer *buf = &jit->buf;
+  int position = emit(buf, leave, sizeof(leave));
+  patch32(buf, position + 1, -1);
+  add_fixup(&jit->errors, &jit->numErrors, &jit->errorsCapacity, position + 6, -1);
+}
+
+static bool translate(Jit *jit, HkChunk *chunk, JitHelper helpers[])
+{
+  Buffer *buf = &jit->buf;
+  uint8_t *code = chunk->code;
+  int length = chunk->codeLength;
+  emit(buf, prologue, sizeof(prologue));
+  int offset = 0;
+  while (offset < length)
+  {
+    JitInstruction ins;
+    if (!jit_decode(&code[offset], &ins))
+      return false;
+    jit->labels[offset] = buf->length;
+    int end = offset + ins.length;
+    JitHelper helper = helpers[code[offset]];
+    switch (ins.kind)
+    {
+    case JIT_KIND_CALL:
+    case JIT_KIND_BRANCH:
+    case JIT_KIND_CALL_RETURN:
+      for (int i = 0; i < ins.numArgs; ++i)
+      {
+        int position = emit(buf, loadArgs[i], sizeof(loadArgs[i]));
+        patch32(buf, position + 1, ins.args[i]);
+      }
+      emit_call(buf, helper);
+      if (ins.kind == JIT_KIND_BRANCH)
+      {
+        int position = emit(buf, checkBranch, sizeof(checkBranch));
+        add_fixup(&jit->jumps, &jit->numJumps, &jit->jumpsCapacity, position + 5,
+          ins.target);
+        add_fixup(&jit->errors, &jit->numErrors, &jit->errorsCapacity, position + 11, end);
+        break;
+      }
+      {
+        int position = emit(buf, checkError, sizeof(checkError));
+        add_fixup(&jit->errors, &jit->numErrors, &jit->errorsCapacity, position + 4, end);
+      }
+      if (ins.kind == JIT_KIND_CALL_RETURN)
+        emit_return(jit);
+      break;
+    case JIT_KIND_RETURN:
+      emit_return(jit);
+      break;
+    case JIT_KIND_JUMP:
+      {
+        int position = emit(buf, jump, sizeof(jump));
+        add_fixup(&jit->jumps, &jit->numJumps, &jit->jumpsCapacity, position + 1,
+          ins.target);
+      }
+      break;
+    case JIT_KIND_SWITCH:
+      {
+        int position = emit(buf, loadArgs[0], sizeof(loadArgs[0]));
+        patch32(buf, position + 1, offset);
+        emit_call(buf, helper);
+        position = emit(buf, dispatch, sizeof(dispatch));
+        if (jit->numSwitches == jit->switchesCapacity)
+        {
+          jit->switchesCapacity = jit->switchesCapacity ? jit->switchesCapacity << 1 : 4;
+          jit->switches = (int *) hk_reallocate(jit->switches,
+            sizeof(*jit->switches) * jit->switchesCapacity);
+        }
+        jit->switches[jit->numSwitches++] = position + 4;
+      }
+      break;
+    }
+    offset = end;
+  }
+  // The compiler always ends a function with a return.
+  int exitAt = emit(buf, epilogue, sizeof(epilogue));
+  for (int i = 0; i < jit->numJumps; ++i)
+  {
+    Fixup *fixup = &jit->jumps[i];
+    int position = fixup->position;
+    patch32(buf, position, jit->labels[fixup->target] - (position + 4));
+  }
+  // Every error site gets its own exit stub that reports where it stopped, so
+  // the caller can map it back to a line.
+  for (int i = 0; i < jit->numErrors; ++i)
+  {
+    Fixup *fixup = &jit->errors[i];
+    int position = fixup->position;
+    if (fixup->target == -1)
+    {
+      patch32(buf, position, exitAt - (position + 4));
+      continue;
+    }
+    int stub = emit(buf, leave, sizeof(leave));
+    patch32(buf, stub + 1, fixup->target);
+    patch32(buf, stub + 6, exitAt - (stub + 10));
+    patch32(buf, position, stub - (position + 4));
+  }
+  return true;
+}
+
+static void jit_deinit(Jit *jit)
+{
+  hk_free(jit->buf.bytes);
+  hk_free(jit->labels);
+  hk_free(jit->jumps);
+  hk_free(jit->errors);
+  hk_free(jit->switches);
+}
+
+JitCode *jit_compile(HkChunk *chunk, JitHelper helpers[])
+{
+  Jit jit;
+  memset(&jit, 0, sizeof(jit));
+  jit.labels = (int *) hk_allocate(sizeof(*jit.labels) * (chunk->codeLength + 1));
+  memset(jit.labels, 0, sizeof(*jit.labels) * (chunk->codeLength + 1));
+  if (!translate(&jit, chunk, helpers))
+  {
+    jit_deinit(&jit);
+    return &unavailable;
+  }
+  size_t size = (size_t) jit.buf.length;
+  void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+  {
+    jit_deinit(&jit);
+    return &unavailable;
+  }
+  void **targets = NULL;
+  if (jit.numSwitches)
+  {
+    // Jump tables are indexed by bytecode offset, as returned by the helpers.
+    targets = (void **) hk_allocate(sizeof(*targets) * chunk->codeLength);
+    for (int i = 0; i < chunk->codeLength; ++i)
+      targets[i] = (uint8_t *) base + jit.labels[i];
+    for (int i = 0; i < jit.numSwitches; ++i)
+      patch64(&jit.buf, jit.switches[i], (uint64_t) (uintptr_t) targets);
+  }
+  memcpy(base, jit.buf.bytes, size);
+  jit_deinit(&jit);
+  if (mprotect(base, size, PROT_READ | PROT_EXEC))
+  {
+    munmap(base, size);
+    hk_free(targets);
+    return &unavailable;
+  }
+  JitCode *code = (JitCode *) hk_allocate(sizeof(*code));
+  *((void **) &code->entry) = base;
+  code->chunk = chunk;
+  code->base = base;
+  code->size = size;
+  code->targets = targets;
+  return code;
+}
+
+#else
+
+JitCode *jit_compile(HkChunk *chunk, JitHelper helpers[])
+{
+  (void) chunk;
+  (void) helpers;
+  return &unavailable;
+}
+
+#endif
+
+void jit_free(JitCode *code)
+{
+  // The placeholder for functions that cannot be compiled has no entry, and
+  // may belong to another copy of the runtime.
+  if (!code->entry)
+    return;
+#if defined(__x86_64__) && defined(__linux__)
+  if (code->base)
+    munmap(code->base, code->size);
+#endif
+  hk_free(code->targets);
+  hk_free(code);
+}
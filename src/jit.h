@@ -0,0 +1,74 @@
+//
+// jit.h
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "hook/vm.h"
+#include "ir.h"
+
+#ifndef JIT_HOT_THRESHOLD
+  #define JIT_HOT_THRESHOLD IR_HOT_THRESHOLD
+#endif
+
+#define JIT_NEXT  0
+#define JIT_JUMP  1
+#define JIT_ERROR 2
+
+typedef enum
+{
+  JIT_KIND_CALL,
+  JIT_KIND_BRANCH,
+  JIT_KIND_JUMP,
+  JIT_KIND_SWITCH,
+  JIT_KIND_RETURN,
+  JIT_KIND_CALL_RETURN
+} JitKind;
+
+typedef struct
+{
+  JitKind kind;
+  int     length;
+  int     numArgs;
+  int     args[3];
+  int     target;
+} JitInstruction;
+
+typedef struct
+{
+  HkVM       *vm;
+  HkValue    *locals;
+  HkValue    *nonlocals;
+  HkValue    *consts;
+  HkFunction *fn;
+  uint8_t    *code;
+  int        numResults;
+  bool       unpacked;
+} JitFrame;
+
+typedef void (*JitHelper)(void);
+
+typedef int (*JitEntry)(void *frame);
+
+typedef struct
+{
+  JitEntry entry;
+  HkChunk  *chunk;
+  void     *base;
+  size_t   size;
+  void     **targets;
+} JitCode;
+
+bool jit_decode(uint8_t *code, JitInstruction *ins);
+JitCode *jit_compile(HkChunk *chunk, JitHelper helpers[]);
+JitHelper *jit_helpers(void);
+void jit_free(JitCode *code);
+
+#endif // JIT_H
@@ -11,8 +11,11 @@
 #include "module.h"
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "hook/compiler.h"
+#include "hook/memory.h"
 #include "hook/utils.h"
+#include "cache.h"
 #include "record.h"
 
 #ifdef _WIN32
@@ -21,8 +24,10 @@
 #endif
 
 #ifndef _WIN32
+  #include <dirent.h>
   #include <dlfcn.h>
   #include <limits.h>
+  #include <sys/stat.h>
   #include <unistd.h>
 #endif
 
@@ -50,6 +55,8 @@
 #define SRC_EXT  ".hk"
 #define SRC_MAIN "main"
 
+#define LISTING_MIN_AGE 2
+
 #ifdef _WIN32
   #define LIB_EXT ".dll"
 #elif __linux__
@@ -64,29 +71,46 @@
   #define PATH_MAX MAX_PATH
 #endif
 
+typedef struct
+{
+  const char *kind;
+  double     resolveTime;
+} ImportTrace;
+
 #ifdef _WIN32
   typedef void (__stdcall *LoadModuleHandler)(HkVM *);
 #else
   typedef void (*LoadModuleHandler)(HkVM *);
 #endif
 
-static Record moduleCache;
-static HkString *envPath = NULL;
-
 static inline void get_home_dir(char *path);
 static inline void get_default_home_dir(char *path);
-static inline HkString *get_env_path(void);
+static inline HkString *get_env_path(ModuleState *state);
 static inline HkString *get_default_env_path(void);
-static inline HkString *path_match(HkString *path, HkString *name, HkString *currFile);
+static inline HkString *path_match(ModuleState *state, HkString *path, HkString *name,
+  HkString *currFile);
+static inline HkString *resolve_module(ModuleState *state, HkString *name, HkString *currFile);
+static inline bool probe_file(ModuleState *state, HkString *file);
+#if !defined(_WIN32) && !defined(__APPLE__)
+static inline void list_dir(ModuleState *state, HkString *prefix, double mtime);
+#endif
+static inline void record_lazy_put(Record *rec, HkString *key, HkValue value);
+static inline void record_lazy_deinit(Record *rec);
+static inline double now(void);
 static inline bool is_relative(char *filename);
 static inline HkString *get_module_file(HkString *relFile, HkString *currFile);
-static inline void load_module(HkVM *vm, HkString *name, HkString *currFile);
+static inline void load_module(HkVM *vm, HkString *name, HkString *currFile,
+  ImportTrace *trace);
+static inline void trace_import(ModuleState *state, HkString *name, ImportTrace *trace,
+  double start);
 static inline bool is_source_module(char *filename);
 static inline void load_source_module(HkVM *vm, HkString *file, HkString *name);
+static inline HkClosure *compile_source_module(HkString *file, HkString *source);
+static inline void run_source_module(HkVM *vm, HkClosure *cl, HkString *name);
 static inline void load_native_module(HkVM *vm, HkString *file, HkString *name);
 static inline HkString *load_source_from_file(const char *filename);
-static inline bool module_cache_get(HkString *name, HkValue *module);
-static inline void module_cache_put(HkString *name, HkValue module);
+static inline bool module_cache_get(ModuleState *state, HkString *name, HkValue *module);
+static inline void module_cache_put(ModuleState *state, HkString *name, HkValue module);
 
 static inline void get_home_dir(char *path)
 {
@@ -112,14 +136,14 @@ static inline void get_default_home_dir(char *path)
 #endif
 }
 
-static inline HkString *get_env_path(void)
+static inline HkString *get_env_path(ModuleState *state)
 {
-  if (!envPath)
+  if (!state->envPath)
   {
     const char *path = getenv(PATH_ENV_VAR);
-    envPath = path ? hk_string_from_chars(-1, path) : get_default_env_path();
+    state->envPath = path ? hk_string_from_chars(-1, path) : get_default_env_path();
   }
-  return envPath;
+  return state->envPath;
 }
 
 static inline HkString *get_default_env_path(void)
@@ -147,7 +171,8 @@ static inline HkString *get_default_env_path(void)
   return path;
 }
 
-static inline HkString *path_match(HkString *path, HkString *name, HkString *currFile)
+static inline HkString *path_match(ModuleState *state, HkString *path, HkString *name,
+  HkString *currFile)
 {
   HkString *sep = hk_string_from_chars(-1, PATH_SEP);
   HkArray *patterns = hk_string_split(path, sep);
@@ -165,7 +190,7 @@ static inline HkString *path_match(HkString *path, HkString *name, HkString *cur
       hk_string_free(file);
       file = _file;
     }
-    if (file_exists(file->chars))
+    if (probe_file(state, file))
     {
       hk_string_free(wc);
       hk_array_free(patterns);
@@ -178,6 +203,114 @@ static inline HkString *path_match(HkString *path, HkString *name, HkString *cur
   return NULL;
 }
 
+static inline HkString *resolve_module(ModuleState *state, HkString *name, HkString *currFile)
+{
+  // Resolution depends only on the name and the importing directory, which
+  // are both part of the relative file name.
+  HkString *key = get_module_file(name, currFile);
+  hk_incr_ref(key);
+  Record *resolvedFiles = &state->resolvedFiles;
+  RecordEntry *entry = resolvedFiles->entries ? record_get_entry(resolvedFiles, key) : NULL;
+  if (entry)
+  {
+    hk_string_release(key);
+    return hk_string_copy(hk_as_string(entry->value));
+  }
+  HkString *file = path_match(state, get_env_path(state), name, currFile);
+  if (file)
+    record_lazy_put(resolvedFiles, key, hk_string_value(hk_string_copy(file)));
+  hk_string_release(key);
+  return file;
+}
+
+static inline bool probe_file(ModuleState *state, HkString *file)
+{
+#if defined(_WIN32) || defined(__APPLE__)
+  // These file systems ignore case by default, so a listing cannot tell
+  // whether a name spelled differently is there.
+  (void) state;
+  return file_exists(file->chars);
+#else
+  // Each directory is read once, instead of probing every candidate file.
+  // A listing is tagged with the modification time of its directory and is
+  // read again when that time changes, so modules created later are found.
+  char *sep = strrchr(file->chars, DIR_SEP[0]);
+  int length = sep ? (int) (sep - file->chars) + 1 : 0;
+  HkString *dir = hk_string_from_chars(length, file->chars);
+  struct stat st;
+  if (stat(length ? dir->chars : ".", &st) == -1)
+  {
+    hk_string_free(dir);
+    return false;
+  }
+  // Times have a resolution of a second, so a directory changed that recently
+  // may change again without its time showing it.
+  if (time(NULL) - st.st_mtime < LISTING_MIN_AGE)
+  {
+    hk_string_free(dir);
+    return file_exists(file->chars);
+  }
+  double mtime = (double) st.st_mtime;
+  hk_incr_ref(dir);
+  Record *listedDirs = &state->listedDirs;
+  RecordEntry *entry = listedDirs->entries ? record_get_entry(listedDirs, dir) : NULL;
+  if (!entry || hk_as_number(entry->value) != mtime)
+  {
+    list_dir(state, dir, mtime);
+    record_lazy_put(listedDirs, dir, hk_number_value(mtime));
+  }
+  hk_string_release(dir);
+  // Entries left by an older listing may name files that are gone.
+  Record *dirEntries = &state->dirEntries;
+  entry = dirEntries->entries ? record_get_entry(dirEntries, file) : NULL;
+  if (!entry || hk_as_number(entry->value) != mtime)
+    return false;
+  // A listed name may still be a dangling link.
+  return file_exists(file->chars);
+#endif
+}
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+static inline void list_dir(ModuleState *state, HkString *prefix, double mtime)
+{
+  DIR *dir = opendir(prefix->length ? prefix->chars : ".");
+  if (!dir)
+    return;
+  struct dirent *ent;
+  while ((ent = readdir(dir)))
+  {
+    HkString *entry = hk_string_copy(prefix);
+    hk_string_inplace_concat_chars(entry, -1, ent->d_name);
+    hk_incr_ref(entry);
+    record_lazy_put(&state->dirEntries, entry, hk_number_value(mtime));
+    hk_string_release(entry);
+  }
+  (void) closedir(dir);
+}
+#endif
+
+static inline void record_lazy_put(Record *rec, HkString *key, HkValue value)
+{
+  if (!rec->entries)
+    record_init(rec, 0);
+  record_inplace_put(rec, key, value);
+}
+
+static inline void record_lazy_deinit(Record *rec)
+{
+  if (!rec->entries)
+    return;
+  record_deinit(rec);
+  rec->entries = NULL;
+}
+
+static inline double now(void)
+{
+  struct timespec ts;
+  (void) timespec_get(&ts, TIME_UTC);
+  return (double) ts.tv_sec * 1000 + (double) ts.tv_nsec / 1000000;
+}
+
 static inline bool is_relative(char *filename)
 {
 #ifdef _WIN32
@@ -202,10 +335,22 @@ static inline HkString *get_module_file(HkString *relFile, HkString *currFile)
   return hk_string_copy(relFile);
 }
 
-static inline void load_module(HkVM *vm, HkString *name, HkString *currFile)
+static inline void load_module(HkVM *vm, HkString *name, HkString *currFile,
+  ImportTrace *trace)
 {
-  HkString *path = get_env_path();
-  HkString *file = path_match(path, name, currFile);
+  // Modules bundled into the running image never touch the filesystem.
+  ModuleState *state = (ModuleState *) vm->modules;
+  Record *bundled = &state->bundled;
+  RecordEntry *entry = bundled->entries ? record_get_entry(bundled, name) : NULL;
+  if (entry)
+  {
+    trace->kind = "bundled";
+    run_source_module(vm, hk_as_closure(entry->value), name);
+    return;
+  }
+  double start = now();
+  HkString *file = resolve_module(state, name, currFile);
+  trace->resolveTime = now() - start;
   if (!file)
   {
     hk_vm_runtime_error(vm, "cannot find module `%.*s`",
@@ -214,13 +359,29 @@ static inline void load_module(HkVM *vm, HkString *name, HkString *currFile)
   }
   if (is_source_module(file->chars))
   {
+    trace->kind = "source";
     load_source_module(vm, file, name);
     return;
   }
+  trace->kind = "native";
   load_native_module(vm, file, name);
   hk_string_free(file);
 }
 
+static inline void trace_import(ModuleState *state, HkString *name, ImportTrace *trace,
+  double start)
+{
+  // Modules are reported once loaded, so nested imports come before the
+  // module that imports them.
+  if (!state->traceHeader)
+  {
+    fprintf(stderr, "import:  resolve [ms] |    total [ms] | kind    | module\n");
+    state->traceHeader = true;
+  }
+  fprintf(stderr, "import: %12.3f | %12.3f | %-7s | %*s%.*s\n", trace->resolveTime,
+    now() - start, trace->kind, state->traceDepth * 2, "", name->length, name->chars);
+}
+
 static inline bool is_source_module(char *filename)
 {
   char *ext = strrchr(filename, '.');
@@ -231,11 +392,34 @@ static inline bool is_source_module(char *filename)
 
 static inline void load_source_module(HkVM *vm, HkString *file, HkString *name)
 {
+  hk_incr_ref(file);
   HkString *source = load_source_from_file(file->chars);
   if (!source)
+  {
     hk_vm_runtime_error(vm, "cannot open module `%.*s`",
       name->length, name->chars);
+    hk_string_release(file);
+    return;
+  }
+  hk_incr_ref(source);
+  HkClosure *cl = compile_source_module(file, source);
+  hk_string_release(source);
+  hk_string_release(file);
+  run_source_module(vm, cl, name);
+}
+
+static inline HkClosure *compile_source_module(HkString *file, HkString *source)
+{
+  HkFunction *fn = cache_load(file, source);
+  if (fn)
+    return hk_closure_new(fn);
   HkClosure *cl = hk_compile(file, source, HK_COMPILER_FLAG_NONE);
+  cache_store(file, source, cl->fn);
+  return cl;
+}
+
+static inline void run_source_module(HkVM *vm, HkClosure *cl, HkString *name)
+{
   hk_vm_push_closure(vm, cl);
   hk_vm_push_array(vm, hk_array_new());
   hk_vm_call(vm, 1);
@@ -294,30 +478,42 @@ static inline HkString *load_source_from_file(const char *filename)
   return source;
 }
 
-static inline bool module_cache_get(HkString *name, HkValue *module)
+static inline bool module_cache_get(ModuleState *state, HkString *name, HkValue *module)
 {
-  RecordEntry *entry = record_get_entry(&moduleCache, name);
+  Record *cache = &state->cache;
+  if (!cache->entries)
+    return false;
+  RecordEntry *entry = record_get_entry(cache, name);
   if (!entry)
     return false;
   *module = entry->value;
   return true;
 }
 
-static inline void module_cache_put(HkString *name, HkValue module)
+static inline void module_cache_put(ModuleState *state, HkString *name, HkValue module)
 {
-  record_inplace_put(&moduleCache, name, module);
+  record_lazy_put(&state->cache, name, module);
 }
 
-void module_cache_init(void)
+ModuleState *module_state_new(void)
 {
-  record_init(&moduleCache, 0);
+  // Every record starts out empty and is only allocated once something is
+  // put in it.
+  ModuleState *state = (ModuleState *) hk_allocate(sizeof(*state));
+  memset(state, 0, sizeof(*state));
+  return state;
 }
 
-void module_cache_deinit(void)
+void module_state_free(ModuleState *state)
 {
-  record_deinit(&moduleCache);
-  if (envPath)
-    hk_string_free(envPath);
+  record_lazy_deinit(&state->cache);
+  record_lazy_deinit(&state->bundled);
+  record_lazy_deinit(&state->resolvedFiles);
+  record_lazy_deinit(&state->listedDirs);
+  record_lazy_deinit(&state->dirEntries);
+  if (state->envPath)
+    hk_string_free(state->envPath);
+  hk_free(state);
 }
 
 void module_load(HkVM *vm, HkString *currFile)
@@ -326,20 +522,78 @@ void module_load(HkVM *vm, HkString *currFile)
   HkValue val = slots[0];
   hk_assert(hk_is_string(val), "module name must be a string");
   HkString *name = hk_as_string(val);
+  ModuleState *state = (ModuleState *) vm->modules;
+  bool traced = hk_vm_is_trace_imports(vm);
+  double start = traced ? now() : 0;
+  ImportTrace trace = { .kind = "cached", .resolveTime = 0 };
   HkValue module;
   // FIXME: Do cache using absolute file path instead of module name
-  if (module_cache_get(name, &module))
+  if (module_cache_get(state, name, &module))
   {
+    if (traced)
+      trace_import(state, name, &trace, start);
     hk_value_incr_ref(module);
     slots[0] = module;
     hk_string_release(name);
     return;
   }
-  load_module(vm, name, currFile);
+  ++state->traceDepth;
+  load_module(vm, name, currFile, &trace);
+  --state->traceDepth;
   hk_return_if_not_ok(vm);
+  if (traced)
+    trace_import(state, name, &trace, start);
   val = hk_stack_get(&vm->vstk, 0);
-  module_cache_put(name, val);
+  module_cache_put(state, name, val);
   slots[0] = val;
   hk_stack_pop(&vm->vstk);
   hk_string_release(name);
 }
+
+HkFunction *module_compile(ModuleState *state, HkString *name, HkString *currFile)
+{
+  HkString *file = resolve_module(state, name, currFile);
+  if (!file)
+    return NULL;
+  HkString *source = is_source_module(file->chars) ? load_source_from_file(file->chars) : NULL;
+  if (!source)
+  {
+    hk_string_free(file);
+    return NULL;
+  }
+  hk_incr_ref(file);
+  hk_incr_ref(source);
+  HkClosure *cl = compile_source_module(file, source);
+  hk_string_release(source);
+  hk_string_release(file);
+  HkFunction *fn = cl->fn;
+  hk_incr_ref(fn);
+  hk_closure_free(cl);
+  hk_decr_ref(fn);
+  return fn;
+}
+
+void module_open_native(ModuleState *state, HkString *name, HkString *currFile)
+{
+  HkString *file = resolve_module(state, name, currFile);
+  if (!file)
+    return;
+  // The library is never closed, so the handle is not kept; a later import
+  // opens it again and gets the copy already mapped.
+  if (!is_source_module(file->chars))
+  {
+#ifdef _WIN32
+    (void) LoadLibrary(file->chars);
+#else
+    (void) dlopen(file->chars, RTLD_NOW | RTLD_GLOBAL);
+#endif
+  }
+  hk_string_free(file);
+}
+
+void module_bundle_put(ModuleState *state, HkString *name, HkFunction *fn)
+{
+  // The functions run, and get rewritten, in the VM that loaded the bundle,
+  // so they are registered with that VM alone.
+  record_lazy_put(&state->bundled, name, hk_closure_value(hk_closure_new(fn)));
+}
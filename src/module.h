@@ -12,9 +12,25 @@
 #define MODULE_H
 
 #include "hook/vm.h"
+#include "record.h"
 
-void module_cache_init(void);
-void module_cache_deinit(void);
+typedef struct
+{
+  Record   cache;
+  Record   bundled;
+  Record   resolvedFiles;
+  Record   listedDirs;
+  Record   dirEntries;
+  HkString *envPath;
+  int      traceDepth;
+  bool     traceHeader;
+} ModuleState;
+
+ModuleState *module_state_new(void);
+void module_state_free(ModuleState *state);
 void module_load(HkVM *vm, HkString *currFile);
+HkFunction *module_compile(ModuleState *state, HkString *name, HkString *currFile);
+void module_open_native(ModuleState *state, HkString *name, HkString *currFile);
+void module_bundle_put(ModuleState *state, HkString *name, HkFunction *fn);
 
 #endif // MODULE_H
@@ -0,0 +1,289 @@
+//
+// peephole.c
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "peephole.h"
+#include <string.h>
+#include "hook/memory.h"
+
+static inline bool is_jump(HkOpCode op);
+static inline int num_targets(uint8_t *code);
+static inline uint8_t *target_at(uint8_t *code, int index);
+static inline uint16_t read_word(uint8_t *code);
+static inline void write_word(uint8_t *code, uint16_t word);
+static inline bool match(uint8_t *code, int length, bool *barriers, int offset, HkOpCode op);
+static inline int fuse(uint8_t *code, int length, bool *barriers, int offset, uint8_t *dest,
+  int *consumed);
+static inline HkOpCode fused_jump(HkOpCode op);
+
+int peephole_instruction_length(uint8_t *code)
+{
+  switch (code[0])
+  {
+  case HK_OP_CONSTANT:
+  case HK_OP_ARRAY:
+  case HK_OP_STRUCT:
+  case HK_OP_INSTANCE:
+  case HK_OP_CONSTRUCT:
+  case HK_OP_CLOSURE:
+  case HK_OP_UNPACK_ARRAY:
+  case HK_OP_UNPACK_STRUCT:
+  case HK_OP_GLOBAL:
+  case HK_OP_NONLOCAL:
+  case HK_OP_GET_LOCAL:
+  case HK_OP_SET_LOCAL:
+  case HK_OP_GET_FIELD:
+  case HK_OP_FETCH_FIELD:
+  case HK_OP_PUT_FIELD:
+  case HK_OP_INPLACE_PUT_FIELD:
+  case HK_OP_CALL:
+  case HK_OP_INCREMENT_LOCAL:
+  case HK_OP_DECREMENT_LOCAL:
+  case HK_OP_CALL_POP:
+  case HK_OP_RETURN_ARRAY:
+    return 2;
+  case HK_OP_INT:
+  case HK_OP_JUMP:
+  case HK_OP_JUMP_IF_FALSE:
+  case HK_OP_JUMP_IF_TRUE:
+  case HK_OP_JUMP_IF_TRUE_OR_POP:
+  case HK_OP_JUMP_IF_FALSE_OR_POP:
+  case HK_OP_JUMP_IF_NOT_EQUAL:
+  case HK_OP_JUMP_IF_NOT_VALID:
+  case HK_OP_GET_LOCAL_LOCAL:
+  case HK_OP_JUMP_IF_NOT_LESS:
+  case HK_OP_JUMP_IF_NOT_GREATER:
+  case HK_OP_JUMP_IF_LESS:
+  case HK_OP_JUMP_IF_GREATER:
+  case HK_OP_FOREACH_CURRENT:
+  case HK_OP_CALL_UNPACK:
+    return 3;
+  case HK_OP_GET_LOCAL_INT:
+    return 4;
+  case HK_OP_FOR_LOOP:
+  case HK_OP_FOR_LOOP_INT:
+    return 7;
+  case HK_OP_MATCH_INT:
+    return 7 + 2 * read_word(&code[5]);
+  case HK_OP_MATCH_STRING:
+    return 6 + 3 * (1 << code[5]);
+  default:
+    break;
+  }
+  return 1;
+}
+
+static inline bool is_jump(HkOpCode op)
+{
+  switch (op)
+  {
+  case HK_OP_JUMP:
+  case HK_OP_JUMP_IF_FALSE:
+  case HK_OP_JUMP_IF_TRUE:
+  case HK_OP_JUMP_IF_TRUE_OR_POP:
+  case HK_OP_JUMP_IF_FALSE_OR_POP:
+  case HK_OP_JUMP_IF_NOT_EQUAL:
+  case HK_OP_JUMP_IF_NOT_VALID:
+  case HK_OP_JUMP_IF_NOT_LESS:
+  case HK_OP_JUMP_IF_NOT_GREATER:
+  case HK_OP_JUMP_IF_LESS:
+  case HK_OP_JUMP_IF_GREATER:
+  case HK_OP_FOREACH_CURRENT:
+  case HK_OP_FOR_LOOP:
+  case HK_OP_FOR_LOOP_INT:
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline int num_targets(uint8_t *code)
+{
+  switch (code[0])
+  {
+  case HK_OP_MATCH_INT:
+    return 1 + read_word(&code[5]);
+  case HK_OP_MATCH_STRING:
+    return 1 + (1 << code[5]);
+  default:
+    break;
+  }
+  return is_jump((HkOpCode) code[0]) ? 1 : 0;
+}
+
+static inline uint8_t *target_at(uint8_t *code, int index)
+{
+  if (!index)
+    return &code[1];
+  if (code[0] == HK_OP_MATCH_INT)
+    return &code[7 + 2 * (index - 1)];
+  return &code[6 + 3 * (index - 1) + 1];
+}
+
+static inline uint16_t read_word(uint8_t *code)
+{
+  return *((uint16_t *) code);
+}
+
+static inline void write_word(uint8_t *code, uint16_t word)
+{
+  *((uint16_t *) code) = word;
+}
+
+static inline bool match(uint8_t *code, int length, bool *barriers, int offset, HkOpCode op)
+{
+  return offset < length && !barriers[offset] && code[offset] == op;
+}
+
+static inline int fuse(uint8_t *code, int length, bool *barriers, int offset, uint8_t *dest,
+  int *consumed)
+{
+  HkOpCode op = (HkOpCode) code[offset];
+  int next = offset + peephole_instruction_length(&code[offset]);
+  if (op == HK_OP_JUMP && read_word(&code[offset + 1]) == next)
+  {
+    *consumed = next - offset;
+    return 0;
+  }
+  if (op == HK_OP_GET_LOCAL)
+  {
+    uint8_t index = code[offset + 1];
+    if ((match(code, length, barriers, next, HK_OP_INCREMENT)
+      || match(code, length, barriers, next, HK_OP_DECREMENT))
+      && match(code, length, barriers, next + 1, HK_OP_SET_LOCAL)
+      && code[next + 2] == index)
+    {
+      dest[0] = code[next] == HK_OP_INCREMENT ? HK_OP_INCREMENT_LOCAL : HK_OP_DECREMENT_LOCAL;
+      dest[1] = index;
+      *consumed = next + 3 - offset;
+      return 2;
+    }
+    if (match(code, length, barriers, next, HK_OP_GET_LOCAL))
+    {
+      dest[0] = HK_OP_GET_LOCAL_LOCAL;
+      dest[1] = index;
+      dest[2] = code[next + 1];
+      *consumed = next + 2 - offset;
+      return 3;
+    }
+    if (match(code, length, barriers, next, HK_OP_INT))
+    {
+      dest[0] = HK_OP_GET_LOCAL_INT;
+      dest[1] = index;
+      write_word(&dest[2], read_word(&code[next + 1]));
+      *consumed = next + 3 - offset;
+      return 4;
+    }
+  }
+  HkOpCode jumpOp = fused_jump(op);
+  if (jumpOp != op && match(code, length, barriers, next, HK_OP_JUMP_IF_FALSE))
+  {
+    dest[0] = jumpOp;
+    write_word(&dest[1], read_word(&code[next + 1]));
+    *consumed = next + 3 - offset;
+    return 3;
+  }
+  if (op == HK_OP_CALL && match(code, length, barriers, next, HK_OP_POP))
+  {
+    dest[0] = HK_OP_CALL_POP;
+    dest[1] = code[offset + 1];
+    *consumed = next + 1 - offset;
+    return 2;
+  }
+  if (op == HK_OP_CALL && match(code, length, barriers, next, HK_OP_UNPACK_ARRAY))
+  {
+    dest[0] = HK_OP_CALL_UNPACK;
+    dest[1] = code[offset + 1];
+    dest[2] = code[next + 1];
+    *consumed = next + 2 - offset;
+    return 3;
+  }
+  if (op == HK_OP_ARRAY && match(code, length, barriers, next, HK_OP_RETURN))
+  {
+    dest[0] = HK_OP_RETURN_ARRAY;
+    dest[1] = code[offset + 1];
+    *consumed = next + 1 - offset;
+    return 2;
+  }
+  int n = next - offset;
+  memcpy(dest, &code[offset], n);
+  *consumed = n;
+  return n;
+}
+
+static inline HkOpCode fused_jump(HkOpCode op)
+{
+  switch (op)
+  {
+  case HK_OP_LESS:
+    return HK_OP_JUMP_IF_NOT_LESS;
+  case HK_OP_GREATER:
+    return HK_OP_JUMP_IF_NOT_GREATER;
+  case HK_OP_NOT_LESS:
+    return HK_OP_JUMP_IF_LESS;
+  case HK_OP_NOT_GREATER:
+    return HK_OP_JUMP_IF_GREATER;
+  default:
+    break;
+  }
+  return op;
+}
+
+void peephole_optimize_chunk(HkChunk *chunk)
+{
+  int length = chunk->codeLength;
+  uint8_t *code = chunk->code;
+  // Jump targets and line starts must stay at the beginning of an
+  // instruction, so no sequence is fused across them.
+  bool *barriers = (bool *) hk_allocate(sizeof(*barriers) * (length + 1));
+  memset(barriers, 0, sizeof(*barriers) * (length + 1));
+  for (int i = 0; i < length; i += peephole_instruction_length(&code[i]))
+    for (int k = 0; k < num_targets(&code[i]); ++k)
+      barriers[read_word(target_at(&code[i], k))] = true;
+  int numLines = chunk->lines.length;
+  HkLine *lines = hk_line_table_unpack(&chunk->lines);
+  for (int i = 0; i < numLines; ++i)
+    barriers[lines[i].offset] = true;
+  int *offsets = (int *) hk_allocate(sizeof(*offsets) * (length + 1));
+  uint8_t *result = (uint8_t *) hk_allocate(chunk->codeCapacity);
+  int j = 0;
+  for (int i = 0; i < length;)
+  {
+    int consumed;
+    int n = fuse(code, length, barriers, i, &result[j], &consumed);
+    for (int k = 0; k < consumed; ++k)
+      offsets[i + k] = j;
+    i += consumed;
+    j += n;
+  }
+  offsets[length] = j;
+  for (int i = 0; i < j; i += peephole_instruction_length(&result[i]))
+    for (int k = 0; k < num_targets(&result[i]); ++k)
+    {
+      uint8_t *target = target_at(&result[i], k);
+      write_word(target, (uint16_t) offsets[read_word(target)]);
+    }
+  hk_line_table_truncate(&chunk->lines, 0);
+  for (int i = 0; i < numLines; ++i)
+    hk_line_table_append(&chunk->lines, offsets[lines[i].offset], lines[i].no);
+  hk_free(lines);
+  hk_free(chunk->code);
+  chunk->code = result;
+  chunk->codeLength = j;
+  hk_free(offsets);
+  hk_free(barriers);
+}
+
+void peephole_optimize(HkFunction *fn)
+{
+  peephole_optimize_chunk(&fn->chunk);
+  for (int i = 0; i < fn->functionsLength; ++i)
+    peephole_optimize(fn->functions[i]);
+}
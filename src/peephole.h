@@ -0,0 +1,20 @@
+//
+// peephole.h
+//
+// Copyright 2021 The Hook Programming Language Authors.
+//
+// This file is part of the Hook project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "hook/callable.h"
+
+int peephole_instruction_length(uint8_t *code);
+void peephole_optimize_chunk(HkChunk *chunk);
+void peephole_optimize(HkFunction *fn);
+
+#endif // PEEPHOLE_H
@@ -37,7 +37,10 @@ static inline void grow(Record *rec)
     HkString *key = entry->key;
     if (!key)
       continue;
-    entries[key->hash & mask] = rec->entries[i];
+    int index = key->hash & mask;
+    while (entries[index].key)
+      index = (index + 1) & mask;
+    entries[index] = rec->entries[i];
     ++j;
   }
   hk_free(rec->entries);
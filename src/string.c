@@ -11,18 +11,89 @@
 #include "hook/string.h"
 #include <ctype.h>
 #include <limits.h>
+#include <math.h>
+#include <stdio.h>
 #include <string.h>
 #include "hook/memory.h"
 #include "hook/utils.h"
 
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
 #ifdef _WIN32
   #define strtok_r strtok_s
 #endif
 
+#define BLOCK_SIZE 16
+
+#ifdef _MSC_VER
+  #define THREAD_LOCAL __declspec(thread)
+#else
+  #define THREAD_LOCAL _Thread_local
+#endif
+
+#define NUM_CHAR_STRINGS (UCHAR_MAX + 1)
+#define NUM_INT_STRINGS  (1 << 10)
+#define INT_STRING_SIZE  8
+
+// The cached strings are refcounted like any other, so each thread keeps its
+// own copy instead of having VMs on different threads race on the counts.
+// This is what pins a VM to the thread that created it.
+static THREAD_LOCAL bool cacheInitialized = false;
+static THREAD_LOCAL HkString charStrings[NUM_CHAR_STRINGS];
+static THREAD_LOCAL char charStringsChars[NUM_CHAR_STRINGS][2];
+static THREAD_LOCAL HkString intStrings[NUM_INT_STRINGS];
+static THREAD_LOCAL char intStringsChars[NUM_INT_STRINGS][INT_STRING_SIZE];
+
+static inline void init_cache(void);
+static inline void init_cached_string(HkString *str, int length, char *chars, int capacity);
 static inline HkString *string_allocate(int minCapacity);
 static inline void add_char(HkString *str, char c);
+static inline void invalidate(HkString *str);
 static inline uint32_t hash(int length, char *chars);
 static inline int index_of(char *chars, int subLength, char *sub);
+static inline char fold_char(char c);
+static inline void map_case(char *dest, const char *src, int length, char first);
+static inline void reverse_chars(char *dest, const char *src, int length);
+static inline void inplace_reverse_chars(char *chars, int length);
+static inline int mismatch_ignore_case(const char *chars1, const char *chars2, int length);
+#ifdef __SSE2__
+static inline __m128i map_case_block(__m128i block, __m128i offset, __m128i limit);
+static inline __m128i reverse_block(__m128i block);
+#endif
+
+static inline void init_cache(void)
+{
+  if (cacheInitialized)
+    return;
+  for (int i = 0; i < NUM_CHAR_STRINGS; ++i)
+  {
+    char *chars = charStringsChars[i];
+    chars[0] = (char) i;
+    chars[1] = '\0';
+    init_cached_string(&charStrings[i], 1, chars, 2);
+  }
+  for (int i = 0; i < NUM_INT_STRINGS; ++i)
+  {
+    char *chars = intStringsChars[i];
+    int length = snprintf(chars, INT_STRING_SIZE, "%d", i);
+    init_cached_string(&intStrings[i], length, chars, INT_STRING_SIZE);
+  }
+  cacheInitialized = true;
+}
+
+static inline void init_cached_string(HkString *str, int length, char *chars, int capacity)
+{
+  // The cache owns one reference, so these strings are never freed and,
+  // since their count never drops to 1, never mutated in place.
+  str->refCount = 1;
+  str->capacity = capacity;
+  str->length = length;
+  str->chars = chars;
+  str->hash = -1;
+  str->index = NULL;
+}
 
 static inline HkString *string_allocate(int minCapacity)
 {
@@ -34,6 +105,7 @@ static inline HkString *string_allocate(int minCapacity)
   str->capacity = capacity;
   str->chars = (char *) hk_allocate(capacity);
   str->hash = -1;
+  str->index = NULL;
   return str;
 }
 
@@ -43,6 +115,15 @@ static inline void add_char(HkString *str, char c)
   str->chars[str->length] = c;
 }
 
+static inline void invalidate(HkString *str)
+{
+  str->hash = -1;
+  if (!str->index)
+    return;
+  hk_free(str->index);
+  str->index = NULL;
+}
+
 static inline uint32_t hash(int length, char *chars)
 {
   uint32_t hash = 2166136261u;
@@ -67,6 +148,107 @@ static inline int index_of(char *chars, int subLength, char *sub)
   return -1;
 }
 
+static inline char fold_char(char c)
+{
+  return c >= 'A' && c <= 'Z' ? (char) (c ^ 0x20) : c;
+}
+
+static inline void map_case(char *dest, const char *src, int length, char first)
+{
+  int i = 0;
+#ifdef __SSE2__
+  // Bytes in [first, first + 25] become the smallest signed values once
+  // shifted, so a single signed compare selects the letters to flip.
+  __m128i offset = _mm_set1_epi8((char) (SCHAR_MIN - first));
+  __m128i limit = _mm_set1_epi8((char) (SCHAR_MIN + 26));
+  for (; i + BLOCK_SIZE <= length; i += BLOCK_SIZE)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i *) &src[i]);
+    _mm_storeu_si128((__m128i *) &dest[i], map_case_block(block, offset, limit));
+  }
+#endif
+  for (; i < length; ++i)
+  {
+    char c = src[i];
+    dest[i] = c >= first && c <= first + 25 ? (char) (c ^ 0x20) : c;
+  }
+}
+
+static inline void reverse_chars(char *dest, const char *src, int length)
+{
+  int i = 0;
+#ifdef __SSE2__
+  for (; i + BLOCK_SIZE <= length; i += BLOCK_SIZE)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i *) &src[length - i - BLOCK_SIZE]);
+    _mm_storeu_si128((__m128i *) &dest[i], reverse_block(block));
+  }
+#endif
+  for (; i < length; ++i)
+    dest[i] = src[length - i - 1];
+}
+
+static inline void inplace_reverse_chars(char *chars, int length)
+{
+  int i = 0;
+  int j = length;
+#ifdef __SSE2__
+  for (; j - i >= 2 * BLOCK_SIZE; i += BLOCK_SIZE, j -= BLOCK_SIZE)
+  {
+    __m128i low = _mm_loadu_si128((const __m128i *) &chars[i]);
+    __m128i high = _mm_loadu_si128((const __m128i *) &chars[j - BLOCK_SIZE]);
+    _mm_storeu_si128((__m128i *) &chars[i], reverse_block(high));
+    _mm_storeu_si128((__m128i *) &chars[j - BLOCK_SIZE], reverse_block(low));
+  }
+#endif
+  for (--j; i < j; ++i, --j)
+  {
+    char c = chars[i];
+    chars[i] = chars[j];
+    chars[j] = c;
+  }
+}
+
+static inline int mismatch_ignore_case(const char *chars1, const char *chars2, int length)
+{
+  int i = 0;
+#ifdef __SSE2__
+  __m128i offset = _mm_set1_epi8((char) (SCHAR_MIN - 'A'));
+  __m128i limit = _mm_set1_epi8((char) (SCHAR_MIN + 26));
+  for (; i + BLOCK_SIZE <= length; i += BLOCK_SIZE)
+  {
+    __m128i block1 = _mm_loadu_si128((const __m128i *) &chars1[i]);
+    __m128i block2 = _mm_loadu_si128((const __m128i *) &chars2[i]);
+    block1 = map_case_block(block1, offset, limit);
+    block2 = map_case_block(block2, offset, limit);
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block1, block2));
+    if (mask != 0xffff)
+      break;
+  }
+#endif
+  for (; i < length; ++i)
+    if (fold_char(chars1[i]) != fold_char(chars2[i]))
+      break;
+  return i;
+}
+
+#ifdef __SSE2__
+static inline __m128i map_case_block(__m128i block, __m128i offset, __m128i limit)
+{
+  __m128i shifted = _mm_add_epi8(block, offset);
+  __m128i mask = _mm_cmplt_epi8(shifted, limit);
+  return _mm_xor_si128(block, _mm_and_si128(mask, _mm_set1_epi8(0x20)));
+}
+
+static inline __m128i reverse_block(__m128i block)
+{
+  block = _mm_shuffle_epi32(block, _MM_SHUFFLE(0, 1, 2, 3));
+  block = _mm_shufflelo_epi16(block, _MM_SHUFFLE(2, 3, 0, 1));
+  block = _mm_shufflehi_epi16(block, _MM_SHUFFLE(2, 3, 0, 1));
+  return _mm_or_si128(_mm_slli_epi16(block, 8), _mm_srli_epi16(block, 8));
+}
+#endif
+
 HkString *hk_string_new(void)
 {
   return hk_string_new_with_capacity(0);
@@ -91,6 +273,24 @@ HkString *hk_string_from_chars(int length, const char *chars)
   return str;
 }
 
+HkString *hk_string_from_char(char c)
+{
+  init_cache();
+  return &charStrings[(unsigned char) c];
+}
+
+HkString *hk_string_from_number(double num)
+{
+  if (!signbit(num) && num < NUM_INT_STRINGS && num == (int) num)
+  {
+    init_cache();
+    return &intStrings[(int) num];
+  }
+  char chars[32];
+  snprintf(chars, sizeof(chars) - 1, "%g", num);
+  return hk_string_from_chars(-1, chars);
+}
+
 HkString *hk_string_from_stream(FILE *stream, const char delim)
 {
   HkString *str = string_allocate(0);
@@ -118,6 +318,7 @@ void hk_string_ensure_capacity(HkString *str, int minCapacity)
 
 void hk_string_free(HkString *str)
 {
+  hk_free(str->index);
   hk_free(str->chars);
   hk_free(str);
 }
@@ -150,6 +351,13 @@ HkString *hk_string_concat(HkString *str1, HkString *str2)
   return result;
 }
 
+void hk_string_inplace_clear(HkString *str)
+{
+  str->length = 0;
+  str->chars[0] = '\0';
+  invalidate(str);
+}
+
 void hk_string_inplace_concat_char(HkString *dest, char c)
 {
   int length = dest->length;
@@ -157,6 +365,7 @@ void hk_string_inplace_concat_char(HkString *dest, char c)
   dest->chars[length] = c;
   dest->chars[length + 1] = '\0';
   dest->length += 1;
+  invalidate(dest);
 }
 
 void hk_string_inplace_concat_chars(HkString *dest, int length, const char *chars)
@@ -168,7 +377,7 @@ void hk_string_inplace_concat_chars(HkString *dest, int length, const char *char
   memcpy(&dest->chars[dest->length], chars, length);
   dest->length = new_length;
   dest->chars[new_length] = '\0';
-  dest->hash = -1;
+  invalidate(dest);
 }
 
 void hk_string_inplace_concat(HkString *dest, HkString *src)
@@ -178,7 +387,7 @@ void hk_string_inplace_concat(HkString *dest, HkString *src)
   memcpy(&dest->chars[dest->length], src->chars, src->length);
   dest->length = length;
   dest->chars[length] = '\0';
-  dest->hash = -1;
+  invalidate(dest);
 }
 
 int hk_string_index_of_chars(HkString *str, int length, const char *chars)
@@ -283,13 +492,25 @@ int hk_string_compare(HkString *str1, HkString *str2)
   return result > 0 ? 1 : (result < 0 ? -1 : 0);
 }
 
+int hk_string_compare_ignore_case(HkString *str1, HkString *str2)
+{
+  int length1 = str1->length;
+  int length2 = str2->length;
+  int length = length1 < length2 ? length1 : length2;
+  int i = mismatch_ignore_case(str1->chars, str2->chars, length);
+  if (i == length)
+    return length1 > length2 ? 1 : (length1 < length2 ? -1 : 0);
+  unsigned char c1 = (unsigned char) fold_char(str1->chars[i]);
+  unsigned char c2 = (unsigned char) fold_char(str2->chars[i]);
+  return c1 > c2 ? 1 : -1;
+}
+
 HkString *hk_string_lower(HkString *str)
 {
   int length = str->length;
   HkString *result = string_allocate(length);
   result->length = length;
-  for (int i = 0; i < length; ++i)
-    result->chars[i] = (char) tolower(str->chars[i]);
+  map_case(result->chars, str->chars, length, 'A');
   result->chars[length] = '\0';
   return result;
 }
@@ -299,12 +520,23 @@ HkString *hk_string_upper(HkString *str)
   int length = str->length;
   HkString *result = string_allocate(length);
   result->length = length;
-  for (int i = 0; i < length; ++i)
-    result->chars[i] = (char) toupper(str->chars[i]);
+  map_case(result->chars, str->chars, length, 'a');
   result->chars[length] = '\0';
   return result;
 }
 
+void hk_string_inplace_lower(HkString *str)
+{
+  map_case(str->chars, str->chars, str->length, 'A');
+  invalidate(str);
+}
+
+void hk_string_inplace_upper(HkString *str)
+{
+  map_case(str->chars, str->chars, str->length, 'a');
+  invalidate(str);
+}
+
 bool hk_string_trim(HkString *str, HkString **result)
 {
   int length = str->length;
@@ -319,16 +551,28 @@ bool hk_string_trim(HkString *str, HkString **result)
     --h;
   if (!l && h == high)
     return false;
-  HkString *_result = string_allocate(h - l + 1);
-  int j = 0;
-  for (int i = l; i <= h; ++i)
-    _result->chars[j++] = str->chars[i];
-  _result->chars[j] = '\0';
-  _result->length = j;
-  *result = _result;
+  *result = hk_string_from_chars(h - l + 1, &str->chars[l]);
   return true;
 }
 
+void hk_string_inplace_trim(HkString *str)
+{
+  int length = str->length;
+  int l = 0;
+  while (l < length && isspace(str->chars[l]))
+    ++l;
+  int h = length - 1;
+  while (h > l && isspace(str->chars[h]))
+    --h;
+  int newLength = l < length ? h - l + 1 : 0;
+  if (newLength == length)
+    return;
+  memmove(str->chars, &str->chars[l], newLength);
+  str->chars[newLength] = '\0';
+  str->length = newLength;
+  invalidate(str);
+}
+
 bool hk_string_starts_with(HkString *str1, HkString *str2)
 {
   if (!str1->length || !str2->length || str1->length < str2->length)
@@ -336,6 +580,14 @@ bool hk_string_starts_with(HkString *str1, HkString *str2)
   return !memcmp(str1->chars, str2->chars, str2->length);
 }
 
+bool hk_string_starts_with_ignore_case(HkString *str1, HkString *str2)
+{
+  if (!str1->length || !str2->length || str1->length < str2->length)
+    return false;
+  int length = str2->length;
+  return mismatch_ignore_case(str1->chars, str2->chars, length) == length;
+}
+
 bool hk_string_ends_with(HkString *str1, HkString *str2)
 {
   if (!str1->length || !str2->length || str1->length < str2->length)
@@ -348,12 +600,17 @@ HkString *hk_string_reverse(HkString *str)
   int length = str->length;
   HkString *result = string_allocate(length);
   result->length = length;
-  for (int i = 0; i < length; ++i)
-    result->chars[i] = str->chars[length - i - 1];
+  reverse_chars(result->chars, str->chars, length);
   result->chars[length] = '\0';
   return result;
 }
 
+void hk_string_inplace_reverse(HkString *str)
+{
+  inplace_reverse_chars(str->chars, str->length);
+  invalidate(str);
+}
+
 void hk_string_serialize(HkString *str, FILE *stream)
 {
   fwrite(&str->capacity, sizeof(str->capacity), 1, stream);
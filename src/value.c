@@ -17,8 +17,6 @@
 #include "hook/userdata.h"
 #include "hook/utils.h"
 
-#define EPSILON 1e-9
-
 void hk_value_free(HkValue val)
 {
   switch (val.type)
@@ -221,7 +219,7 @@ bool hk_value_compare(HkValue val1, HkValue val2, int *result)
     {
       double num1 = hk_as_number(val1);
       double num2 = hk_as_number(val2);
-      if (fabs(num1 - num2) < EPSILON)
+      if (fabs(num1 - num2) < HK_NUMBER_EPSILON)
       {
         *result = 0;
         return true;
@@ -270,7 +268,8 @@ bool hk_value_deserialize(FILE *stream, HkValue *result)
     return false;
   if (fread(&flags, sizeof(flags), 1, stream) != 1)
     return false;
-  hk_assert(type == HK_TYPE_NUMBER || type == HK_TYPE_STRING, "unimplemented deserialization");
+  if (type != HK_TYPE_NUMBER && type != HK_TYPE_STRING)
+    return false;
   if (type == HK_TYPE_NUMBER)
   {
     double data;
@@ -16,10 +16,22 @@
 #include "hook/struct.h"
 #include "hook/utils.h"
 #include "builtin.h"
+#include "ir.h"
+#include "jit.h"
 #include "module.h"
 
+#ifdef _WIN32
+  #include <Windows.h>
+#else
+  #include <sys/mman.h>
+#endif
+
 static inline void type_error(HkVM *vm, int index, int numTypes, HkType types[],
   HkType valType);
+static inline void stack_reserve(HkVM *vm, int size);
+static inline bool stack_commit(HkVM *vm, int size);
+static inline void stack_release(HkVM *vm);
+static inline bool grow_stack(HkVM *vm);
 static inline void push(HkVM *vm, HkValue val);
 static inline void pop(HkVM *vm);
 static inline int read_byte(uint8_t **pc);
@@ -36,6 +48,7 @@ static inline void do_unpack_array(HkVM *vm, int n);
 static inline void do_unpack_struct(HkVM *vm, int n);
 static inline void do_append_element(HkVM *vm);
 static inline void do_get_element(HkVM *vm);
+static inline void do_get_element_array_int(HkVM *vm);
 static inline void slice_string(HkVM *vm, HkValue *slot, HkString *str, HkRange *range);
 static inline void slice_array(HkVM *vm, HkValue *slot, HkArray *arr, HkRange *range);
 static inline void do_fetch_element(HkVM *vm);
@@ -52,6 +65,9 @@ static inline void do_put_field(HkVM *vm, HkString *name);
 static inline void do_inplace_put_field(HkVM *vm, HkString *name);
 static inline void do_current(HkVM *vm);
 static inline void do_next(HkVM *vm);
+static inline void do_foreach_init(HkVM *vm);
+static inline void do_foreach_next(HkVM *vm);
+static inline bool do_foreach_current(HkVM *vm);
 static inline void do_equal(HkVM *vm);
 static inline void do_greater(HkVM *vm);
 static inline void do_less(HkVM *vm);
@@ -77,12 +93,126 @@ static inline void do_not(HkVM *vm);
 static inline void do_bitwise_not(HkVM *vm);
 static inline void do_increment(HkVM *vm);
 static inline void do_decrement(HkVM *vm);
+static inline bool is_num_num(HkVM *vm);
+static inline bool is_array_int(HkVM *vm);
+static inline int compare_numbers(double num1, double num2);
+static inline void do_greater_num_num(HkVM *vm);
+static inline void do_less_num_num(HkVM *vm);
+static inline void do_not_greater_num_num(HkVM *vm);
+static inline void do_not_less_num_num(HkVM *vm);
+static inline void do_add_num_num(HkVM *vm);
+static inline void do_subtract_num_num(HkVM *vm);
+static inline void do_multiply_num_num(HkVM *vm);
+static inline void do_increment_local(HkVM *vm, HkValue *slot);
+static inline void do_decrement_local(HkVM *vm, HkValue *slot);
+static inline void do_compare(HkVM *vm, int *result);
+static inline bool do_for_loop(HkVM *vm, HkValue *slot, HkOpCode op, HkValue bound);
+static inline bool call_value(HkVM *vm, int numArgs, int numResults);
 static inline void do_call(HkVM *vm, int numArgs);
+static inline void do_call_unpack(HkVM *vm, int numArgs, int numResults);
 static inline void adjust_call_args(HkVM *vm, int arity, int numArgs);
 static inline void print_trace(HkString *name, HkString *file, int line);
-static inline void call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int *line);
+static inline bool call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int numResults,
+  int *line);
 static inline void discard_frame(HkVM *vm, HkValue *slots);
 static inline void move_result(HkVM *vm, HkValue *slots);
+static inline void move_results(HkVM *vm, HkValue *slots, int n);
+static inline int jit_status(HkVM *vm);
+static int jit_nil(JitFrame *frame);
+static int jit_false(JitFrame *frame);
+static int jit_true(JitFrame *frame);
+static int jit_int(JitFrame *frame, int data);
+static int jit_constant(JitFrame *frame, int index);
+static int jit_range(JitFrame *frame);
+static int jit_array(JitFrame *frame, int length);
+static int jit_struct(JitFrame *frame, int length);
+static int jit_instance(JitFrame *frame, int numArgs);
+static int jit_construct(JitFrame *frame, int length);
+static int jit_iterator(JitFrame *frame);
+static int jit_closure(JitFrame *frame, int index);
+static int jit_unpack_array(JitFrame *frame, int n);
+static int jit_unpack_struct(JitFrame *frame, int n);
+static int jit_pop(JitFrame *frame);
+static int jit_global(JitFrame *frame, int index);
+static int jit_nonlocal(JitFrame *frame, int index);
+static int jit_get_local(JitFrame *frame, int index);
+static int jit_set_local(JitFrame *frame, int index);
+static int jit_append_element(JitFrame *frame);
+static int jit_get_element(JitFrame *frame);
+static int jit_fetch_element(JitFrame *frame);
+static int jit_set_element(JitFrame *frame);
+static int jit_put_element(JitFrame *frame);
+static int jit_delete_element(JitFrame *frame);
+static int jit_inplace_append_element(JitFrame *frame);
+static int jit_inplace_put_element(JitFrame *frame);
+static int jit_inplace_delete_element(JitFrame *frame);
+static int jit_get_field(JitFrame *frame, int index);
+static int jit_fetch_field(JitFrame *frame, int index);
+static int jit_set_field(JitFrame *frame);
+static int jit_put_field(JitFrame *frame, int index);
+static int jit_inplace_put_field(JitFrame *frame, int index);
+static int jit_current(JitFrame *frame);
+static int jit_jump_if_false(JitFrame *frame);
+static int jit_jump_if_true(JitFrame *frame);
+static int jit_jump_if_true_or_pop(JitFrame *frame);
+static int jit_jump_if_false_or_pop(JitFrame *frame);
+static int jit_jump_if_not_equal(JitFrame *frame);
+static int jit_jump_if_not_valid(JitFrame *frame);
+static int jit_next(JitFrame *frame);
+static int jit_equal(JitFrame *frame);
+static int jit_greater(JitFrame *frame);
+static int jit_less(JitFrame *frame);
+static int jit_not_equal(JitFrame *frame);
+static int jit_not_greater(JitFrame *frame);
+static int jit_not_less(JitFrame *frame);
+static int jit_bitwise_or(JitFrame *frame);
+static int jit_bitwise_xor(JitFrame *frame);
+static int jit_bitwise_and(JitFrame *frame);
+static int jit_left_shift(JitFrame *frame);
+static int jit_right_shift(JitFrame *frame);
+static int jit_add(JitFrame *frame);
+static int jit_subtract(JitFrame *frame);
+static int jit_multiply(JitFrame *frame);
+static int jit_divide(JitFrame *frame);
+static int jit_quotient(JitFrame *frame);
+static int jit_remainder(JitFrame *frame);
+static int jit_negate(JitFrame *frame);
+static int jit_not(JitFrame *frame);
+static int jit_bitwise_not(JitFrame *frame);
+static int jit_increment(JitFrame *frame);
+static int jit_decrement(JitFrame *frame);
+static int jit_call(JitFrame *frame, int numArgs);
+static int jit_load_module(JitFrame *frame);
+static int jit_return_nil(JitFrame *frame);
+static int jit_return_array(JitFrame *frame, int length);
+static int jit_call_unpack(JitFrame *frame, int numArgs, int numResults);
+static int jit_get_element_array_int(JitFrame *frame);
+static int jit_greater_num_num(JitFrame *frame);
+static int jit_less_num_num(JitFrame *frame);
+static int jit_not_greater_num_num(JitFrame *frame);
+static int jit_not_less_num_num(JitFrame *frame);
+static int jit_add_num_num(JitFrame *frame);
+static int jit_subtract_num_num(JitFrame *frame);
+static int jit_multiply_num_num(JitFrame *frame);
+static int jit_get_local_local(JitFrame *frame, int index1, int index2);
+static int jit_get_local_int(JitFrame *frame, int index, int data);
+static int jit_increment_local(JitFrame *frame, int index);
+static int jit_decrement_local(JitFrame *frame, int index);
+static int jit_jump_if_not_less(JitFrame *frame);
+static int jit_jump_if_not_greater(JitFrame *frame);
+static int jit_jump_if_less(JitFrame *frame);
+static int jit_jump_if_greater(JitFrame *frame);
+static int jit_call_pop(JitFrame *frame, int numArgs);
+static int jit_foreach_init(JitFrame *frame);
+static int jit_foreach_next(JitFrame *frame);
+static int jit_foreach_current(JitFrame *frame);
+static int jit_for_loop(JitFrame *frame, int index, int cmp, int data);
+static int jit_for_loop_int(JitFrame *frame, int index, int cmp, int data);
+static int jit_match_int(JitFrame *frame, int offset);
+static int jit_match_string(JitFrame *frame, int offset);
+static int jit_add_unchecked(JitFrame *frame);
+static int jit_subtract_unchecked(JitFrame *frame);
+static int jit_multiply_unchecked(JitFrame *frame);
 
 static inline void type_error(HkVM *vm, int index, int numTypes, HkType types[],
   HkType valType)
@@ -96,9 +226,64 @@ static inline void type_error(HkVM *vm, int index, int numTypes, HkType types[],
   fprintf(stderr, ", %s given\n", hk_type_name(valType));
 }
 
+static inline void stack_reserve(HkVM *vm, int size)
+{
+  // Only address space is reserved up front. Pages are committed as the stack
+  // grows, so the stack never moves and pointers into it stay valid.
+  size_t numBytes = sizeof(HkValue) * size;
+#ifdef _WIN32
+  void *base = VirtualAlloc(NULL, numBytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+  void *base = mmap(NULL, numBytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+    -1, 0);
+  base = base == MAP_FAILED ? NULL : base;
+#endif
+  vm->vstk.base = (HkValue *) base;
+  vm->vstk.top = &vm->vstk.base[-1];
+  vm->stackSize = size;
+  int minSize = size < HK_VM_STACK_MIN_SIZE ? size : HK_VM_STACK_MIN_SIZE;
+  if (!base || !stack_commit(vm, minSize))
+  {
+    fprintf(stderr, "runtime error: out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+static inline bool stack_commit(HkVM *vm, int size)
+{
+  size_t numBytes = sizeof(HkValue) * size;
+#ifdef _WIN32
+  if (!VirtualAlloc(vm->vstk.base, numBytes, MEM_COMMIT, PAGE_READWRITE))
+    return false;
+#else
+  if (mprotect(vm->vstk.base, numBytes, PROT_READ | PROT_WRITE))
+    return false;
+#endif
+  vm->vstk.limit = &vm->vstk.base[size - 1];
+  return true;
+}
+
+static inline void stack_release(HkVM *vm)
+{
+#ifdef _WIN32
+  (void) VirtualFree(vm->vstk.base, 0, MEM_RELEASE);
+#else
+  (void) munmap(vm->vstk.base, sizeof(HkValue) * vm->stackSize);
+#endif
+}
+
+static inline bool grow_stack(HkVM *vm)
+{
+  int size = (int) (vm->vstk.limit - vm->vstk.base) + 1;
+  if (size == vm->stackSize)
+    return false;
+  size = size > vm->stackSize >> 1 ? vm->stackSize : size << 1;
+  return stack_commit(vm, size);
+}
+
 static inline void push(HkVM *vm, HkValue val)
 {
-  if (hk_stack_is_full(&vm->vstk))
+  if (hk_stack_is_full(&vm->vstk) && !grow_stack(vm))
   {
     hk_vm_runtime_error(vm, "stack overflow");
     return;
@@ -276,6 +461,23 @@ static inline void do_iterator(HkVM *vm)
 static inline void do_closure(HkVM *vm, HkFunction *fn)
 {
   int numNonlocals = fn->numNonlocals;
+  if (!numNonlocals)
+  {
+    // Without captures every evaluation would build the same closure, so a
+    // single one is kept in the function and shared.
+    HkClosure *cl = fn->closure;
+    if (!cl)
+    {
+      cl = hk_closure_new(fn);
+      hk_incr_ref(cl);
+      fn->closure = cl;
+    }
+    push(vm, hk_closure_value(cl));
+    if (!hk_vm_is_ok(vm))
+      return;
+    hk_incr_ref(cl);
+    return;
+  }
   HkValue *slots = &hk_stack_get(&vm->vstk, numNonlocals - 1);
   HkClosure *cl = hk_closure_new(fn);
   for (int i = 0; i < numNonlocals; ++i)
@@ -381,9 +583,9 @@ static inline void do_get_element(HkVM *vm)
           index, str->length);
         return;
       }
-      HkValue result = hk_string_value(hk_string_from_chars(1, &str->chars[(int) index]));
-      hk_value_incr_ref(result);
-      slots[0] = result;
+      HkString *result = hk_string_from_char(str->chars[(int) index]);
+      hk_incr_ref(result);
+      slots[0] = hk_string_value(result);
       hk_stack_pop(&vm->vstk);
       hk_string_release(str);
       return;
@@ -401,21 +603,9 @@ static inline void do_get_element(HkVM *vm)
     hk_vm_runtime_error(vm, "type error: %s cannot be indexed", hk_type_name(val1.type));
     return;
   }
-  HkArray *arr = hk_as_array(val1);
   if (hk_is_int(val2))
   {
-    int64_t index = (int64_t) hk_as_number(val2);
-    if (index < 0 || index >= arr->length)
-    {
-      hk_vm_runtime_error(vm, "range error: index %d is out of bounds for array of length %d",
-        index, arr->length);
-      return;
-    }
-    HkValue result = hk_array_get_element(arr, (int) index);
-    hk_value_incr_ref(result);
-    slots[0] = result;
-    hk_stack_pop(&vm->vstk);
-    hk_array_release(arr);
+    do_get_element_array_int(vm);
     return;
   }
   if (!hk_is_range(val2))
@@ -423,7 +613,25 @@ static inline void do_get_element(HkVM *vm)
     hk_vm_runtime_error(vm, "type error: array cannot be indexed by %s", hk_type_name(val2.type));
     return;
   }
-  slice_array(vm, slots, arr, hk_as_range(val2));
+  slice_array(vm, slots, hk_as_array(val1), hk_as_range(val2));
+}
+
+static inline void do_get_element_array_int(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  HkArray *arr = hk_as_array(slots[0]);
+  int64_t index = (int64_t) hk_as_number(slots[1]);
+  if (index < 0 || index >= arr->length)
+  {
+    hk_vm_runtime_error(vm, "range error: index %d is out of bounds for array of length %d",
+      index, arr->length);
+    return;
+  }
+  HkValue result = hk_array_get_element(arr, (int) index);
+  hk_value_incr_ref(result);
+  slots[0] = result;
+  hk_stack_pop(&vm->vstk);
+  hk_array_release(arr);
 }
 
 static inline void slice_string(HkVM *vm, HkValue *slot, HkString *str, HkRange *range)
@@ -444,7 +652,8 @@ static inline void slice_string(HkVM *vm, HkValue *slot, HkString *str, HkRange
     return;
   }
   int length = (int) (end - start + 1);
-  result = hk_string_from_chars(length, &str->chars[start]);
+  result = length == 1 ? hk_string_from_char(str->chars[start])
+    : hk_string_from_chars(length, &str->chars[start]);
 end:
   hk_incr_ref(result);
   *slot = hk_string_value(result);
@@ -845,6 +1054,85 @@ static inline void do_next(HkVM *vm)
   hk_iterator_release(it);
 }
 
+static inline void do_foreach_init(HkVM *vm)
+{
+  HkValue val = hk_stack_get(&vm->vstk, 0);
+  if (hk_is_range(val))
+  {
+    push(vm, hk_number_value((double) hk_as_range(val)->start));
+    return;
+  }
+  if (hk_is_array(val))
+  {
+    push(vm, hk_number_value(0));
+    return;
+  }
+  do_iterator(vm);
+  if (!hk_vm_is_ok(vm))
+    return;
+  push(vm, hk_nil_value());
+}
+
+static inline void do_foreach_next(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  HkValue val = slots[0];
+  if (hk_is_range(val))
+  {
+    slots[1].as.number += hk_as_range(val)->step;
+    return;
+  }
+  if (hk_is_array(val))
+  {
+    ++slots[1].as.number;
+    return;
+  }
+  HkIterator *it = hk_as_iterator(val);
+  if (it->refCount <= 2)
+  {
+    hk_iterator_inplace_next(it);
+    return;
+  }
+  HkIterator *result = hk_iterator_next(it);
+  hk_incr_ref(result);
+  slots[0] = hk_iterator_value(result);
+  hk_iterator_release(it);
+}
+
+static inline bool do_foreach_current(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 2);
+  HkValue val = slots[1];
+  HkValue result;
+  if (hk_is_range(val))
+  {
+    HkRange *range = hk_as_range(val);
+    int64_t current = (int64_t) slots[2].as.number;
+    if (range->step == 1 ? current > range->end : current < range->end)
+      return false;
+    result = slots[2];
+  }
+  else if (hk_is_array(val))
+  {
+    HkArray *arr = hk_as_array(val);
+    int index = (int) slots[2].as.number;
+    if (index >= arr->length)
+      return false;
+    result = arr->elements[index];
+  }
+  else
+  {
+    HkIterator *it = hk_as_iterator(val);
+    if (!hk_iterator_is_valid(it))
+      return false;
+    result = hk_iterator_get_current(it);
+  }
+  hk_value_incr_ref(result);
+  hk_value_release(slots[0]);
+  slots[0] = result;
+  return true;
+}
+
 static inline void do_equal(HkVM *vm)
 {
   HkValue *slots = &hk_stack_get(&vm->vstk, 1);
@@ -1292,7 +1580,154 @@ static inline void do_decrement(HkVM *vm)
   --slots[0].as.number;
 }
 
-static inline void do_call(HkVM *vm, int numArgs)
+static inline bool is_num_num(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  return hk_is_number(slots[0]) && hk_is_number(slots[1]);
+}
+
+static inline bool is_array_int(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  return hk_is_array(slots[0]) && hk_is_int(slots[1]);
+}
+
+static inline int compare_numbers(double num1, double num2)
+{
+  if (fabs(num1 - num2) < HK_NUMBER_EPSILON)
+    return 0;
+  return num1 > num2 ? 1 : -1;
+}
+
+static inline void do_greater_num_num(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  int result = compare_numbers(hk_as_number(slots[0]), hk_as_number(slots[1]));
+  slots[0] = hk_bool_value(result > 0);
+  hk_stack_pop(&vm->vstk);
+}
+
+static inline void do_less_num_num(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  int result = compare_numbers(hk_as_number(slots[0]), hk_as_number(slots[1]));
+  slots[0] = hk_bool_value(result < 0);
+  hk_stack_pop(&vm->vstk);
+}
+
+static inline void do_not_greater_num_num(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  int result = compare_numbers(hk_as_number(slots[0]), hk_as_number(slots[1]));
+  slots[0] = hk_bool_value(result <= 0);
+  hk_stack_pop(&vm->vstk);
+}
+
+static inline void do_not_less_num_num(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  int result = compare_numbers(hk_as_number(slots[0]), hk_as_number(slots[1]));
+  slots[0] = hk_bool_value(result >= 0);
+  hk_stack_pop(&vm->vstk);
+}
+
+static inline void do_add_num_num(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  double data = hk_as_number(slots[0]) + hk_as_number(slots[1]);
+  slots[0] = hk_number_value(data);
+  hk_stack_pop(&vm->vstk);
+}
+
+static inline void do_subtract_num_num(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  double data = hk_as_number(slots[0]) - hk_as_number(slots[1]);
+  slots[0] = hk_number_value(data);
+  hk_stack_pop(&vm->vstk);
+}
+
+static inline void do_multiply_num_num(HkVM *vm)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  double data = hk_as_number(slots[0]) * hk_as_number(slots[1]);
+  slots[0] = hk_number_value(data);
+  hk_stack_pop(&vm->vstk);
+}
+
+static inline void do_increment_local(HkVM *vm, HkValue *slot)
+{
+  if (!hk_is_number(*slot))
+  {
+    hk_vm_runtime_error(vm, "type error: cannot increment value of type %s",
+      hk_type_name(slot->type));
+    return;
+  }
+  ++slot->as.number;
+}
+
+static inline void do_decrement_local(HkVM *vm, HkValue *slot)
+{
+  if (!hk_is_number(*slot))
+  {
+    hk_vm_runtime_error(vm, "type error: cannot decrement value of type %s",
+      hk_type_name(slot->type));
+    return;
+  }
+  --slot->as.number;
+}
+
+static inline void do_compare(HkVM *vm, int *result)
+{
+  HkValue *slots = &hk_stack_get(&vm->vstk, 1);
+  HkValue val1 = slots[0];
+  HkValue val2 = slots[1];
+  if (hk_is_number(val1) && hk_is_number(val2))
+  {
+    *result = compare_numbers(hk_as_number(val1), hk_as_number(val2));
+    vm->vstk.top -= 2;
+    return;
+  }
+  hk_vm_compare(vm, val1, val2, result);
+  hk_return_if_not_ok(vm);
+  vm->vstk.top -= 2;
+  hk_value_release(val1);
+  hk_value_release(val2);
+}
+
+static inline bool do_for_loop(HkVM *vm, HkValue *slot, HkOpCode op, HkValue bound)
+{
+  bool down = op == HK_OP_GREATER || op == HK_OP_NOT_LESS;
+  if (down)
+    do_decrement_local(vm, slot);
+  else
+    do_increment_local(vm, slot);
+  if (!hk_vm_is_ok(vm))
+    return false;
+  int result;
+  if (hk_is_number(bound))
+    result = compare_numbers(hk_as_number(*slot), hk_as_number(bound));
+  else
+  {
+    hk_vm_compare(vm, *slot, bound, &result);
+    if (!hk_vm_is_ok(vm))
+      return false;
+  }
+  switch (op)
+  {
+  case HK_OP_LESS:
+    return result < 0;
+  case HK_OP_NOT_GREATER:
+    return result <= 0;
+  case HK_OP_GREATER:
+    return result > 0;
+  default:
+    break;
+  }
+  return result >= 0;
+}
+
+static inline bool call_value(HkVM *vm, int numArgs, int numResults)
 {
   HkValue *slots = &hk_stack_get(&vm->vstk, numArgs);
   HkValue val = slots[0];
@@ -1301,7 +1736,7 @@ static inline void do_call(HkVM *vm, int numArgs)
     hk_vm_runtime_error(vm, "type error: cannot call value of type %s",
       hk_type_name(val.type));
     discard_frame(vm, slots);
-    return;
+    return false;
   }
   if (hk_is_native(val))
   {
@@ -1310,7 +1745,7 @@ static inline void do_call(HkVM *vm, int numArgs)
     if (!hk_vm_is_ok(vm))
     {
       discard_frame(vm, slots);
-      return;
+      return false;
     }
     native->call(vm, slots);
     HkSateStatus status = vm->status;
@@ -1319,20 +1754,20 @@ static inline void do_call(HkVM *vm, int numArgs)
       if (hk_vm_is_no_trace(vm))
       {
         if (hk_vm_is_error(vm))
-          vm->flags = HK_VM_FLAG_NONE;
+          vm->flags &= ~HK_VM_FLAG_NO_TRACE;
       }
       else
         print_trace(native->name, NULL, 0);
       if (status == HK_VM_STATUS_ERROR)
       {
         discard_frame(vm, slots);
-        return;
+        return false;
       }
       hk_assert(status == HK_VM_STATUS_EXIT, "status should be exit");
     }
     hk_native_release(native);
     move_result(vm, slots);
-    return;
+    return false;
   }
   HkClosure *cl = hk_as_closure(val);
   HkFunction *fn = cl->fn;
@@ -1340,29 +1775,59 @@ static inline void do_call(HkVM *vm, int numArgs)
   if (!hk_vm_is_ok(vm))
   {
     discard_frame(vm, slots);
-    return;
+    return false;
+  }
+  // Every call nests the native stack too, so its depth is bounded well before
+  // the value stack runs out.
+  if (vm->depth == HK_VM_MAX_DEPTH)
+  {
+    hk_vm_runtime_error(vm, "stack overflow");
+    discard_frame(vm, slots);
+    return false;
   }
   int line;
-  call_function(vm, slots, cl, &line);
+  ++vm->depth;
+  bool unpacked = call_function(vm, slots, cl, numResults, &line);
+  --vm->depth;
   HkSateStatus status = vm->status;
   if (status != HK_VM_STATUS_OK)
   {
     if (hk_vm_is_no_trace(vm))
     {
       if (hk_vm_is_error(vm))
-        vm->flags = HK_VM_FLAG_NONE;
+        vm->flags &= ~HK_VM_FLAG_NO_TRACE;
     }
     else
       print_trace(fn->name, fn->file, line);
     if (status == HK_VM_STATUS_ERROR)
     {
       discard_frame(vm, slots);
-      return;
+      return false;
     }
     hk_assert(status == HK_VM_STATUS_EXIT, "status should be exit");
   }
   hk_closure_release(cl);
+  if (unpacked)
+  {
+    move_results(vm, slots, numResults);
+    return true;
+  }
   move_result(vm, slots);
+  return false;
+}
+
+static inline void do_call(HkVM *vm, int numArgs)
+{
+  (void) call_value(vm, numArgs, 0);
+}
+
+static inline void do_call_unpack(HkVM *vm, int numArgs, int numResults)
+{
+  // A callee returning an array literal of the right length leaves the
+  // elements in place, so there is nothing left to unpack.
+  if (call_value(vm, numArgs, numResults) || !hk_vm_is_ok(vm))
+    return;
+  do_unpack_array(vm, numResults);
 }
 
 static inline void adjust_call_args(HkVM *vm, int arity, int numArgs)
@@ -1396,69 +1861,1011 @@ static inline void print_trace(HkString *name, HkString *file, int line)
   fprintf(stderr, "  at %s() in <native>\n", nameChars);
 }
 
-static inline void call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int *line)
+static inline int jit_status(HkVM *vm)
 {
-  HkValue *globals = vm->vstk.base;
-  HkFunction *fn = cl->fn;
-  HkValue *nonlocals = cl->nonlocals;
-  HkChunk *chunk = &fn->chunk;
-  uint8_t *code = chunk->code;
-  HkValue *consts = chunk->consts->elements;
-  HkFunction **functions = fn->functions;
-  uint8_t *pc = code;
-  for (;;)
-  {
-    HkOpCode op = (HkOpCode) read_byte(&pc);
-    switch (op)
-    {
-    case HK_OP_NIL:
-      push(vm, hk_nil_value());
-      if (!hk_vm_is_ok(vm))
-        goto end;
-      break;
-    case HK_OP_FALSE:
-      push(vm, hk_bool_value(false));
-      if (!hk_vm_is_ok(vm))
-        goto end;
-      break;
-    case HK_OP_TRUE:
-      push(vm, hk_bool_value(true));
-      if (!hk_vm_is_ok(vm))
-        goto end;
-      break;
-    case HK_OP_INT:
-      push(vm, hk_number_value(read_word(&pc)));
-      if (!hk_vm_is_ok(vm))
-        goto end;
-      break;
-    case HK_OP_CONSTANT:
-      {
-        HkValue val = consts[read_byte(&pc)];
-        push(vm, val);
-        if (!hk_vm_is_ok(vm))
-          goto end;
-        hk_value_incr_ref(val);
-      }
-      break;
-    case HK_OP_RANGE:
-      do_range(vm);
-      if (!hk_vm_is_ok(vm))
-        goto end;
-      break;
-    case HK_OP_ARRAY:
-      do_array(vm, read_byte(&pc));
-      if (!hk_vm_is_ok(vm))
-        goto end;
-      break;
-    case HK_OP_STRUCT:
-      do_struct(vm, read_byte(&pc));
-      if (!hk_vm_is_ok(vm))
-        goto end;
-      break;
-    case HK_OP_INSTANCE:
-      do_instance(vm, read_byte(&pc));
-      if (!hk_vm_is_ok(vm))
-        goto end;
+  return hk_vm_is_ok(vm) ? JIT_NEXT : JIT_ERROR;
+}
+
+static int jit_nil(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  push(vm, hk_nil_value());
+  return jit_status(vm);
+}
+
+static int jit_false(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  push(vm, hk_bool_value(false));
+  return jit_status(vm);
+}
+
+static int jit_true(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  push(vm, hk_bool_value(true));
+  return jit_status(vm);
+}
+
+static int jit_int(JitFrame *frame, int data)
+{
+  HkVM *vm = frame->vm;
+  push(vm, hk_number_value(data));
+  return jit_status(vm);
+}
+
+static int jit_constant(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  HkValue val = frame->consts[index];
+  push(vm, val);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  hk_value_incr_ref(val);
+  return JIT_NEXT;
+}
+
+static int jit_range(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_range(vm);
+  return jit_status(vm);
+}
+
+static int jit_array(JitFrame *frame, int length)
+{
+  HkVM *vm = frame->vm;
+  do_array(vm, length);
+  return jit_status(vm);
+}
+
+static int jit_struct(JitFrame *frame, int length)
+{
+  HkVM *vm = frame->vm;
+  do_struct(vm, length);
+  return jit_status(vm);
+}
+
+static int jit_instance(JitFrame *frame, int numArgs)
+{
+  HkVM *vm = frame->vm;
+  do_instance(vm, numArgs);
+  return jit_status(vm);
+}
+
+static int jit_construct(JitFrame *frame, int length)
+{
+  HkVM *vm = frame->vm;
+  do_construct(vm, length);
+  return jit_status(vm);
+}
+
+static int jit_iterator(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_iterator(vm);
+  return jit_status(vm);
+}
+
+static int jit_closure(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  do_closure(vm, frame->fn->functions[index]);
+  return jit_status(vm);
+}
+
+static int jit_unpack_array(JitFrame *frame, int n)
+{
+  HkVM *vm = frame->vm;
+  do_unpack_array(vm, n);
+  return jit_status(vm);
+}
+
+static int jit_unpack_struct(JitFrame *frame, int n)
+{
+  HkVM *vm = frame->vm;
+  do_unpack_struct(vm, n);
+  return jit_status(vm);
+}
+
+static int jit_pop(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  pop(vm);
+  return JIT_NEXT;
+}
+
+static int jit_global(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  HkValue val = vm->vstk.base[index];
+  if (hk_is_nil(val))
+    val = load_global(vm, index);
+  push(vm, val);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  hk_value_incr_ref(val);
+  return JIT_NEXT;
+}
+
+static int jit_nonlocal(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  HkValue val = frame->nonlocals[index];
+  push(vm, val);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  hk_value_incr_ref(val);
+  return JIT_NEXT;
+}
+
+static int jit_get_local(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  HkValue val = frame->locals[index];
+  push(vm, val);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  hk_value_incr_ref(val);
+  return JIT_NEXT;
+}
+
+static int jit_set_local(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  HkValue *locals = frame->locals;
+  HkValue val = hk_stack_get(&vm->vstk, 0);
+  hk_stack_pop(&vm->vstk);
+  hk_value_release(locals[index]);
+  locals[index] = val;
+  return JIT_NEXT;
+}
+
+static int jit_append_element(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_append_element(vm);
+  return jit_status(vm);
+}
+
+static int jit_get_element(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  if (is_array_int(vm))
+    do_get_element_array_int(vm);
+  else
+    do_get_element(vm);
+  return jit_status(vm);
+}
+
+static int jit_fetch_element(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_fetch_element(vm);
+  return jit_status(vm);
+}
+
+static int jit_set_element(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_set_element(vm);
+  return JIT_NEXT;
+}
+
+static int jit_put_element(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_put_element(vm);
+  return jit_status(vm);
+}
+
+static int jit_delete_element(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_delete_element(vm);
+  return jit_status(vm);
+}
+
+static int jit_inplace_append_element(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_inplace_append_element(vm);
+  return jit_status(vm);
+}
+
+static int jit_inplace_put_element(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_inplace_put_element(vm);
+  return jit_status(vm);
+}
+
+static int jit_inplace_delete_element(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_inplace_delete_element(vm);
+  return jit_status(vm);
+}
+
+static int jit_get_field(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  do_get_field(vm, hk_as_string(frame->consts[index]));
+  return jit_status(vm);
+}
+
+static int jit_fetch_field(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  do_fetch_field(vm, hk_as_string(frame->consts[index]));
+  return jit_status(vm);
+}
+
+static int jit_set_field(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_set_field(vm);
+  return JIT_NEXT;
+}
+
+static int jit_put_field(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  do_put_field(vm, hk_as_string(frame->consts[index]));
+  return jit_status(vm);
+}
+
+static int jit_inplace_put_field(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  do_inplace_put_field(vm, hk_as_string(frame->consts[index]));
+  return jit_status(vm);
+}
+
+static int jit_current(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_current(vm);
+  return JIT_NEXT;
+}
+
+static int jit_jump_if_false(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  HkValue val = hk_stack_get(&vm->vstk, 0);
+  int result = hk_is_falsey(val) ? JIT_JUMP : JIT_NEXT;
+  hk_value_release(val);
+  hk_stack_pop(&vm->vstk);
+  return result;
+}
+
+static int jit_jump_if_true(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  HkValue val = hk_stack_get(&vm->vstk, 0);
+  int result = hk_is_truthy(val) ? JIT_JUMP : JIT_NEXT;
+  hk_value_release(val);
+  hk_stack_pop(&vm->vstk);
+  return result;
+}
+
+static int jit_jump_if_true_or_pop(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  HkValue val = hk_stack_get(&vm->vstk, 0);
+  if (hk_is_truthy(val))
+    return JIT_JUMP;
+  hk_value_release(val);
+  hk_stack_pop(&vm->vstk);
+  return JIT_NEXT;
+}
+
+static int jit_jump_if_false_or_pop(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  HkValue val = hk_stack_get(&vm->vstk, 0);
+  if (hk_is_falsey(val))
+    return JIT_JUMP;
+  hk_value_release(val);
+  hk_stack_pop(&vm->vstk);
+  return JIT_NEXT;
+}
+
+static int jit_jump_if_not_equal(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  HkValue val1 = hk_stack_get(&vm->vstk, 1);
+  HkValue val2 = hk_stack_get(&vm->vstk, 0);
+  if (hk_value_equal(val1, val2))
+  {
+    hk_value_release(val1);
+    hk_value_release(val2);
+    vm->vstk.top -= 2;
+    return JIT_NEXT;
+  }
+  hk_value_release(val2);
+  hk_stack_pop(&vm->vstk);
+  return JIT_JUMP;
+}
+
+static int jit_jump_if_not_valid(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  HkIterator *it = hk_as_iterator(hk_stack_get(&vm->vstk, 0));
+  return hk_iterator_is_valid(it) ? JIT_NEXT : JIT_JUMP;
+}
+
+static int jit_next(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_next(vm);
+  return JIT_NEXT;
+}
+
+static int jit_equal(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_equal(vm);
+  return JIT_NEXT;
+}
+
+static int jit_greater(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_greater(vm);
+  return jit_status(vm);
+}
+
+static int jit_less(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_less(vm);
+  return jit_status(vm);
+}
+
+static int jit_not_equal(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_not_equal(vm);
+  return JIT_NEXT;
+}
+
+static int jit_not_greater(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_not_greater(vm);
+  return jit_status(vm);
+}
+
+static int jit_not_less(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_not_less(vm);
+  return jit_status(vm);
+}
+
+static int jit_bitwise_or(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_bitwise_or(vm);
+  return jit_status(vm);
+}
+
+static int jit_bitwise_xor(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_bitwise_xor(vm);
+  return jit_status(vm);
+}
+
+static int jit_bitwise_and(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_bitwise_and(vm);
+  return jit_status(vm);
+}
+
+static int jit_left_shift(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_left_shift(vm);
+  return jit_status(vm);
+}
+
+static int jit_right_shift(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_right_shift(vm);
+  return jit_status(vm);
+}
+
+static int jit_add(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_add(vm);
+  return jit_status(vm);
+}
+
+static int jit_subtract(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_subtract(vm);
+  return jit_status(vm);
+}
+
+static int jit_multiply(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_multiply(vm);
+  return jit_status(vm);
+}
+
+static int jit_divide(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_divide(vm);
+  return jit_status(vm);
+}
+
+static int jit_quotient(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_quotient(vm);
+  return jit_status(vm);
+}
+
+static int jit_remainder(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_remainder(vm);
+  return jit_status(vm);
+}
+
+static int jit_negate(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_negate(vm);
+  return jit_status(vm);
+}
+
+static int jit_not(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_not(vm);
+  return JIT_NEXT;
+}
+
+static int jit_bitwise_not(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_bitwise_not(vm);
+  return jit_status(vm);
+}
+
+static int jit_increment(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_increment(vm);
+  return jit_status(vm);
+}
+
+static int jit_decrement(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_decrement(vm);
+  return jit_status(vm);
+}
+
+static int jit_call(JitFrame *frame, int numArgs)
+{
+  HkVM *vm = frame->vm;
+  do_call(vm, numArgs);
+  return jit_status(vm);
+}
+
+static int jit_load_module(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  module_load(vm, frame->fn->file);
+  return jit_status(vm);
+}
+
+static int jit_return_nil(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  push(vm, hk_nil_value());
+  return jit_status(vm);
+}
+
+static int jit_return_array(JitFrame *frame, int length)
+{
+  HkVM *vm = frame->vm;
+  if (frame->numResults && length == frame->numResults)
+  {
+    frame->unpacked = true;
+    return JIT_NEXT;
+  }
+  do_array(vm, length);
+  return jit_status(vm);
+}
+
+static int jit_call_unpack(JitFrame *frame, int numArgs, int numResults)
+{
+  HkVM *vm = frame->vm;
+  do_call_unpack(vm, numArgs, numResults);
+  return jit_status(vm);
+}
+
+static int jit_get_element_array_int(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  if (is_array_int(vm))
+    do_get_element_array_int(vm);
+  else
+    do_get_element(vm);
+  return jit_status(vm);
+}
+
+static int jit_greater_num_num(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  if (!is_num_num(vm))
+  {
+    do_greater(vm);
+    return jit_status(vm);
+  }
+  do_greater_num_num(vm);
+  return JIT_NEXT;
+}
+
+static int jit_less_num_num(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  if (!is_num_num(vm))
+  {
+    do_less(vm);
+    return jit_status(vm);
+  }
+  do_less_num_num(vm);
+  return JIT_NEXT;
+}
+
+static int jit_not_greater_num_num(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  if (!is_num_num(vm))
+  {
+    do_not_greater(vm);
+    return jit_status(vm);
+  }
+  do_not_greater_num_num(vm);
+  return JIT_NEXT;
+}
+
+static int jit_not_less_num_num(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  if (!is_num_num(vm))
+  {
+    do_not_less(vm);
+    return jit_status(vm);
+  }
+  do_not_less_num_num(vm);
+  return JIT_NEXT;
+}
+
+static int jit_add_num_num(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  if (!is_num_num(vm))
+  {
+    do_add(vm);
+    return jit_status(vm);
+  }
+  do_add_num_num(vm);
+  return JIT_NEXT;
+}
+
+static int jit_subtract_num_num(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  if (!is_num_num(vm))
+  {
+    do_subtract(vm);
+    return jit_status(vm);
+  }
+  do_subtract_num_num(vm);
+  return JIT_NEXT;
+}
+
+static int jit_multiply_num_num(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  if (!is_num_num(vm))
+  {
+    do_multiply(vm);
+    return jit_status(vm);
+  }
+  do_multiply_num_num(vm);
+  return JIT_NEXT;
+}
+
+static int jit_get_local_local(JitFrame *frame, int index1, int index2)
+{
+  HkVM *vm = frame->vm;
+  HkValue *locals = frame->locals;
+  HkValue val1 = locals[index1];
+  push(vm, val1);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  hk_value_incr_ref(val1);
+  HkValue val2 = locals[index2];
+  push(vm, val2);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  hk_value_incr_ref(val2);
+  return JIT_NEXT;
+}
+
+static int jit_get_local_int(JitFrame *frame, int index, int data)
+{
+  HkVM *vm = frame->vm;
+  HkValue val = frame->locals[index];
+  push(vm, val);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  hk_value_incr_ref(val);
+  push(vm, hk_number_value(data));
+  return jit_status(vm);
+}
+
+static int jit_increment_local(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  do_increment_local(vm, &frame->locals[index]);
+  return jit_status(vm);
+}
+
+static int jit_decrement_local(JitFrame *frame, int index)
+{
+  HkVM *vm = frame->vm;
+  do_decrement_local(vm, &frame->locals[index]);
+  return jit_status(vm);
+}
+
+static int jit_jump_if_not_less(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  int result;
+  do_compare(vm, &result);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  return result >= 0 ? JIT_JUMP : JIT_NEXT;
+}
+
+static int jit_jump_if_not_greater(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  int result;
+  do_compare(vm, &result);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  return result <= 0 ? JIT_JUMP : JIT_NEXT;
+}
+
+static int jit_jump_if_less(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  int result;
+  do_compare(vm, &result);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  return result < 0 ? JIT_JUMP : JIT_NEXT;
+}
+
+static int jit_jump_if_greater(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  int result;
+  do_compare(vm, &result);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  return result > 0 ? JIT_JUMP : JIT_NEXT;
+}
+
+static int jit_call_pop(JitFrame *frame, int numArgs)
+{
+  HkVM *vm = frame->vm;
+  do_call(vm, numArgs);
+  if (!hk_vm_is_ok(vm))
+    return JIT_ERROR;
+  pop(vm);
+  return JIT_NEXT;
+}
+
+static int jit_foreach_init(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_foreach_init(vm);
+  return jit_status(vm);
+}
+
+static int jit_foreach_next(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_foreach_next(vm);
+  return JIT_NEXT;
+}
+
+static int jit_foreach_current(JitFrame *frame)
+{
+  return do_foreach_current(frame->vm) ? JIT_NEXT : JIT_JUMP;
+}
+
+static int jit_for_loop(JitFrame *frame, int index, int cmp, int data)
+{
+  HkVM *vm = frame->vm;
+  if (do_for_loop(vm, &frame->locals[index], (HkOpCode) cmp, frame->locals[data]))
+    return JIT_JUMP;
+  return jit_status(vm);
+}
+
+static int jit_for_loop_int(JitFrame *frame, int index, int cmp, int data)
+{
+  HkVM *vm = frame->vm;
+  if (do_for_loop(vm, &frame->locals[index], (HkOpCode) cmp, hk_number_value(data)))
+    return JIT_JUMP;
+  return jit_status(vm);
+}
+
+static int jit_match_int(JitFrame *frame, int offset)
+{
+  HkVM *vm = frame->vm;
+  uint8_t *pc = &frame->code[offset + 1];
+  int fallback = read_word(&pc);
+  int min = read_word(&pc);
+  int size = read_word(&pc);
+  uint16_t *targets = (uint16_t *) pc;
+  HkValue val = hk_stack_get(&vm->vstk, 0);
+  if (!hk_is_number(val))
+    return fallback;
+  double data = hk_as_number(val) - min;
+  if (!(data >= 0 && data < size))
+    return fallback;
+  int index = (int) data;
+  if (index != data || targets[index] == fallback)
+    return fallback;
+  hk_stack_pop(&vm->vstk);
+  return targets[index];
+}
+
+static int jit_match_string(JitFrame *frame, int offset)
+{
+  HkVM *vm = frame->vm;
+  uint8_t *pc = &frame->code[offset + 1];
+  int fallback = read_word(&pc);
+  uint32_t seed = read_word(&pc);
+  int bits = read_byte(&pc);
+  HkValue val = hk_stack_get(&vm->vstk, 0);
+  if (!hk_is_string(val))
+    return fallback;
+  HkString *str = hk_as_string(val);
+  uint8_t *entry = &pc[hk_match_slot(hk_string_hash(str), seed, bits) * 3];
+  int target = *((uint16_t *) &entry[1]);
+  if (target == fallback || !hk_string_equal(str, hk_as_string(frame->consts[entry[0]])))
+    return fallback;
+  hk_stack_pop(&vm->vstk);
+  hk_string_release(str);
+  return target;
+}
+
+static int jit_add_unchecked(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_add_num_num(vm);
+  return JIT_NEXT;
+}
+
+static int jit_subtract_unchecked(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_subtract_num_num(vm);
+  return JIT_NEXT;
+}
+
+static int jit_multiply_unchecked(JitFrame *frame)
+{
+  HkVM *vm = frame->vm;
+  do_multiply_num_num(vm);
+  return JIT_NEXT;
+}
+
+static JitHelper jitHelpers[] = {
+  [HK_OP_NIL] = (JitHelper) jit_nil,
+  [HK_OP_FALSE] = (JitHelper) jit_false,
+  [HK_OP_TRUE] = (JitHelper) jit_true,
+  [HK_OP_INT] = (JitHelper) jit_int,
+  [HK_OP_CONSTANT] = (JitHelper) jit_constant,
+  [HK_OP_RANGE] = (JitHelper) jit_range,
+  [HK_OP_ARRAY] = (JitHelper) jit_array,
+  [HK_OP_STRUCT] = (JitHelper) jit_struct,
+  [HK_OP_INSTANCE] = (JitHelper) jit_instance,
+  [HK_OP_CONSTRUCT] = (JitHelper) jit_construct,
+  [HK_OP_ITERATOR] = (JitHelper) jit_iterator,
+  [HK_OP_CLOSURE] = (JitHelper) jit_closure,
+  [HK_OP_UNPACK_ARRAY] = (JitHelper) jit_unpack_array,
+  [HK_OP_UNPACK_STRUCT] = (JitHelper) jit_unpack_struct,
+  [HK_OP_POP] = (JitHelper) jit_pop,
+  [HK_OP_GLOBAL] = (JitHelper) jit_global,
+  [HK_OP_NONLOCAL] = (JitHelper) jit_nonlocal,
+  [HK_OP_GET_LOCAL] = (JitHelper) jit_get_local,
+  [HK_OP_SET_LOCAL] = (JitHelper) jit_set_local,
+  [HK_OP_APPEND_ELEMENT] = (JitHelper) jit_append_element,
+  [HK_OP_GET_ELEMENT] = (JitHelper) jit_get_element,
+  [HK_OP_FETCH_ELEMENT] = (JitHelper) jit_fetch_element,
+  [HK_OP_SET_ELEMENT] = (JitHelper) jit_set_element,
+  [HK_OP_PUT_ELEMENT] = (JitHelper) jit_put_element,
+  [HK_OP_DELETE_ELEMENT] = (JitHelper) jit_delete_element,
+  [HK_OP_INPLACE_APPEND_ELEMENT] = (JitHelper) jit_inplace_append_element,
+  [HK_OP_INPLACE_PUT_ELEMENT] = (JitHelper) jit_inplace_put_element,
+  [HK_OP_INPLACE_DELETE_ELEMENT] = (JitHelper) jit_inplace_delete_element,
+  [HK_OP_GET_FIELD] = (JitHelper) jit_get_field,
+  [HK_OP_FETCH_FIELD] = (JitHelper) jit_fetch_field,
+  [HK_OP_SET_FIELD] = (JitHelper) jit_set_field,
+  [HK_OP_PUT_FIELD] = (JitHelper) jit_put_field,
+  [HK_OP_INPLACE_PUT_FIELD] = (JitHelper) jit_inplace_put_field,
+  [HK_OP_CURRENT] = (JitHelper) jit_current,
+  [HK_OP_JUMP_IF_FALSE] = (JitHelper) jit_jump_if_false,
+  [HK_OP_JUMP_IF_TRUE] = (JitHelper) jit_jump_if_true,
+  [HK_OP_JUMP_IF_TRUE_OR_POP] = (JitHelper) jit_jump_if_true_or_pop,
+  [HK_OP_JUMP_IF_FALSE_OR_POP] = (JitHelper) jit_jump_if_false_or_pop,
+  [HK_OP_JUMP_IF_NOT_EQUAL] = (JitHelper) jit_jump_if_not_equal,
+  [HK_OP_JUMP_IF_NOT_VALID] = (JitHelper) jit_jump_if_not_valid,
+  [HK_OP_NEXT] = (JitHelper) jit_next,
+  [HK_OP_EQUAL] = (JitHelper) jit_equal,
+  [HK_OP_GREATER] = (JitHelper) jit_greater,
+  [HK_OP_LESS] = (JitHelper) jit_less,
+  [HK_OP_NOT_EQUAL] = (JitHelper) jit_not_equal,
+  [HK_OP_NOT_GREATER] = (JitHelper) jit_not_greater,
+  [HK_OP_NOT_LESS] = (JitHelper) jit_not_less,
+  [HK_OP_BITWISE_OR] = (JitHelper) jit_bitwise_or,
+  [HK_OP_BITWISE_XOR] = (JitHelper) jit_bitwise_xor,
+  [HK_OP_BITWISE_AND] = (JitHelper) jit_bitwise_and,
+  [HK_OP_LEFT_SHIFT] = (JitHelper) jit_left_shift,
+  [HK_OP_RIGHT_SHIFT] = (JitHelper) jit_right_shift,
+  [HK_OP_ADD] = (JitHelper) jit_add,
+  [HK_OP_SUBTRACT] = (JitHelper) jit_subtract,
+  [HK_OP_MULTIPLY] = (JitHelper) jit_multiply,
+  [HK_OP_DIVIDE] = (JitHelper) jit_divide,
+  [HK_OP_QUOTIENT] = (JitHelper) jit_quotient,
+  [HK_OP_REMAINDER] = (JitHelper) jit_remainder,
+  [HK_OP_NEGATE] = (JitHelper) jit_negate,
+  [HK_OP_NOT] = (JitHelper) jit_not,
+  [HK_OP_BITWISE_NOT] = (JitHelper) jit_bitwise_not,
+  [HK_OP_INCREMENT] = (JitHelper) jit_increment,
+  [HK_OP_DECREMENT] = (JitHelper) jit_decrement,
+  [HK_OP_CALL] = (JitHelper) jit_call,
+  [HK_OP_LOAD_MODULE] = (JitHelper) jit_load_module,
+  [HK_OP_RETURN_NIL] = (JitHelper) jit_return_nil,
+  [HK_OP_GET_ELEMENT_ARRAY_INT] = (JitHelper) jit_get_element_array_int,
+  [HK_OP_GREATER_NUM_NUM] = (JitHelper) jit_greater_num_num,
+  [HK_OP_LESS_NUM_NUM] = (JitHelper) jit_less_num_num,
+  [HK_OP_NOT_GREATER_NUM_NUM] = (JitHelper) jit_not_greater_num_num,
+  [HK_OP_NOT_LESS_NUM_NUM] = (JitHelper) jit_not_less_num_num,
+  [HK_OP_ADD_NUM_NUM] = (JitHelper) jit_add_num_num,
+  [HK_OP_SUBTRACT_NUM_NUM] = (JitHelper) jit_subtract_num_num,
+  [HK_OP_MULTIPLY_NUM_NUM] = (JitHelper) jit_multiply_num_num,
+  [HK_OP_GET_LOCAL_LOCAL] = (JitHelper) jit_get_local_local,
+  [HK_OP_GET_LOCAL_INT] = (JitHelper) jit_get_local_int,
+  [HK_OP_INCREMENT_LOCAL] = (JitHelper) jit_increment_local,
+  [HK_OP_DECREMENT_LOCAL] = (JitHelper) jit_decrement_local,
+  [HK_OP_JUMP_IF_NOT_LESS] = (JitHelper) jit_jump_if_not_less,
+  [HK_OP_JUMP_IF_NOT_GREATER] = (JitHelper) jit_jump_if_not_greater,
+  [HK_OP_JUMP_IF_LESS] = (JitHelper) jit_jump_if_less,
+  [HK_OP_JUMP_IF_GREATER] = (JitHelper) jit_jump_if_greater,
+  [HK_OP_CALL_POP] = (JitHelper) jit_call_pop,
+  [HK_OP_FOREACH_INIT] = (JitHelper) jit_foreach_init,
+  [HK_OP_FOREACH_NEXT] = (JitHelper) jit_foreach_next,
+  [HK_OP_FOREACH_CURRENT] = (JitHelper) jit_foreach_current,
+  [HK_OP_FOR_LOOP] = (JitHelper) jit_for_loop,
+  [HK_OP_FOR_LOOP_INT] = (JitHelper) jit_for_loop_int,
+  [HK_OP_MATCH_INT] = (JitHelper) jit_match_int,
+  [HK_OP_MATCH_STRING] = (JitHelper) jit_match_string,
+  [HK_OP_ADD_UNCHECKED] = (JitHelper) jit_add_unchecked,
+  [HK_OP_SUBTRACT_UNCHECKED] = (JitHelper) jit_subtract_unchecked,
+  [HK_OP_MULTIPLY_UNCHECKED] = (JitHelper) jit_multiply_unchecked,
+  [HK_OP_RETURN_ARRAY] = (JitHelper) jit_return_array,
+  [HK_OP_CALL_UNPACK] = (JitHelper) jit_call_unpack
+};
+
+JitHelper *jit_helpers(void)
+{
+  return jitHelpers;
+}
+
+static inline bool call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int numResults,
+  int *line)
+{
+  HkValue *globals = vm->vstk.base;
+  HkFunction *fn = cl->fn;
+  HkValue *nonlocals = cl->nonlocals;
+  if (!fn->native && !fn->optimized && ++fn->hotness >= IR_HOT_THRESHOLD
+    && !hk_vm_is_no_optimize(vm))
+    ir_optimize(fn);
+  // Frames already running keep the chunk they started with.
+  HkChunk *chunk = fn->optimized ? fn->optimized : &fn->chunk;
+  // Written so that a threshold of 0 does not compare an unsigned count
+  // against zero.
+  if (!fn->native && hk_vm_is_jit(vm) && fn->hotness + 1 > JIT_HOT_THRESHOLD)
+    fn->native = jit_compile(chunk, jitHelpers);
+  JitCode *native = (JitCode *) fn->native;
+  if (native && native->entry)
+  {
+    HkChunk *nativeChunk = native->chunk;
+    JitFrame frame = { vm, locals, nonlocals, nativeChunk->consts->elements, fn,
+      nativeChunk->code, numResults, false };
+    int offset = native->entry(&frame);
+    if (offset != -1)
+      *line = hk_chunk_get_line(nativeChunk, offset);
+    return frame.unpacked;
+  }
+  uint8_t *code = chunk->code;
+  HkValue *consts = chunk->consts->elements;
+  HkFunction **functions = fn->functions;
+  uint8_t *pc = code;
+  for (;;)
+  {
+    HkOpCode op = (HkOpCode) read_byte(&pc);
+    switch (op)
+    {
+    case HK_OP_NIL:
+      push(vm, hk_nil_value());
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_FALSE:
+      push(vm, hk_bool_value(false));
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_TRUE:
+      push(vm, hk_bool_value(true));
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_INT:
+      push(vm, hk_number_value(read_word(&pc)));
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_CONSTANT:
+      {
+        HkValue val = consts[read_byte(&pc)];
+        push(vm, val);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        hk_value_incr_ref(val);
+      }
+      break;
+    case HK_OP_RANGE:
+      do_range(vm);
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_ARRAY:
+      do_array(vm, read_byte(&pc));
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_STRUCT:
+      do_struct(vm, read_byte(&pc));
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_INSTANCE:
+      do_instance(vm, read_byte(&pc));
+      if (!hk_vm_is_ok(vm))
+        goto end;
       break;
     case HK_OP_CONSTRUCT:
       do_construct(vm, read_byte(&pc));
@@ -1490,7 +2897,10 @@ static inline void call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int *
       break;
     case HK_OP_GLOBAL:
       {
-        HkValue val = globals[read_byte(&pc)];
+        int index = read_byte(&pc);
+        HkValue val = globals[index];
+        if (hk_is_nil(val))
+          val = load_global(vm, index);
         push(vm, val);
         if (!hk_vm_is_ok(vm))
           goto end;
@@ -1530,6 +2940,8 @@ static inline void call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int *
         goto end;
       break;
     case HK_OP_GET_ELEMENT:
+      if (is_array_int(vm))
+        pc[-1] = HK_OP_GET_ELEMENT_ARRAY_INT;
       do_get_element(vm);
       if (!hk_vm_is_ok(vm))
         goto end;
@@ -1594,7 +3006,12 @@ static inline void call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int *
       do_current(vm);
       break;
     case HK_OP_JUMP:
-      pc = &code[read_word(&pc)];
+      {
+        uint8_t *target = &code[read_word(&pc)];
+        if (target < pc)
+          ++fn->hotness;
+        pc = target;
+      }
       break;
     case HK_OP_JUMP_IF_FALSE:
       {
@@ -1675,11 +3092,15 @@ static inline void call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int *
       do_equal(vm);
       break;
     case HK_OP_GREATER:
+      if (is_num_num(vm))
+        pc[-1] = HK_OP_GREATER_NUM_NUM;
       do_greater(vm);
       if (!hk_vm_is_ok(vm))
         goto end;
       break;
     case HK_OP_LESS:
+      if (is_num_num(vm))
+        pc[-1] = HK_OP_LESS_NUM_NUM;
       do_less(vm);
       if (!hk_vm_is_ok(vm))
         goto end;
@@ -1688,11 +3109,15 @@ static inline void call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int *
       do_not_equal(vm);
       break;
     case HK_OP_NOT_GREATER:
+      if (is_num_num(vm))
+        pc[-1] = HK_OP_NOT_GREATER_NUM_NUM;
       do_not_greater(vm);
       if (!hk_vm_is_ok(vm))
         goto end;
       break;
     case HK_OP_NOT_LESS:
+      if (is_num_num(vm))
+        pc[-1] = HK_OP_NOT_LESS_NUM_NUM;
       do_not_less(vm);
       if (!hk_vm_is_ok(vm))
         goto end;
@@ -1723,16 +3148,22 @@ static inline void call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int *
         goto end;
       break;
     case HK_OP_ADD:
+      if (is_num_num(vm))
+        pc[-1] = HK_OP_ADD_NUM_NUM;
       do_add(vm);
       if (!hk_vm_is_ok(vm))
         goto end;
       break;
     case HK_OP_SUBTRACT:
+      if (is_num_num(vm))
+        pc[-1] = HK_OP_SUBTRACT_NUM_NUM;
       do_subtract(vm);
       if (!hk_vm_is_ok(vm))
         goto end;
       break;
     case HK_OP_MULTIPLY:
+      if (is_num_num(vm))
+        pc[-1] = HK_OP_MULTIPLY_NUM_NUM;
       do_multiply(vm);
       if (!hk_vm_is_ok(vm))
         goto end;
@@ -1786,16 +3217,293 @@ static inline void call_function(HkVM *vm, HkValue *locals, HkClosure *cl, int *
         goto end;
       break;
     case HK_OP_RETURN:
-      return;
+      return false;
     case HK_OP_RETURN_NIL:
       push(vm, hk_nil_value());
       if (!hk_vm_is_ok(vm))
         goto end;
-      return;
+      return false;
+    case HK_OP_GET_LOCAL_LOCAL:
+      {
+        HkValue val1 = locals[read_byte(&pc)];
+        push(vm, val1);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        hk_value_incr_ref(val1);
+        // The second slot may be the one just pushed.
+        HkValue val2 = locals[read_byte(&pc)];
+        push(vm, val2);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        hk_value_incr_ref(val2);
+      }
+      break;
+    case HK_OP_GET_LOCAL_INT:
+      {
+        HkValue val = locals[read_byte(&pc)];
+        push(vm, val);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        hk_value_incr_ref(val);
+        push(vm, hk_number_value(read_word(&pc)));
+        if (!hk_vm_is_ok(vm))
+          goto end;
+      }
+      break;
+    case HK_OP_INCREMENT_LOCAL:
+      do_increment_local(vm, &locals[read_byte(&pc)]);
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_DECREMENT_LOCAL:
+      do_decrement_local(vm, &locals[read_byte(&pc)]);
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_JUMP_IF_NOT_LESS:
+      {
+        int offset = read_word(&pc);
+        int result;
+        do_compare(vm, &result);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        if (result >= 0)
+          pc = &code[offset];
+      }
+      break;
+    case HK_OP_JUMP_IF_NOT_GREATER:
+      {
+        int offset = read_word(&pc);
+        int result;
+        do_compare(vm, &result);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        if (result <= 0)
+          pc = &code[offset];
+      }
+      break;
+    case HK_OP_JUMP_IF_LESS:
+      {
+        int offset = read_word(&pc);
+        int result;
+        do_compare(vm, &result);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        if (result < 0)
+          pc = &code[offset];
+      }
+      break;
+    case HK_OP_JUMP_IF_GREATER:
+      {
+        int offset = read_word(&pc);
+        int result;
+        do_compare(vm, &result);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        if (result > 0)
+          pc = &code[offset];
+      }
+      break;
+    case HK_OP_CALL_POP:
+      do_call(vm, read_byte(&pc));
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      pop(vm);
+      break;
+    case HK_OP_FOREACH_INIT:
+      do_foreach_init(vm);
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_FOREACH_NEXT:
+      do_foreach_next(vm);
+      break;
+    case HK_OP_FOREACH_CURRENT:
+      {
+        int offset = read_word(&pc);
+        if (!do_foreach_current(vm))
+          pc = &code[offset];
+      }
+      break;
+    case HK_OP_FOR_LOOP:
+    case HK_OP_FOR_LOOP_INT:
+      {
+        int offset = read_word(&pc);
+        HkValue *slot = &locals[read_byte(&pc)];
+        HkOpCode cmp = (HkOpCode) read_byte(&pc);
+        int data = read_word(&pc);
+        HkValue bound = op == HK_OP_FOR_LOOP ? locals[data] : hk_number_value(data);
+        if (do_for_loop(vm, slot, cmp, bound))
+        {
+          ++fn->hotness;
+          pc = &code[offset];
+        }
+        if (!hk_vm_is_ok(vm))
+          goto end;
+      }
+      break;
+    case HK_OP_MATCH_INT:
+      {
+        int fallback = read_word(&pc);
+        int min = read_word(&pc);
+        int size = read_word(&pc);
+        uint16_t *targets = (uint16_t *) pc;
+        HkValue val = hk_stack_get(&vm->vstk, 0);
+        pc = &code[fallback];
+        if (!hk_is_number(val))
+          break;
+        double data = hk_as_number(val) - min;
+        if (!(data >= 0 && data < size))
+          break;
+        int index = (int) data;
+        if (index != data || targets[index] == fallback)
+          break;
+        pc = &code[targets[index]];
+        hk_stack_pop(&vm->vstk);
+      }
+      break;
+    case HK_OP_MATCH_STRING:
+      {
+        int fallback = read_word(&pc);
+        uint32_t seed = read_word(&pc);
+        int bits = read_byte(&pc);
+        HkValue val = hk_stack_get(&vm->vstk, 0);
+        uint8_t *entry = pc;
+        pc = &code[fallback];
+        if (!hk_is_string(val))
+          break;
+        HkString *str = hk_as_string(val);
+        entry += hk_match_slot(hk_string_hash(str), seed, bits) * 3;
+        int target = *((uint16_t *) &entry[1]);
+        if (target == fallback || !hk_string_equal(str, hk_as_string(consts[entry[0]])))
+          break;
+        pc = &code[target];
+        hk_stack_pop(&vm->vstk);
+        hk_string_release(str);
+      }
+      break;
+    case HK_OP_GET_ELEMENT_ARRAY_INT:
+      if (!is_array_int(vm))
+      {
+        pc[-1] = HK_OP_GET_ELEMENT;
+        do_get_element(vm);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        break;
+      }
+      do_get_element_array_int(vm);
+      if (!hk_vm_is_ok(vm))
+        goto end;
+      break;
+    case HK_OP_GREATER_NUM_NUM:
+      if (!is_num_num(vm))
+      {
+        pc[-1] = HK_OP_GREATER;
+        do_greater(vm);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        break;
+      }
+      do_greater_num_num(vm);
+      break;
+    case HK_OP_LESS_NUM_NUM:
+      if (!is_num_num(vm))
+      {
+        pc[-1] = HK_OP_LESS;
+        do_less(vm);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        break;
+      }
+      do_less_num_num(vm);
+      break;
+    case HK_OP_NOT_GREATER_NUM_NUM:
+      if (!is_num_num(vm))
+      {
+        pc[-1] = HK_OP_NOT_GREATER;
+        do_not_greater(vm);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        break;
+      }
+      do_not_greater_num_num(vm);
+      break;
+    case HK_OP_NOT_LESS_NUM_NUM:
+      if (!is_num_num(vm))
+      {
+        pc[-1] = HK_OP_NOT_LESS;
+        do_not_less(vm);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        break;
+      }
+      do_not_less_num_num(vm);
+      break;
+    case HK_OP_ADD_NUM_NUM:
+      if (!is_num_num(vm))
+      {
+        pc[-1] = HK_OP_ADD;
+        do_add(vm);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        break;
+      }
+      do_add_num_num(vm);
+      break;
+    case HK_OP_SUBTRACT_NUM_NUM:
+      if (!is_num_num(vm))
+      {
+        pc[-1] = HK_OP_SUBTRACT;
+        do_subtract(vm);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        break;
+      }
+      do_subtract_num_num(vm);
+      break;
+    case HK_OP_MULTIPLY_NUM_NUM:
+      if (!is_num_num(vm))
+      {
+        pc[-1] = HK_OP_MULTIPLY;
+        do_multiply(vm);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+        break;
+      }
+      do_multiply_num_num(vm);
+      break;
+    case HK_OP_ADD_UNCHECKED:
+      do_add_num_num(vm);
+      break;
+    case HK_OP_SUBTRACT_UNCHECKED:
+      do_subtract_num_num(vm);
+      break;
+    case HK_OP_MULTIPLY_UNCHECKED:
+      do_multiply_num_num(vm);
+      break;
+    case HK_OP_RETURN_ARRAY:
+      {
+        int length = read_byte(&pc);
+        if (numResults && length == numResults)
+          return true;
+        do_array(vm, length);
+        if (!hk_vm_is_ok(vm))
+          goto end;
+      }
+      return false;
+    case HK_OP_CALL_UNPACK:
+      {
+        int numArgs = read_byte(&pc);
+        do_call_unpack(vm, numArgs, read_byte(&pc));
+        if (!hk_vm_is_ok(vm))
+          goto end;
+      }
+      break;
     }
   }
 end:
   *line = hk_chunk_get_line(chunk, (int) (pc - code));
+  return false;
 }
 
 static inline void discard_frame(HkVM *vm, HkValue *slots)
@@ -1820,20 +3528,32 @@ static inline void move_result(HkVM *vm, HkValue *slots)
   }
 }
 
+static inline void move_results(HkVM *vm, HkValue *slots, int n)
+{
+  HkValue *results = &hk_stack_get(&vm->vstk, n - 1);
+  for (HkValue *slot = &slots[1]; slot < results; ++slot)
+    hk_value_release(*slot);
+  for (int i = 0; i < n; ++i)
+    slots[i] = results[i];
+  vm->vstk.top = &slots[n - 1];
+}
+
 void hk_vm_init(HkVM *vm, int size)
 {
   size = size < 1 ? HK_VM_STACK_DEFAULT_SIZE : size;
-  hk_stack_init(&vm->vstk, size);
+  stack_reserve(vm, size);
+  vm->depth = 0;
   vm->flags = HK_VM_FLAG_NONE;
   vm->status = HK_VM_STATUS_OK;
+  vm->modules = module_state_new();
+  vm->randState = 1;
   load_globals(vm);
   hk_assert(hk_vm_is_ok(vm), "vm should be ok");
-  module_cache_init();
 }
 
 void hk_vm_deinit(HkVM *vm)
 {
-  module_cache_deinit();
+  module_state_free((ModuleState *) vm->modules);
   int n = (int) (vm->vstk.top - vm->vstk.base);
   hk_assert(n == num_globals() - 1, "stack must contain the globals");
   while (!hk_stack_is_empty(&vm->vstk))
@@ -1842,7 +3562,7 @@ void hk_vm_deinit(HkVM *vm)
     hk_stack_pop(&vm->vstk);
     hk_value_release(val);
   }
-  hk_stack_deinit(&vm->vstk);
+  stack_release(vm);
 }
 
 void hk_vm_runtime_error(HkVM *vm, const char *fmt, ...)
@@ -2038,6 +3758,30 @@ void hk_vm_push_new_native(HkVM *vm, const char *name, int arity,
     hk_native_free(native);
 }
 
+void hk_vm_push_new_natives(HkVM *vm, int n, const HkNativeEntry entries[])
+{
+  // Each entry is pushed as a field name followed by the native, which shares
+  // the same string as its name.
+  for (int i = 0; i < n; ++i)
+  {
+    const HkNativeEntry *entry = &entries[i];
+    HkString *name = hk_string_from_chars(-1, entry->name);
+    hk_vm_push_string(vm, name);
+    if (!hk_vm_is_ok(vm))
+    {
+      hk_string_free(name);
+      return;
+    }
+    HkNative *native = hk_native_new(name, entry->arity, entry->call);
+    hk_vm_push_native(vm, native);
+    if (!hk_vm_is_ok(vm))
+    {
+      hk_native_free(native);
+      return;
+    }
+  }
+}
+
 void hk_vm_push_userdata(HkVM *vm, HkUserdata *udata)
 {
   push(vm, hk_userdata_value(udata));